@@ -35,6 +35,7 @@
 
 #include "cdrom.h"
 #include "plugin_lib.h"
+#include "perfmon.h"
 #include "ppf.h"
 #include "psxdma.h"
 #include "psxevents.h"
@@ -427,7 +428,9 @@ static void ReadTrack(const u8 *time)
 
 	CDR_LOG("ReadTrack *** %02x:%02x:%02x\n", tmp[0], tmp[1], tmp[2]);
 
+	pmonSubsysBegin(PMON_SUBSYS_CDR);
 	cdr.RErr = CDR_readTrack(tmp);
+	pmonSubsysEnd(PMON_SUBSYS_CDR);
 	memcpy(cdr.Prev, tmp, 3);
 
 	if (CheckSBI(time))
@@ -1567,9 +1570,7 @@ void psxDma3(u32 madr, u32 bcr, u32 chcr) {
 				psxCpu->Notify(R3000ACPU_NOTIFY_DMA3_EXE_LOAD, NULL);
 			}
 
-#ifdef PSXREC
-			psxCpu->Clear(madr, cdsize / 4);
-#endif
+			psxCpuClear(madr, cdsize / 4);
 
 			pTransfer += cdsize;
 
@@ -0,0 +1,280 @@
+/***************************************************************************
+*   Copyright (C) 2016 PCSX4ALL Team                                      *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+/*
+ * Offline replayer for GPU streams recorded with 'pcsx4all -gpurec <file>'
+ * (see gpulib_record_start() in gpulib/gpu.cpp for the file layout).
+ * Built with 'make gpu-replay'.
+ *
+ * The recording is fed back at full speed through the GPU plugin API,
+ * so the same file can be used to profile and compare any backend
+ * without running the CPU core or needing the game disc. The whole file
+ * is loaded before replay starts, so disk I/O isn't part of the timing.
+ *
+ * Usage: gpu_replay [-n passes] [-o vram.bin] <recording>
+ *   -n  Replay the recording this many times, restoring the initial
+ *       snapshot before each pass (default 1)
+ *   -o  Write VRAM contents after the last pass to a file, for comparing
+ *       output of different renderers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "plugins.h"
+#include "perfmon.h"
+#include "gpu/gpulib/gpu.h"
+
+extern uint32_t frame_counter;
+
+// Emulated PSX RAM that GPU_dmaChain() linked lists are rebuilt in
+#define RAM_WORDS (0x200000 / 4)
+static uint32_t ram[RAM_WORDS];
+
+static uint32_t read_buf[1024];
+
+// pmon_gpu counters are 32-bit and only meant to hold one frame's counts,
+//  so they are moved into these at every frame
+static uint64_t total_prims, total_pixels;
+
+static void accumulate_counts()
+{
+	for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+		total_prims += pmon_gpu.prims[i];
+		total_pixels += pmon_gpu.pixels[i];
+	}
+	memset(pmon_gpu.prims, 0, sizeof(pmon_gpu.prims));
+	memset(pmon_gpu.pixels, 0, sizeof(pmon_gpu.pixels));
+}
+
+static double now_sec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+// Rebuild a recorded DMA chain as a linked list in 'ram' and hand it to
+//  GPU_dmaChain(). A chain too large to fit (only possible if the game's
+//  list looped) is fed node by node through GPU_writeDataMem() instead.
+static void replay_dma_chain(uint32_t *data, int count)
+{
+	int ram_words = 0;
+	for (int pos = 0; pos < count; pos += 1 + data[pos])
+		ram_words += 1 + data[pos];
+
+	if (ram_words >= RAM_WORDS) {
+		for (int pos = 0; pos < count; pos += 1 + data[pos])
+			GPU_writeDataMem(&data[pos+1], data[pos]);
+		return;
+	}
+
+	uint32_t addr = 0;
+	for (int pos = 0; pos < count; pos += 1 + data[pos]) {
+		uint32_t len = data[pos];
+		uint32_t next = addr + (1 + len) * 4;
+		bool last = (pos + 1 + (int)len >= count);
+		ram[addr/4] = (len << 24) | (last ? 0xffffff : next);
+		memcpy(&ram[addr/4 + 1], &data[pos+1], len * 4);
+		addr = next;
+	}
+
+	GPU_dmaChain(ram, count ? 0 : 0xffffff);
+}
+
+// Replays all records, returns # of frames (GPU_updateLace() calls) seen
+//  or -1 if the recording is corrupt
+static int replay(uint32_t *data, int num_words)
+{
+	int frames = 0;
+	int pos = 0;
+
+	while (pos < num_words) {
+		uint32_t hdr = data[pos++];
+		int type = hdr >> 24;
+		int count = hdr & 0xffffff;
+		uint32_t *payload = &data[pos];
+
+		// Only GPUREC_READ_DATA and GPUREC_UPDATE_LACE have no payload
+		if (type != GPUREC_READ_DATA && type != GPUREC_UPDATE_LACE) {
+			if (pos + count > num_words)
+				return -1;
+			pos += count;
+		}
+
+		switch (type) {
+		case GPUREC_WRITE_DATA:
+			for (int i=0; i < count; ++i)
+				GPU_writeData(payload[i]);
+			break;
+
+		case GPUREC_WRITE_DATA_MEM:
+			GPU_writeDataMem(payload, count);
+			break;
+
+		case GPUREC_DMA_CHAIN:
+			replay_dma_chain(payload, count);
+			break;
+
+		case GPUREC_WRITE_STATUS:
+			GPU_writeStatus(payload[0]);
+			break;
+
+		case GPUREC_READ_DATA:
+			while (count > 0) {
+				int n = count < 1024 ? count : 1024;
+				GPU_readDataMem(read_buf, n);
+				count -= n;
+			}
+			break;
+
+		case GPUREC_UPDATE_LACE:
+			GPU_updateLace();
+			frame_counter++;
+			frames++;
+			accumulate_counts();
+			break;
+
+		case GPUREC_VBLANK:
+			GPU_vBlank(payload[0] & 1, (payload[0] >> 1) & 1);
+			break;
+
+		case GPUREC_LOAD_STATE:
+			if (count * 4 != (int)sizeof(GPUFreeze_t))
+				return -1;
+			GPU_freeze(0, (GPUFreeze_t *)payload);
+			break;
+
+		default:
+			return -1;
+		}
+	}
+
+	return frames;
+}
+
+int main(int argc, char **argv)
+{
+	int passes = 1;
+	const char *vram_file = NULL;
+	const char *rec_file = NULL;
+
+	for (int i=1; i < argc; ++i) {
+		if (strcmp(argv[i], "-n") == 0 && i+1 < argc) {
+			passes = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+			vram_file = argv[++i];
+		} else if (argv[i][0] != '-' && !rec_file) {
+			rec_file = argv[i];
+		} else {
+			rec_file = NULL;
+			break;
+		}
+	}
+
+	if (!rec_file || passes < 1) {
+		printf("Usage: %s [-n passes] [-o vram.bin] <recording>\n", argv[0]);
+		return 1;
+	}
+
+	FILE *f = fopen(rec_file, "rb");
+	if (!f) {
+		printf("ERROR: could not open %s\n", rec_file);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	struct gpurec_header hdr;
+	if (size < (long)(sizeof(hdr) + sizeof(GPUFreeze_t)) ||
+	    fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    memcmp(hdr.magic, GPUREC_MAGIC, sizeof(hdr.magic)) != 0 ||
+	    hdr.version != GPUREC_VERSION ||
+	    hdr.freeze_size != sizeof(GPUFreeze_t)) {
+		printf("ERROR: %s is not a compatible GPU recording\n", rec_file);
+		fclose(f);
+		return 1;
+	}
+
+	GPUFreeze_t *snapshot = (GPUFreeze_t *)malloc(sizeof(GPUFreeze_t));
+	long data_size = size - sizeof(hdr) - sizeof(GPUFreeze_t);
+	int num_words = data_size / 4;
+	uint32_t *data = (uint32_t *)malloc(num_words * 4 + 4);
+	if (!snapshot || !data ||
+	    fread(snapshot, sizeof(GPUFreeze_t), 1, f) != 1 ||
+	    fread(data, 4, num_words, f) != (size_t)num_words) {
+		printf("ERROR: could not read %s\n", rec_file);
+		fclose(f);
+		return 1;
+	}
+	fclose(f);
+
+	if (GPU_init() != 0) {
+		printf("ERROR: GPU_init() failed\n");
+		return 1;
+	}
+	pmon_gpu.enabled = true;
+
+	int frames = 0;
+	double secs = 0;
+	for (int pass = 0; pass < passes; ++pass) {
+		GPU_freeze(0, snapshot);
+
+		double start = now_sec();
+		int pass_frames = replay(data, num_words);
+		secs += now_sec() - start;
+
+		if (pass_frames < 0) {
+			printf("ERROR: %s is corrupt or truncated\n", rec_file);
+			return 1;
+		}
+		frames += pass_frames;
+	}
+
+	printf("Replayed %s: %d pass(es), %d frames, %d words\n",
+	       rec_file, passes, frames / passes, num_words);
+	printf("Time: %.3f s  %.1f frames/s  %.3f ms/frame\n", secs,
+	       secs > 0 ? frames / secs : 0.0, frames ? 1000.0 * secs / frames : 0.0);
+
+	accumulate_counts();
+	if (total_prims && frames)
+		printf("Per frame: %llu prims  %llu pixels\n",
+		       (unsigned long long)(total_prims / frames),
+		       (unsigned long long)(total_pixels / frames));
+
+	if (vram_file) {
+		GPU_freeze(1, snapshot);
+		FILE *vf = fopen(vram_file, "wb");
+		if (!vf || fwrite(snapshot->psxVRam, sizeof(snapshot->psxVRam), 1, vf) != 1) {
+			printf("ERROR: could not write %s\n", vram_file);
+			if (vf) fclose(vf);
+			return 1;
+		}
+		fclose(vf);
+		printf("VRAM written to %s\n", vram_file);
+	}
+
+	GPU_shutdown();
+	free(data);
+	free(snapshot);
+	return 0;
+}
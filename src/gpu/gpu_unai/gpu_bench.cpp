@@ -0,0 +1,366 @@
+/***************************************************************************
+*   Copyright (C) 2016 PCSX4ALL Team                                      *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+/*
+ * Standalone gpu_unai rasterizer benchmark, built with 'make bench-gpu'.
+ *
+ * Only gpulib and gpu_unai are linked in: video output and the few
+ * emulator-core symbols gpulib references come from gpulib_stubs.cpp, so
+ * no SDL, SPU or CPU emulation is involved and results are repeatable.
+ *
+ * Each synthetic test builds a GP0 command list exercising one rasterizer
+ * path (gpuPolySpanFn, gpuSpriteSpanFn, gpuTileSpanFn, line drawing) and
+ * feeds it to do_cmd_list() until the requested time has elapsed. Pixel
+ * counts come from the perfmon GPU stats, i.e. after clipping.
+ *
+ * A recorded stream of raw GP0 words (little-endian 32-bit) can be given
+ * with -f, and is replayed through GPU_writeDataMem() so VRAM transfers
+ * are handled by gpulib like they are in the emulator.
+ *
+ * Usage: bench_gpu [-t seconds] [-f gp0_words.bin] [test name filter]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "plugins.h"
+#include "perfmon.h"
+#include "gpu/gpulib/gpu.h"
+
+// Texture page at VRAM (512,0), CLUT at (0,480): both outside the 320x240
+//  drawing area, so rendering never overwrites the texels being sampled.
+#define TPAGE_XY    (512 / 64)
+#define CLUT_WORD   ((480 << 6) | (0 >> 4))
+
+#define DRAW_W      320
+#define DRAW_H      240
+
+#define MAX_PRIMS   1024
+#define MAX_WORDS   (MAX_PRIMS * 12 + 16)
+
+struct BenchTest {
+	const char *name;
+	u8  cmd;         // GP0 command
+	u8  tmode;       // Texture color mode: 0:4bpp 1:8bpp 2:15bpp
+	u8  dither;      // Set E1 dither bit
+	u8  size;        // Typical width/height of primitive in pixels
+};
+
+static const BenchTest tests[] = {
+	// name                  cmd   tmode dither size
+	{ "poly F3",             0x20, 0, 0, 32 },
+	{ "poly F3 small",       0x20, 0, 0,  8 },
+	{ "poly F3 semi",        0x22, 0, 0, 32 },
+	{ "poly F4",             0x28, 0, 0, 32 },
+	{ "poly FT3 4bpp",       0x24, 0, 0, 32 },
+	{ "poly FT3 8bpp",       0x24, 1, 0, 32 },
+	{ "poly FT3 15bpp",      0x24, 2, 0, 32 },
+	{ "poly FT3 4bpp raw",   0x25, 0, 0, 32 },
+	{ "poly FT3 4bpp semi",  0x26, 0, 0, 32 },
+	{ "poly FT4 4bpp",       0x2C, 0, 0, 32 },
+	{ "poly G3",             0x30, 0, 0, 32 },
+	{ "poly G3 dither",      0x30, 0, 1, 32 },
+	{ "poly G3 small",       0x30, 0, 0,  8 },
+	{ "poly G4",             0x38, 0, 0, 32 },
+	{ "poly GT3 4bpp",       0x34, 0, 0, 32 },
+	{ "poly GT3 8bpp dither",0x34, 1, 1, 32 },
+	{ "poly GT3 15bpp",      0x34, 2, 0, 32 },
+	{ "poly GT4 4bpp",       0x3C, 0, 0, 32 },
+	{ "poly GT4 4bpp small", 0x3C, 0, 0,  8 },
+	{ "line F",              0x40, 0, 0, 64 },
+	{ "line F semi",         0x42, 0, 0, 64 },
+	{ "line G",              0x50, 0, 0, 64 },
+	{ "tile var",            0x60, 0, 0, 32 },
+	{ "tile var semi",       0x62, 0, 0, 32 },
+	{ "tile 1x1",            0x68, 0, 0,  1 },
+	{ "tile 8x8",            0x70, 0, 0,  8 },
+	{ "tile 16x16",          0x78, 0, 0, 16 },
+	{ "sprite var 4bpp",     0x64, 0, 0, 32 },
+	{ "sprite var 8bpp",     0x64, 1, 0, 32 },
+	{ "sprite var 15bpp",    0x64, 2, 0, 32 },
+	{ "sprite var 4bpp raw", 0x65, 0, 0, 32 },
+	{ "sprite var semi",     0x66, 0, 0, 32 },
+	{ "sprite 8x8 4bpp",     0x74, 0, 0,  8 },
+	{ "sprite 16x16 4bpp",   0x7C, 0, 0, 16 },
+	{ "fill",                0x02, 0, 0, 64 },
+};
+
+static u32 rng_state = 0x12345678;
+
+static inline u32 rng()
+{
+	rng_state = rng_state * 1103515245 + 12345;
+	return rng_state >> 8;
+}
+
+static inline u32 vertex(int x, int y)
+{
+	return ((u32)(y & 0x7ff) << 16) | (x & 0x7ff);
+}
+
+// Fill VRAM with non-zero values so textured prims never hit the
+//  transparent (0x0000) texel path
+static void fill_vram()
+{
+	for (int i=0; i < 1024*512; ++i)
+		gpu.vram[i] = (rng() & 0x7fff) | 1;
+}
+
+// Returns # of words written to 'list'
+static int build_list(const BenchTest &t, u32 *list)
+{
+	u32 *p = list;
+	u32 tpage = TPAGE_XY | (t.tmode << 7);
+
+	*p++ = 0xe1000000 | tpage | (t.dither << 9) | (1 << 10); // Draw to display area
+	*p++ = 0xe2000000;                                          // No texture window
+	*p++ = 0xe3000000;                                          // Draw area top left
+	*p++ = 0xe4000000 | ((DRAW_H-1) << 10) | (DRAW_W-1);       // Draw area bottom right
+	*p++ = 0xe5000000;                                          // No draw offset
+	*p++ = 0xe6000000;                                          // No mask bit handling
+
+	const u32 cmd = t.cmd;
+	const int size = t.size;
+
+	for (int n=0; n < MAX_PRIMS; ++n) {
+		int x = rng() % (DRAW_W - size + 1);
+		int y = rng() % (DRAW_H - size + 1);
+		u32 color = rng() & 0xffffff;
+
+		switch (cmd >> 5) {
+		case 0x0: // Fill rectangle (x is in 16-pixel units)
+			*p++ = (cmd << 24) | color;
+			*p++ = vertex(x & ~15, y);
+			*p++ = ((u32)size << 16) | size;
+			break;
+
+		case 0x1: { // Polygon
+			const int num_verts = (cmd & 0x08) ? 4 : 3;
+			const bool gouraud = cmd & 0x10, textured = cmd & 0x04;
+			// Quads as a square, tris as half of one
+			static const int vx[4] = { 0, 1, 0, 1 }, vy[4] = { 0, 0, 1, 1 };
+			for (int v=0; v < num_verts; ++v) {
+				if (v == 0)
+					*p++ = (cmd << 24) | color;
+				else if (gouraud)
+					*p++ = rng() & 0xffffff;
+				*p++ = vertex(x + vx[v] * size, y + vy[v] * size);
+				if (textured) {
+					u32 uv = ((vy[v] * (size-1)) << 8) | (vx[v] * (size-1));
+					if (v == 0) uv |= CLUT_WORD << 16;
+					if (v == 1) uv |= tpage << 16;
+					*p++ = uv;
+				}
+			}
+		} break;
+
+		case 0x2: { // Line, at a random angle
+			const bool gouraud = cmd & 0x10;
+			int x1 = rng() % (DRAW_W - size + 1);
+			int y1 = rng() % (DRAW_H - size + 1);
+			*p++ = (cmd << 24) | color;
+			*p++ = vertex(x, y);
+			if (gouraud)
+				*p++ = rng() & 0xffffff;
+			*p++ = vertex(x1 + (x1 < x ? 0 : size - 1), y1);
+		} break;
+
+		case 0x3: { // Rectangle
+			const bool textured = cmd & 0x04;
+			*p++ = (cmd << 24) | color;
+			*p++ = vertex(x, y);
+			if (textured)
+				*p++ = (CLUT_WORD << 16) | (rng() & 0x0f0f);
+			if (((cmd >> 3) & 3) == 0)
+				*p++ = ((u32)size << 16) | size;
+		} break;
+		}
+	}
+
+	return p - list;
+}
+
+static double now_sec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+// pmon_gpu counters are 32-bit and would wrap over a long run, so they are
+//  moved into these after every command list or stream pass.
+static u64 total_prims[PMON_GPU_PRIM_COUNT];
+static u64 total_pixels[PMON_GPU_PRIM_COUNT];
+
+static void reset_counts()
+{
+	memset(pmon_gpu.prims, 0, sizeof(pmon_gpu.prims));
+	memset(pmon_gpu.pixels, 0, sizeof(pmon_gpu.pixels));
+	pmon_gpu.cmd_words = 0;
+	memset(total_prims, 0, sizeof(total_prims));
+	memset(total_pixels, 0, sizeof(total_pixels));
+}
+
+static void accumulate_counts()
+{
+	for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+		total_prims[i] += pmon_gpu.prims[i];
+		total_pixels[i] += pmon_gpu.pixels[i];
+	}
+	memset(pmon_gpu.prims, 0, sizeof(pmon_gpu.prims));
+	memset(pmon_gpu.pixels, 0, sizeof(pmon_gpu.pixels));
+}
+
+static void sum_counts(double *prims, double *pixels)
+{
+	*prims = *pixels = 0;
+	for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+		*prims += total_prims[i];
+		*pixels += total_pixels[i];
+	}
+}
+
+static void print_result(const char *name, double prims, double pixels, double secs)
+{
+	printf("%-22s %10.0f %9.2f %9.1f\n", name, prims / secs,
+	       pixels / (secs * 1000000.0), prims > 0 ? pixels / prims : 0.0);
+}
+
+static void run_test(const BenchTest &t, u32 *list, double min_secs)
+{
+	int len = build_list(t, list);
+	int last_cmd;
+
+	// Warm up caches and branch predictors, then time
+	do_cmd_list(list, len, &last_cmd);
+	reset_counts();
+
+	double secs, start = now_sec();
+	do {
+		do_cmd_list(list, len, &last_cmd);
+		accumulate_counts();
+		secs = now_sec() - start;
+	} while (secs < min_secs);
+
+	double prims, pixels;
+	sum_counts(&prims, &pixels);
+	print_result(t.name, prims, pixels, secs);
+}
+
+static int run_stream(const char *filename, double min_secs)
+{
+	FILE *f = fopen(filename, "rb");
+	if (!f) {
+		printf("ERROR: could not open %s\n", filename);
+		return 1;
+	}
+	fseek(f, 0, SEEK_END);
+	long size = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	int num_words = size / 4;
+	u32 *words = (u32*)malloc(num_words * 4 + 4);
+	if (!words || fread(words, 4, num_words, f) != (size_t)num_words) {
+		printf("ERROR: could not read %s\n", filename);
+		fclose(f);
+		free(words);
+		return 1;
+	}
+	fclose(f);
+
+	// GPU_writeDataMem() buffers incomplete cmds, so it can be fed in
+	//  arbitrary chunks. Stream is replayed from the start each pass.
+	GPU_writeDataMem(words, num_words);
+	reset_counts();
+
+	int passes = 0;
+	double secs, start = now_sec();
+	do {
+		GPU_writeDataMem(words, num_words);
+		accumulate_counts();
+		passes++;
+		secs = now_sec() - start;
+	} while (secs < min_secs);
+
+	double prims, pixels;
+	sum_counts(&prims, &pixels);
+	print_result(filename, prims, pixels, secs);
+
+	printf("\n%d passes of %d words, per pass:\n", passes, num_words);
+	static const char * const names[PMON_GPU_PRIM_COUNT] = {
+		"fill", "poly F", "poly FT", "poly G", "poly GT", "line F", "line G",
+		"tile", "sprite", "vram cp", "vram wr", "vram rd"
+	};
+	for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+		if (total_prims[i] == 0) continue;
+		printf("  %-8s %8llu prims %10llu pixels\n", names[i],
+		       (unsigned long long)(total_prims[i] / passes),
+		       (unsigned long long)(total_pixels[i] / passes));
+	}
+
+	free(words);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	double min_secs = 1.0;
+	const char *stream_file = NULL;
+	const char *filter = NULL;
+
+	for (int i=1; i < argc; ++i) {
+		if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+			min_secs = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-f") == 0 && i+1 < argc) {
+			stream_file = argv[++i];
+		} else if (argv[i][0] != '-') {
+			filter = argv[i];
+		} else {
+			printf("Usage: %s [-t seconds] [-f gp0_words.bin] [test name filter]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	if (GPU_init() != 0) {
+		printf("ERROR: GPU_init() failed\n");
+		return 1;
+	}
+	pmon_gpu.enabled = true;
+	fill_vram();
+
+	printf("%-22s %10s %9s %9s\n", "test", "prims/s", "Mpix/s", "pix/prim");
+
+	int ret = 0;
+	if (stream_file) {
+		ret = run_stream(stream_file, min_secs);
+	} else {
+		u32 *list = (u32*)malloc(MAX_WORDS * 4);
+		for (unsigned i=0; i < sizeof(tests) / sizeof(tests[0]); ++i) {
+			if (filter && !strstr(tests[i].name, filter))
+				continue;
+			run_test(tests[i], list, min_secs);
+		}
+		free(list);
+	}
+
+	GPU_shutdown();
+	return ret;
+}
@@ -85,6 +85,8 @@ void gpuMoveImage(PtrUnion packet)
 	if( (x0==x1) && (y0==y1) ) return;
 	if ((w0<=0) || (h0<=0)) return;
 	
+	gpu_unai.pixel_count += w0 * h0;
+
 	#ifdef ENABLE_GPU_LOG_SUPPORT
 		fprintf(stdout,"gpuMoveImage(x0=%u,y0=%u,x1=%u,y1=%u,w0=%d,h0=%d)\n",x0,y0,x1,y1,w0,h0);
 	#endif
@@ -170,6 +172,8 @@ void gpuClearImage(PtrUnion packet)
 	h0 -= y0;
 	if (h0 <= 0) return;
 
+	gpu_unai.pixel_count += w0 * h0;
+
 	#ifdef ENABLE_GPU_LOG_SUPPORT
 		fprintf(stdout,"gpuClearImage(x0=%d,y0=%d,w0=%d,h0=%d)\n",x0,y0,w0,h0);
 	#endif
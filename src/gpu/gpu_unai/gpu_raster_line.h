@@ -166,6 +166,8 @@ void gpuDrawLineF(PtrUnion packet, const PSD gpuPixelSpanDriver)
 
 	// IMPORTANT: dx,dy should now contain their absolute values
 
+	gpu_unai.pixel_count += ((dx > dy) ? dx : dy) + 1;
+
 	int min_length,    // Minimum length of a pixel run
 	    start_length,  // Length of first run
 	    end_length,    // Length of last run
@@ -504,6 +506,8 @@ void gpuDrawLineG(PtrUnion packet, const PSD gpuPixelSpanDriver)
 
 	// IMPORTANT: dx,dy should now contain their absolute values
 
+	gpu_unai.pixel_count += ((dx > dy) ? dx : dy) + 1;
+
 	int min_length,    // Minimum length of a pixel run
 	    start_length,  // Length of first run
 	    end_length,    // Length of last run
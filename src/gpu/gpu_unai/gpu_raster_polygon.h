@@ -353,8 +353,10 @@ void gpuDrawPolyF(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad
 				xa = FixedCeilToInt(x3);  xb = FixedCeilToInt(x4);
 				if ((xmin - xa) > 0) xa = xmin;
 				if (xb > xmax) xb = xmax;
-				if ((xb - xa) > 0)
+				if ((xb - xa) > 0) {
 					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					gpu_unai.pixel_count += xb - xa;
+				}
 			}
 		}
 	} while (++cur_pass < total_passes);
@@ -686,8 +688,10 @@ void gpuDrawPolyFT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_qua
 				gpu_unai.v = v4;
 
 				if (xb > xmax) xb = xmax;
-				if ((xb - xa) > 0)
+				if ((xb - xa) > 0) {
 					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					gpu_unai.pixel_count += xb - xa;
+				}
 			}
 		}
 	} while (++cur_pass < total_passes);
@@ -1034,8 +1038,10 @@ void gpuDrawPolyG(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_quad
 				gpu_unai.gCol = gpuPackGouraudCol(r4, g4, b4);
 
 				if (xb > xmax) xb = xmax;
-				if ((xb - xa) > 0)
+				if ((xb - xa) > 0) {
 					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					gpu_unai.pixel_count += xb - xa;
+				}
 			}
 		}
 	} while (++cur_pass < total_passes);
@@ -1440,8 +1446,10 @@ void gpuDrawPolyGT(const PtrUnion packet, const PP gpuPolySpanDriver, u32 is_qua
 				gpu_unai.gCol = gpuPackGouraudCol(r4, g4, b4);
 
 				if (xb > xmax) xb = xmax;
-				if ((xb - xa) > 0)
+				if ((xb - xa) > 0) {
 					gpuPolySpanDriver(gpu_unai, PixelBase + xa, (xb - xa));
+					gpu_unai.pixel_count += xb - xa;
+				}
 			}
 		}
 	} while (++cur_pass < total_passes);
@@ -73,8 +73,10 @@ void gpuDrawS(PtrUnion packet, const PS gpuSpriteSpanDriver)
 
 	for (; y0<y1; ++y0) {
 		u8* pTxt = pTxt_base + ((v0 & v0_mask) * 2048);
-		if (!(y0&li) && (y0&pi)!=pif)
+		if (!(y0&li) && (y0&pi)!=pif) {
 			gpuSpriteSpanDriver(Pixel, x1, pTxt, u0);
+			gpu_unai.pixel_count += x1;
+		}
 		Pixel += FRAME_WIDTH;
 		v0++;
 	}
@@ -121,6 +123,7 @@ void gpuDrawS16(PtrUnion packet)
 	else if (ymax - y0 < 16)
 		h = ymax - y0;
 
+	gpu_unai.pixel_count += 16 * h;
 	draw_spr16_full(&gpu_unai.vram[FRAME_OFFSET(x0, y0)], &gpu_unai.TBA[FRAME_OFFSET(u0/4, v0)], gpu_unai.CBA, h);
 }
 #endif // __arm__
@@ -158,8 +161,10 @@ void gpuDrawT(PtrUnion packet, const PT gpuTileSpanDriver)
 	const int pif=(ProgressiveInterlaceEnabled()?(gpu_unai.prog_ilace_flag?(gpu_unai.ilace_mask+1):0):1);
 
 	for (; y0<y1; ++y0) {
-		if (!(y0&li) && (y0&pi)!=pif)
+		if (!(y0&li) && (y0&pi)!=pif) {
 			gpuTileSpanDriver(Pixel,x1,Data);
+			gpu_unai.pixel_count += x1;
+		}
 		Pixel += FRAME_WIDTH;
 	}
 }
@@ -245,6 +245,9 @@ struct gpu_unai_t {
 
 	gpu_unai_config_t config;
 
+	u32 pixel_count;        // Running count of pixels rasterized, sampled per
+	                        //  primitive by do_cmd_list() for perfmon stats
+
 	u8  LightLUT[32*32];    // 5-bit lighting LUT (gpu_inner_light.h)
 	u32 DitherMatrix[64];   // Matrix of dither coefficients
 };
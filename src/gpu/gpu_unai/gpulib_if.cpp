@@ -26,6 +26,7 @@
 #include <string.h>
 #include "gpu/gpulib/gpu.h"
 #include "port.h"
+#include "perfmon.h"
 #include "gpu_unai.h"
 
 #define GPU_INLINE static inline __attribute__((always_inline))
@@ -214,6 +215,39 @@ static void gpuGP0Cmd_0xEx(gpu_unai_t &gpu_unai, u32 cmd_word)
 
 extern const unsigned char cmd_lengths[256];
 
+// Attribute a primitive and the pixels it rasterized to perfmon GPU stats
+static void gpu_stats_prim(u32 cmd, u32 pixels, u32 poly_driver_idx)
+{
+  PmonGpuPrim prim;
+  switch (cmd >> 5) {
+    case 0x0:
+      if (cmd != 0x02) return;
+      prim = PMON_GPU_FILL;
+      break;
+    case 0x1:
+      // Polys: bit 4 is Gouraud shading, bit 2 is texturing
+      if (cmd & 0x10)
+        prim = (cmd & 0x04) ? PMON_GPU_POLY_GT : PMON_GPU_POLY_G;
+      else
+        prim = (cmd & 0x04) ? PMON_GPU_POLY_FT : PMON_GPU_POLY_F;
+      pmon_gpu.poly_driver_pixels[poly_driver_idx] += pixels;
+      break;
+    case 0x2:
+      prim = (cmd & 0x10) ? PMON_GPU_LINE_G : PMON_GPU_LINE_F;
+      break;
+    case 0x3:
+      prim = (cmd & 0x04) ? PMON_GPU_SPRITE : PMON_GPU_TILE;
+      break;
+    case 0x4:
+      prim = PMON_GPU_VRAM_COPY;
+      break;
+    default:
+      // VRAM transfers are counted by gpulib, the rest are state changes
+      return;
+  }
+  pmonGpuPrim(prim, pixels);
+}
+
 int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
 {
   unsigned int cmd = 0, len, i;
@@ -243,6 +277,8 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       gpu_unai.PacketBuffer.U4[i] = list[i];
 
     PtrUnion packet = { .ptr = (void*)&gpu_unai.PacketBuffer };
+    u32 pixel_count_start = gpu_unai.pixel_count;
+    u32 poly_driver_idx = 0;
 
     switch (cmd)
     {
@@ -254,11 +290,11 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x21:
       case 0x22:
       case 0x23: {          // Monochrome 3-pt poly
-        PP driver = gpuPolySpanDrivers[
+        poly_driver_idx =
           (gpu_unai.blit_mask?1024:0) |
           Blending_Mode |
-          gpu_unai.Masking | Blending | gpu_unai.PixelMSB
-        ];
+          gpu_unai.Masking | Blending | gpu_unai.PixelMSB;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyF(packet, driver, false);
       } break;
 
@@ -282,7 +318,8 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
             driver_idx |= Lighting;
         }
 
-        PP driver = gpuPolySpanDrivers[driver_idx];
+        poly_driver_idx = driver_idx;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyFT(packet, driver, false);
       } break;
 
@@ -290,11 +327,11 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x29:
       case 0x2A:
       case 0x2B: {          // Monochrome 4-pt poly
-        PP driver = gpuPolySpanDrivers[
+        poly_driver_idx =
           (gpu_unai.blit_mask?1024:0) |
           Blending_Mode |
-          gpu_unai.Masking | Blending | gpu_unai.PixelMSB
-        ];
+          gpu_unai.Masking | Blending | gpu_unai.PixelMSB;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyF(packet, driver, true); // is_quad = true
       } break;
 
@@ -318,7 +355,8 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
             driver_idx |= Lighting;
         }
 
-        PP driver = gpuPolySpanDrivers[driver_idx];
+        poly_driver_idx = driver_idx;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyFT(packet, driver, true); // is_quad = true
       } break;
 
@@ -330,12 +368,12 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         // this is an untextured poly, so CF_LIGHT (texture blend)
         // shouldn't apply. Until the original array of template
         // instantiation ptrs is fixed, we're stuck with this. (TODO)
-        PP driver = gpuPolySpanDrivers[
+        poly_driver_idx =
           (gpu_unai.blit_mask?1024:0) |
           Dithering |
           Blending_Mode |
-          gpu_unai.Masking | Blending | 129 | gpu_unai.PixelMSB
-        ];
+          gpu_unai.Masking | Blending | 129 | gpu_unai.PixelMSB;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyG(packet, driver, false);
       } break;
 
@@ -345,12 +383,12 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x37: {          // Gouraud-shaded, textured 3-pt poly
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
         gpuSetTexture (gpu_unai.PacketBuffer.U4[5] >> 16);
-        PP driver = gpuPolySpanDrivers[
+        poly_driver_idx =
           (gpu_unai.blit_mask?1024:0) |
           Dithering |
           Blending_Mode | gpu_unai.TEXT_MODE |
-          gpu_unai.Masking | Blending | ((Lighting)?129:0) | gpu_unai.PixelMSB
-        ];
+          gpu_unai.Masking | Blending | ((Lighting)?129:0) | gpu_unai.PixelMSB;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyGT(packet, driver, false);
       } break;
 
@@ -359,12 +397,12 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x3A:
       case 0x3B: {          // Gouraud-shaded 4-pt poly
         // See notes regarding '129' for 0x30..0x33 further above -senquack
-        PP driver = gpuPolySpanDrivers[
+        poly_driver_idx =
           (gpu_unai.blit_mask?1024:0) |
           Dithering |
           Blending_Mode |
-          gpu_unai.Masking | Blending | 129 | gpu_unai.PixelMSB
-        ];
+          gpu_unai.Masking | Blending | 129 | gpu_unai.PixelMSB;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyG(packet, driver, true); // is_quad = true
       } break;
 
@@ -374,12 +412,12 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
       case 0x3F: {          // Gouraud-shaded, textured 4-pt poly
         gpuSetCLUT    (gpu_unai.PacketBuffer.U4[2] >> 16);
         gpuSetTexture (gpu_unai.PacketBuffer.U4[5] >> 16);
-        PP driver = gpuPolySpanDrivers[
+        poly_driver_idx =
           (gpu_unai.blit_mask?1024:0) |
           Dithering |
           Blending_Mode | gpu_unai.TEXT_MODE |
-          gpu_unai.Masking | Blending | ((Lighting)?129:0) | gpu_unai.PixelMSB
-        ];
+          gpu_unai.Masking | Blending | ((Lighting)?129:0) | gpu_unai.PixelMSB;
+        PP driver = gpuPolySpanDrivers[poly_driver_idx];
         gpuDrawPolyGT(packet, driver, true); // is_quad = true
       } break;
 
@@ -593,6 +631,9 @@ int do_cmd_list(unsigned int *list, int list_len, int *last_cmd)
         gpuGP0Cmd_0xEx(gpu_unai, gpu_unai.PacketBuffer.U4[0]);
       } break;
     }
+
+    if (pmon_gpu.enabled)
+      gpu_stats_prim(cmd, gpu_unai.pixel_count - pixel_count_start, poly_driver_idx);
   }
 
 breakloop:
@@ -14,6 +14,7 @@
 #include "plugins.h"    // For GPUFreeze_t, GPUScreenInfo_t
 #include "gpu.h"
 #include "plugin_lib.h"
+#include "perfmon.h"
 
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #ifdef __GNUC__
@@ -40,6 +41,113 @@ gpulib_config_t gpulib_config;
 static noinline int do_cmd_buffer(uint32_t *data, int count);
 static void finish_vram_transfer(int is_read);
 
+// GP0/GP1 stream recorder state. Records are built up in 'buf' so that
+//  the count in their header word is known before they are written out.
+static struct {
+  FILE *f;
+  uint32_t *buf;
+  int buf_len, buf_size;
+  int buf_type;         // Type of record pending in buf, 0 if none
+} rec;
+
+static void rec_flush(void)
+{
+  if (rec.buf_type == 0)
+    return;
+  uint32_t hdr = (rec.buf_type << 24) | rec.buf_len;
+  fwrite(&hdr, 4, 1, rec.f);
+  if (rec.buf_len)
+    fwrite(rec.buf, 4, rec.buf_len, rec.f);
+  rec.buf_type = 0;
+  rec.buf_len = 0;
+}
+
+// Append words to the pending record, starting a new one if its type differs
+static noinline void rec_append(int type, const uint32_t *data, int count)
+{
+  if (rec.f == NULL)
+    return;
+  if (rec.buf_type != type || rec.buf_len + count > 0xffffff) {
+    rec_flush();
+    rec.buf_type = type;
+  }
+  if (rec.buf_len + count > rec.buf_size) {
+    int new_size = rec.buf_size ? rec.buf_size : 4096;
+    while (new_size < rec.buf_len + count)
+      new_size *= 2;
+    uint32_t *new_buf = (uint32_t *)realloc(rec.buf, new_size * 4);
+    if (new_buf == NULL) {
+      fprintf(stderr, "gpulib: out of memory recording GPU stream, stopping\n");
+      gpulib_record_stop();
+      return;
+    }
+    rec.buf = new_buf;
+    rec.buf_size = new_size;
+  }
+  memcpy(rec.buf + rec.buf_len, data, count * 4);
+  rec.buf_len += count;
+}
+
+// Write a complete record that is never merged with following ones
+static noinline void rec_write(int type, const uint32_t *data, int count)
+{
+  rec_append(type, data, count);
+  if (rec.f)
+    rec_flush();
+}
+
+static noinline void rec_write_count(int type, int count)
+{
+  rec_flush();
+  uint32_t hdr = (type << 24) | (count & 0xffffff);
+  fwrite(&hdr, 4, 1, rec.f);
+}
+
+int gpulib_record_start(const char *filename)
+{
+  gpulib_record_stop();
+
+  FILE *f = fopen(filename, "wb");
+  if (f == NULL) {
+    fprintf(stderr, "gpulib: could not open %s for GPU stream recording\n", filename);
+    return -1;
+  }
+
+  GPUFreeze_t *freeze = (GPUFreeze_t *)calloc(1, sizeof(GPUFreeze_t));
+  if (freeze == NULL) {
+    fclose(f);
+    return -1;
+  }
+  freeze->ulFreezeVersion = 1;
+  GPU_freeze(1, freeze);
+
+  struct gpurec_header hdr;
+  memcpy(hdr.magic, GPUREC_MAGIC, sizeof(hdr.magic));
+  hdr.version = GPUREC_VERSION;
+  hdr.freeze_size = sizeof(GPUFreeze_t);
+  fwrite(&hdr, sizeof(hdr), 1, f);
+  fwrite(freeze, sizeof(GPUFreeze_t), 1, f);
+  free(freeze);
+
+  rec.f = f;
+  rec.buf_type = 0;
+  rec.buf_len = 0;
+  printf("gpulib: recording GPU stream to %s\n", filename);
+  return 0;
+}
+
+void gpulib_record_stop(void)
+{
+  if (rec.f == NULL)
+    return;
+  rec_flush();
+  fclose(rec.f);
+  rec.f = NULL;
+  free(rec.buf);
+  rec.buf = NULL;
+  rec.buf_size = 0;
+}
+
 static noinline void do_cmd_reset(void)
 {
   if (unlikely(gpu.cmd_len > 0))
@@ -238,6 +346,7 @@ long GPU_init(void)
 
 long GPU_shutdown(void)
 {
+  gpulib_record_stop();
   renderer_finish();
   long ret = vout_finish();
 
@@ -262,6 +371,9 @@ void GPU_writeStatus(uint32_t data)
   static const short vres[4] = { 240, 480, 256, 480 };
   uint32_t cmd = data >> 24;
 
+  if (unlikely(rec.f != NULL))
+    rec_write(GPUREC_WRITE_STATUS, &data, 1);
+
   if (cmd < ARRAY_SIZE(gpu.regs)) {
     if (cmd > 1 && cmd != 5 && gpu.regs[cmd] == data)
       return;
@@ -511,6 +623,8 @@ static noinline int do_cmd_buffer(uint32_t *data, int count)
   uint32_t old_e3 = gpu.ex_regs[3];
   int vram_dirty = 0;
 
+  pmonSubsysBegin(PMON_SUBSYS_GPU);
+
   // process buffer
   for (pos = 0; pos < count; )
   {
@@ -530,6 +644,9 @@ static noinline int do_cmd_buffer(uint32_t *data, int count)
       }
       // consume vram write/read cmd
       start_vram_transfer(data[pos + 1], data[pos + 2], (cmd & 0xe0) == 0xc0);
+      if (pmon_gpu.enabled)
+        pmonGpuPrim((cmd & 0xe0) == 0xc0 ? PMON_GPU_VRAM_READ : PMON_GPU_VRAM_WRITE,
+                    gpu.dma.w * gpu.dma.h);
       pos += 3;
       continue;
     }
@@ -556,6 +673,8 @@ static noinline int do_cmd_buffer(uint32_t *data, int count)
   if (old_e3 != gpu.ex_regs[3])
     decide_frameskip_allow(gpu.ex_regs[3]);
 
+  pmon_gpu.cmd_words += pos;
+  pmonSubsysEnd(PMON_SUBSYS_GPU);
   return count - pos;
 }
 
@@ -573,6 +692,9 @@ void GPU_writeDataMem(uint32_t *mem, int count)
 
   log_io("gpu_dma_write %p %d\n", mem, count);
 
+  if (unlikely(rec.f != NULL))
+    rec_write(GPUREC_WRITE_DATA_MEM, mem, count);
+
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
@@ -584,6 +706,8 @@ void GPU_writeDataMem(uint32_t *mem, int count)
 void GPU_writeData(uint32_t data)
 {
   log_io("gpu_write %08x\n", data);
+  if (unlikely(rec.f != NULL))
+    rec_append(GPUREC_WRITE_DATA, &data, 1);
   gpu.cmd_buffer[gpu.cmd_len++] = data;
   if (gpu.cmd_len >= CMD_BUFFER_LEN)
     flush_cmd_buffer();
@@ -616,6 +740,11 @@ long GPU_dmaChain(uint32_t *rambase, uint32_t start_addr)
     log_io(".chain %08x #%d\n", (list - rambase) * 4, len);
 
     if (len) {
+      if (unlikely(rec.f != NULL)) {
+        uint32_t node_len = len;
+        rec_append(GPUREC_DMA_CHAIN, &node_len, 1);
+        rec_append(GPUREC_DMA_CHAIN, list + 1, len);
+      }
       left = do_cmd_buffer(list + 1, len);
       if (left)
         log_anomaly("GPUdmaChain: discarded %d/%d words\n", left, len);
@@ -635,6 +764,9 @@ long GPU_dmaChain(uint32_t *rambase, uint32_t start_addr)
     }
   }
 
+  if (unlikely(rec.f != NULL))
+    rec_flush();
+
   if (ld_addr != 0) {
     // remove loop detection markers
     count -= LD_THRESHOLD + 2;
@@ -658,6 +790,9 @@ void GPU_readDataMem(uint32_t *mem, int count)
 {
   log_io("gpu_dma_read  %p %d\n", mem, count);
 
+  if (unlikely(rec.f != NULL))
+    rec_write_count(GPUREC_READ_DATA, count);
+
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
@@ -669,6 +804,9 @@ uint32_t GPU_readData(void)
 {
   uint32_t ret;
 
+  if (unlikely(rec.f != NULL))
+    rec_write_count(GPUREC_READ_DATA, 1);
+
   if (unlikely(gpu.cmd_len > 0))
     flush_cmd_buffer();
 
@@ -705,7 +843,15 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
       memcpy(freeze->ulControl + 0xe0, gpu.ex_regs, sizeof(gpu.ex_regs));
       freeze->ulStatus = gpu.status.reg;
       break;
-    case 0: // load
+    case 0: { // load
+      // Savestate loaded while recording: store the whole state, and
+      //  don't record the register writes below, they're part of it.
+      FILE *rec_f = rec.f;
+      if (unlikely(rec_f != NULL)) {
+        rec_write(GPUREC_LOAD_STATE, (uint32_t *)freeze, sizeof(*freeze) / 4);
+        rec.f = NULL;
+      }
+
       memcpy(gpu.vram, freeze->psxVRam, 1024 * 512 * 2);
       memcpy(gpu.regs, freeze->ulControl, sizeof(gpu.regs));
       memcpy(gpu.ex_regs, freeze->ulControl + 0xe0, sizeof(gpu.ex_regs));
@@ -717,7 +863,8 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
       }
       renderer_sync_ecmds(gpu.ex_regs);
       renderer_update_caches(0, 0, 1024, 512);
-      break;
+      rec.f = rec_f;
+    } break;
   }
 
   return 1;
@@ -725,6 +872,9 @@ long GPU_freeze(uint32_t type, GPUFreeze_t *freeze)
 
 void GPU_updateLace(void)
 {
+  if (unlikely(rec.f != NULL))
+    rec_write_count(GPUREC_UPDATE_LACE, 0);
+
   if (gpu.cmd_len > 0)
     flush_cmd_buffer();
   renderer_flush_queues();
@@ -750,13 +900,20 @@ void GPU_updateLace(void)
     gpu.frameskip.frame_ready = 0;
   }
 
+  pmonSubsysBegin(PMON_SUBSYS_VOUT);
   vout_update();
+  pmonSubsysEnd(PMON_SUBSYS_VOUT);
   gpu.state.fb_dirty = 0;
   gpu.state.blanked = 0;
 }
 
 void GPU_vBlank(int is_vblank, int lcf)
 {
+  if (unlikely(rec.f != NULL)) {
+    uint32_t val = (is_vblank ? 1 : 0) | (lcf ? 2 : 0);
+    rec_write(GPUREC_VBLANK, &val, 1);
+  }
+
   int interlace = gpu.state.allow_interlace
     && gpu.status.interlace && gpu.status.dheight;
   // interlace doesn't look nice on progressive displays,
@@ -138,6 +138,37 @@ void renderer_set_interlace(int enable, int is_odd);
 void renderer_set_config(const gpulib_config_t *config);
 void renderer_notify_res_change(void);
 
+/////////////////////////////////////////////////////////////////////////////
+// GP0/GP1 stream recorder, see gpu.cpp and gpu_replay.cpp
+//
+// File layout, all words in host byte order:
+//   gpurec_header
+//   GPUFreeze_t snapshot of initial GPU state (VRAM, control regs)
+//   records, each a (type << 24 | count) word followed by 'count' words
+#define GPUREC_MAGIC    "GPUREC\x1a\0"
+#define GPUREC_VERSION  1
+
+struct gpurec_header {
+  char     magic[8];
+  uint32_t version;
+  uint32_t freeze_size;   // sizeof(GPUFreeze_t)
+};
+
+enum {
+  GPUREC_WRITE_DATA = 1,  // GPU_writeData() words, consecutive calls merged
+  GPUREC_WRITE_DATA_MEM,  // GPU_writeDataMem() block
+  GPUREC_DMA_CHAIN,       // GPU_dmaChain() nodes, each stored as: len, len words
+  GPUREC_WRITE_STATUS,    // GPU_writeStatus() word
+  GPUREC_READ_DATA,       // GPU_readData()/GPU_readDataMem(): 'count' is #words
+                          //  read, no payload
+  GPUREC_UPDATE_LACE,     // GPU_updateLace(), no payload. Marks end of frame.
+  GPUREC_VBLANK,          // GPU_vBlank(): one word, is_vblank | (lcf << 1)
+  GPUREC_LOAD_STATE       // GPU_freeze() load: a whole GPUFreeze_t
+};
+
+int  gpulib_record_start(const char *filename);
+void gpulib_record_stop(void);
+
 int  vout_init(void);
 int  vout_finish(void);
 void vout_update(void);
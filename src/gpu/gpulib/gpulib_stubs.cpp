@@ -0,0 +1,31 @@
+/*
+ * Stubs for running gpulib and a renderer outside of the emulator, as
+ * the standalone tools do (bench_gpu, gpu_replay). Provides the symbols
+ * gpulib otherwise gets from video output, plugin_lib, perfmon and the
+ * emulator core.
+ *
+ * This work is licensed under the terms of any of these licenses
+ * (at your option):
+ *  - GNU GPL, version 2 or later.
+ *  - GNU LGPL, version 2.1 or later.
+ * See the COPYING file in the top-level directory.
+ */
+
+#include "plugins.h"
+#include "plugin_lib.h"
+#include "perfmon.h"
+#include "gpu.h"
+
+PcsxConfig Config;
+struct pl_data_t pl_data;
+struct pmon_subsys_t pmon_subsys;
+struct pmon_gpu_t pmon_gpu;
+uint32_t hSyncCount, frame_counter;
+
+void pl_clear_borders() {}
+
+int  vout_init(void) { return 0; }
+int  vout_finish(void) { return 0; }
+void vout_update(void) {}
+void vout_blank(void) {}
+void vout_set_config(const gpulib_config_t *config) {}
@@ -0,0 +1,462 @@
+/***************************************************************************
+*   Copyright (C) 2016 PCSX4ALL Team                                      *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+/*
+ * Standalone GTE benchmark and golden-result checker, built with
+ * 'make bench-gte'. Only gte.cpp is linked in.
+ *
+ * Every GTE op is run over the same sequence of pseudo-random register
+ * states (fixed seed). Half of them are typical of real 3D scenes
+ * (unit-scale matrices, nearby vertices, screen-sized offsets), the other
+ * half are drawn with log-uniform magnitudes over the full register
+ * widths, to cover the saturating/overflowing paths and FLAG bits.
+ * Opcode fields (sf, lm, mx, v, cv) are randomized per case as well.
+ *
+ * For each op, all 64 visible GTE registers after every case are folded
+ * into a hash, and FLAG separately into another. These are compared
+ * against a golden file recorded from a known-good build:
+ *
+ *   bench_gte -record gte_golden.txt    Record golden hashes
+ *   bench_gte -check gte_golden.txt     Compare, exit status 1 on mismatch
+ *   bench_gte -dump out.txt [op]        Write every case's inputs/outputs
+ *                                       as text, to diff two builds
+ *   bench_gte [-t seconds] [op]         Benchmark only: ops/sec per op
+ *
+ * NOTE: gte.cpp selects its divide and overflow-checking code by target
+ *  architecture, so golden files are only comparable between builds with
+ *  the same configuration. The configuration is stored in the file and
+ *  checked. src/gte_golden.txt was recorded from a host (x86) build.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "gte.h"
+#include "psxmem.h"
+
+// Only symbols gte.cpp needs from the rest of the emulator
+psxRegisters psxRegs;
+u32  psxMemRead32(u32 mem) { return 0; }
+void psxMemWrite32(u32 mem, u32 value) {}
+
+// Must match selection of GTE_USE_NATIVE_DIVIDE, PARANOID_OVERFLOW_CHECKING
+//  in gte.cpp
+#if defined(__mips__)
+#define GTE_CONFIG_DIVIDE "native"
+#else
+#define GTE_CONFIG_DIVIDE "table"
+#endif
+#if !(defined(__arm__) || defined(__mips__))
+#define GTE_CONFIG_OVERFLOW "paranoid"
+#else
+#define GTE_CONFIG_OVERFLOW "fast"
+#endif
+#define GTE_CONFIG "divide=" GTE_CONFIG_DIVIDE ",overflow=" GTE_CONFIG_OVERFLOW
+
+#define NUM_CASES 4096
+
+// Opcode argument bits, pre-shifted right by 10 like gte.cpp expects
+#define ARG_SF_LM  0x201
+#define ARG_MVMVA  0x3f9   // sf, mx, v, cv, lm
+
+struct GteOp {
+	const char *name;
+	void (*fn)(void);
+	void (*fn_arg)(u32 gteop);
+	u32  arg_mask;
+};
+
+static const GteOp ops[] = {
+	{ "RTPS",  gteRTPS,  NULL,      0 },
+	{ "RTPT",  gteRTPT,  NULL,      0 },
+	{ "NCLIP", gteNCLIP, NULL,      0 },
+	{ "AVSZ3", gteAVSZ3, NULL,      0 },
+	{ "AVSZ4", gteAVSZ4, NULL,      0 },
+	{ "MVMVA", NULL,     gteMVMVA,  ARG_MVMVA },
+	{ "SQR",   NULL,     gteSQR,    ARG_SF_LM },
+	{ "OP",    NULL,     gteOP,     ARG_SF_LM },
+	{ "NCS",   gteNCS,   NULL,      0 },
+	{ "NCT",   gteNCT,   NULL,      0 },
+	{ "NCCS",  gteNCCS,  NULL,      0 },
+	{ "NCCT",  gteNCCT,  NULL,      0 },
+	{ "NCDS",  gteNCDS,  NULL,      0 },
+	{ "NCDT",  gteNCDT,  NULL,      0 },
+	{ "CC",    gteCC,    NULL,      0 },
+	{ "CDP",   gteCDP,   NULL,      0 },
+	{ "DCPL",  NULL,     gteDCPL,   ARG_SF_LM },
+	{ "DPCS",  NULL,     gteDPCS,   ARG_SF_LM },
+	{ "DPCT",  gteDPCT,  NULL,      0 },
+	{ "INTPL", NULL,     gteINTPL,  ARG_SF_LM },
+	{ "GPF",   NULL,     gteGPF,    ARG_SF_LM },
+	{ "GPL",   NULL,     gteGPL,    ARG_SF_LM },
+};
+
+#define NUM_OPS (int)(sizeof(ops) / sizeof(ops[0]))
+
+// Complete register state, as seen through MFC2/CFC2
+struct GteState {
+	u32 data[32];
+	u32 ctrl[32];
+};
+
+static u32 rng_state;
+
+static inline u32 rng()
+{
+	// xorshift32
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 17;
+	rng_state ^= rng_state << 5;
+	return rng_state;
+}
+
+// Random value with log-uniform magnitude up to 'bits' bits, random sign
+static inline u32 rnd_bits(int bits)
+{
+	s32 v = (s32)(rng() >> (32 - bits));
+	v >>= rng() % bits;
+	return (rng() & 1) ? (u32)-v : (u32)v;
+}
+
+static inline u32 rnd_pair16(int bits_l = 16, int bits_h = 16)
+{
+	return (rnd_bits(bits_l) & 0xffff) | (rnd_bits(bits_h) << 16);
+}
+
+// Register state like a game would set up for 3D rendering
+static void typical_state(GteState *s)
+{
+	for (int i=0; i < 32; ++i)
+		s->data[i] = rnd_pair16(11, 11);       // Vectors, SXY FIFO, MAC
+	s->data[6]  = rng();                       // RGBC
+	for (int i=8; i <= 11; ++i)
+		s->data[i] = rng() % 0x1001;           // IR0..3
+	for (int i=16; i <= 19; ++i)
+		s->data[i] = rng() & 0xffff;           // SZ FIFO
+	for (int i=20; i <= 22; ++i)
+		s->data[i] = rng();                    // RGB FIFO
+
+	for (int i=0; i < 32; ++i)
+		s->ctrl[i] = rnd_pair16(13, 13);       // Matrices are 1.3.12 fixed-pt
+	s->ctrl[5]  = rnd_bits(11);                // TRX
+	s->ctrl[6]  = rnd_bits(11);                // TRY
+	s->ctrl[7]  = 0x400 + rng() % 0x4000;      // TRZ, in front of camera
+	for (int i=13; i <= 15; ++i)
+		s->ctrl[i] = rnd_bits(13);             // Background color
+	for (int i=21; i <= 23; ++i)
+		s->ctrl[i] = rnd_bits(13);             // Far color
+	s->ctrl[24] = (160 + rnd_bits(6)) << 16;   // OFX
+	s->ctrl[25] = (120 + rnd_bits(6)) << 16;   // OFY
+	s->ctrl[26] = 100 + rng() % 1000;          // H
+	s->ctrl[27] = rnd_bits(16);                // DQA
+	s->ctrl[28] = rnd_bits(25);                // DQB
+	s->ctrl[29] = rng() % 0x400;               // ZSF3
+	s->ctrl[30] = rng() % 0x400;               // ZSF4
+	s->ctrl[31] = 0;
+}
+
+static void random_state(GteState *s)
+{
+	if (rng() & 1) {
+		typical_state(s);
+		return;
+	}
+
+	for (int i=0; i < 32; ++i) {
+		s->data[i] = (rng() & 3) ? rnd_pair16() : rng();
+		s->ctrl[i] = (rng() & 3) ? rnd_pair16() : rng();
+	}
+	// Translation and far color vectors are 32-bit
+	for (int i=5; i <= 7; ++i)  s->ctrl[i] = rnd_bits(32);
+	for (int i=13; i <= 15; ++i) s->ctrl[i] = rnd_bits(32);
+	for (int i=21; i <= 23; ++i) s->ctrl[i] = rnd_bits(32);
+	// Screen offset is 16.16 fixed point, H is unsigned 16-bit
+	s->ctrl[24] = rnd_bits(27);
+	s->ctrl[25] = rnd_bits(27);
+	s->ctrl[26] = rng() & 0xffff;
+	// Start with FLAG clear, like after any GTE op
+	s->ctrl[31] = 0;
+}
+
+static void load_state(const GteState *s)
+{
+	memset(&psxRegs.CP2D, 0, sizeof(psxRegs.CP2D));
+	memset(&psxRegs.CP2C, 0, sizeof(psxRegs.CP2C));
+	for (int i=0; i < 32; ++i)
+		gtecalcCTC2(s->ctrl[i], i);
+	for (int i=0; i < 32; ++i) {
+		// 15 (SXYP) would push the SXY FIFO, 28 (IRGB) overwrites IR1..3
+		if (i == 15 || i == 28)
+			continue;
+		gtecalcMTC2(s->data[i], i);
+	}
+}
+
+static void save_state(GteState *s)
+{
+	for (int i=0; i < 32; ++i)
+		s->data[i] = gtecalcMFC2(i);
+	memcpy(s->ctrl, psxRegs.CP2C.r, sizeof(s->ctrl));
+}
+
+static inline void run_op(const GteOp &op, u32 arg)
+{
+	if (op.fn)
+		op.fn();
+	else
+		op.fn_arg(arg);
+}
+
+static inline u32 hash_words(u32 h, const u32 *w, int n)
+{
+	// FNV-1a, one word at a time
+	for (int i=0; i < n; ++i) {
+		h ^= w[i];
+		h *= 16777619;
+	}
+	return h;
+}
+
+struct OpResult {
+	u32 result_hash;
+	u32 flag_hash;
+	int flag_cases;   // Cases that set any FLAG bit
+};
+
+static void check_op(int op_idx, OpResult *res, FILE *dump)
+{
+	const GteOp &op = ops[op_idx];
+	GteState in, out;
+
+	rng_state = 0x9e3779b9 + op_idx;
+	res->result_hash = res->flag_hash = 2166136261u;
+	res->flag_cases = 0;
+
+	for (int n=0; n < NUM_CASES; ++n) {
+		random_state(&in);
+		u32 arg = rng() & op.arg_mask;
+
+		load_state(&in);
+		run_op(op, arg);
+		save_state(&out);
+
+		res->result_hash = hash_words(res->result_hash, out.data, 32);
+		res->result_hash = hash_words(res->result_hash, out.ctrl, 32);
+		res->flag_hash = hash_words(res->flag_hash, &out.ctrl[31], 1);
+		if (out.ctrl[31])
+			res->flag_cases++;
+
+		if (dump) {
+			fprintf(dump, "%s case %d arg %03x\n", op.name, n, arg);
+			for (int i=0; i < 32; ++i)
+				fprintf(dump, "  d%-2d %08x -> %08x   c%-2d %08x -> %08x\n",
+				        i, in.data[i], out.data[i], i, in.ctrl[i], out.ctrl[i]);
+		}
+	}
+}
+
+static double now_sec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+// Returns ops per second
+static double bench_op(int op_idx, double min_secs)
+{
+	const GteOp &op = ops[op_idx];
+	const int num_states = 64, runs_per_state = 64;
+	static GteState states[num_states];
+	static u32 args[num_states];
+
+	rng_state = 0x12345678 + op_idx;
+	for (int i=0; i < num_states; ++i) {
+		random_state(&states[i]);
+		args[i] = rng() & op.arg_mask;
+	}
+
+	// Each state is loaded once and the op run on it repeatedly, so the
+	//  cost of load_state() is mostly amortized. State evolves between
+	//  runs, but stays within what the op itself produces.
+	unsigned long long count = 0;
+	double secs, start = now_sec();
+	do {
+		for (int i=0; i < num_states; ++i) {
+			load_state(&states[i]);
+			u32 arg = args[i];
+			for (int j=0; j < runs_per_state; ++j)
+				run_op(op, arg);
+		}
+		count += num_states * runs_per_state;
+		secs = now_sec() - start;
+	} while (secs < min_secs);
+
+	return (double)count / secs;
+}
+
+static int find_op(const char *name)
+{
+	for (int i=0; i < NUM_OPS; ++i)
+		if (strcasecmp(ops[i].name, name) == 0)
+			return i;
+	return -1;
+}
+
+static int record_golden(const char *filename)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		printf("ERROR: could not open %s for writing\n", filename);
+		return 1;
+	}
+	fprintf(f, "# GTE golden results: op cases result_hash flag_hash flag_cases\n");
+	fprintf(f, "config %s\n", GTE_CONFIG);
+	for (int i=0; i < NUM_OPS; ++i) {
+		OpResult res;
+		check_op(i, &res, NULL);
+		fprintf(f, "%s %d %08x %08x %d\n", ops[i].name, NUM_CASES,
+		        res.result_hash, res.flag_hash, res.flag_cases);
+	}
+	fclose(f);
+	printf("Recorded golden results for %d ops to %s\n", NUM_OPS, filename);
+	return 0;
+}
+
+static int check_golden(const char *filename)
+{
+	FILE *f = fopen(filename, "r");
+	if (!f) {
+		printf("ERROR: could not open %s\n", filename);
+		return 1;
+	}
+
+	char line[256], name[32], config[128] = "";
+	int failed = 0, checked = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "config %127s", config) == 1) {
+			if (strcmp(config, GTE_CONFIG) != 0) {
+				printf("ERROR: %s was recorded with GTE config %s, this build is %s\n",
+				       filename, config, GTE_CONFIG);
+				fclose(f);
+				return 1;
+			}
+			continue;
+		}
+
+		int cases, flag_cases;
+		u32 result_hash, flag_hash;
+		if (sscanf(line, "%31s %d %x %x %d", name, &cases, &result_hash,
+		           &flag_hash, &flag_cases) != 5)
+			continue;
+
+		int op_idx = find_op(name);
+		if (op_idx < 0 || cases != NUM_CASES) {
+			printf("%-6s SKIPPED (unknown op or case count)\n", name);
+			continue;
+		}
+
+		OpResult res;
+		check_op(op_idx, &res, NULL);
+		checked++;
+		bool results_ok = (res.result_hash == result_hash);
+		bool flag_ok = (res.flag_hash == flag_hash);
+		if (results_ok && flag_ok) {
+			printf("%-6s OK\n", name);
+		} else {
+			failed++;
+			printf("%-6s FAILED:%s%s (FLAG set in %d cases, golden %d)\n", name,
+			       results_ok ? "" : " results differ",
+			       flag_ok ? "" : " FLAG differs",
+			       res.flag_cases, flag_cases);
+		}
+	}
+	fclose(f);
+
+	if (checked == 0) {
+		printf("ERROR: no golden results found in %s\n", filename);
+		return 1;
+	}
+	printf("%d of %d ops match golden results\n", checked - failed, checked);
+	return failed ? 1 : 0;
+}
+
+static int dump_cases(const char *filename, int only_op)
+{
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		printf("ERROR: could not open %s for writing\n", filename);
+		return 1;
+	}
+	for (int i=0; i < NUM_OPS; ++i) {
+		if (only_op >= 0 && i != only_op)
+			continue;
+		OpResult res;
+		check_op(i, &res, f);
+	}
+	fclose(f);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	double min_secs = 0.5;
+	const char *record_file = NULL, *check_file = NULL, *dump_file = NULL;
+	int only_op = -1;
+
+	for (int i=1; i < argc; ++i) {
+		if (strcmp(argv[i], "-t") == 0 && i+1 < argc) {
+			min_secs = atof(argv[++i]);
+		} else if (strcmp(argv[i], "-record") == 0 && i+1 < argc) {
+			record_file = argv[++i];
+		} else if (strcmp(argv[i], "-check") == 0 && i+1 < argc) {
+			check_file = argv[++i];
+		} else if (strcmp(argv[i], "-dump") == 0 && i+1 < argc) {
+			dump_file = argv[++i];
+		} else if (argv[i][0] != '-' && (only_op = find_op(argv[i])) >= 0) {
+			continue;
+		} else {
+			printf("Usage: %s [-t seconds] [-record file | -check file | -dump file] [op]\n",
+			       argv[0]);
+			return 1;
+		}
+	}
+
+	if (record_file)
+		return record_golden(record_file);
+	if (check_file)
+		return check_golden(check_file);
+	if (dump_file)
+		return dump_cases(dump_file, only_op);
+
+	printf("GTE config: %s\n", GTE_CONFIG);
+	printf("%-6s %12s %10s\n", "op", "ops/s", "ns/op");
+	for (int i=0; i < NUM_OPS; ++i) {
+		if (only_op >= 0 && i != only_op)
+			continue;
+		double ops_per_sec = bench_op(i, min_secs);
+		printf("%-6s %12.0f %10.1f\n", ops[i].name, ops_per_sec,
+		       1000000000.0 / ops_per_sec);
+	}
+	return 0;
+}
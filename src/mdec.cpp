@@ -19,6 +19,7 @@
  ***************************************************************************/
 
 #include "mdec.h"
+#include "perfmon.h"
 
 /* memory speed is 1 byte per MDEC_BIAS psx clock
  * That mean (PSXCLK / MDEC_BIAS) B/s
@@ -559,6 +560,8 @@ void psxDma1(u32 adr, u32 bcr, u32 chcr) {
 		mdec.pending_dma1.chcr = chcr;
 		/* do not free the dma */
 	} else {
+		pmonSubsysBegin(PMON_SUBSYS_MDEC);
+
 		image = (u8 *)PSXM(adr);
 
 		if (mdec.reg0 & MDEC0_RGB24) {
@@ -620,6 +623,8 @@ void psxDma1(u32 adr, u32 bcr, u32 chcr) {
 			}
 		}
 
+		pmonSubsysEnd(PMON_SUBSYS_MDEC);
+
 		/* define the power of mdec */
 		MDECOUTDMA_INT(words * MDEC_BIAS);
 	}
@@ -262,9 +262,7 @@ int LoadCdrom() {
 	tmpHead.t_size = SWAP32(tmpHead.t_size);
 	tmpHead.t_addr = SWAP32(tmpHead.t_addr);
 
-#ifdef PSXREC
-	psxCpu->Clear(tmpHead.t_addr, tmpHead.t_size / 4);
-#endif
+	psxCpuClear(tmpHead.t_addr, tmpHead.t_size / 4);
 
 	// Read the rest of the main executable
 	while (tmpHead.t_size & ~2047) {
@@ -311,9 +309,7 @@ int LoadCdromFile(const char *filename, EXE_HEADER *head) {
 	size = head->t_size;
 	addr = head->t_addr;
 
-#ifdef PSXREC
-	psxCpu->Clear(addr, size / 4);
-#endif
+	psxCpuClear(addr, size / 4);
 
 	while (size & ~2047) {
 		incTime();
@@ -488,9 +484,7 @@ int Load(const char *ExePath) {
 						retval = -1;
 						break;
 					}
-#ifdef PSXREC
-					psxCpu->Clear(section_address, section_size / 4);
-#endif
+					psxCpuClear(section_address, section_size / 4);
 				}
 				psxRegs.pc = SWAP32(tmpHead.pc0);
 				psxRegs.GPR.n.gp = SWAP32(tmpHead.gp0);
@@ -535,9 +529,7 @@ int Load(const char *ExePath) {
 									retval = -1;
 									break;
 								}
-#ifdef PSXREC
-								psxCpu->Clear(section_address, section_size / 4);
-#endif
+								psxCpuClear(section_address, section_size / 4);
 							}
 							break;
 						case 3: /* register loading (PC only?) */
@@ -904,6 +896,7 @@ skip_missing_data_hack:
 
 	SaveFuncs.close(f);
 	pl_reset();  // Reset plugin_lib
+	psxMemStatsReset();  // Like psxMemReset(), don't mix in stats from before load
 	return 0;
 
 error:
@@ -57,8 +57,56 @@ static struct {
 	float cpu_cur, cpu_avg, cpu_min, cpu_max;
 	struct timeval tv_last_ru_utime, tv_last_ru_stime;
 #endif
+
+	// Per-subsystem frame times, gathered over the same window as the
+	//  detailed FPS/CPU stats
+	struct {
+		long long usec_last_frame;  // Timestamp of previous frame, 0 if none
+		unsigned frames;
+		long long usec_total[PMON_SUBSYS_COUNT];
+		long long usec_min[PMON_SUBSYS_COUNT];
+		long long usec_max[PMON_SUBSYS_COUNT];
+	} subsys_win;
+
+	// Results, in milliseconds per frame
+	bool subsys_valid;
+	float subsys_min[PMON_SUBSYS_COUNT], subsys_avg[PMON_SUBSYS_COUNT],
+	      subsys_max[PMON_SUBSYS_COUNT], frame_avg;
+
+	// GPU primitive counts, gathered over the same window
+	struct {
+		unsigned frames;
+		unsigned long long prims_total[PMON_GPU_PRIM_COUNT];
+		unsigned long long pixels_total[PMON_GPU_PRIM_COUNT];
+		unsigned prims_max[PMON_GPU_PRIM_COUNT];
+		unsigned pixels_max[PMON_GPU_PRIM_COUNT];
+		unsigned long long cmd_words_total;
+	} gpu_win;
+
+	// Results, per frame
+	bool gpu_valid;
+	float gpu_prims_avg[PMON_GPU_PRIM_COUNT], gpu_pixels_avg[PMON_GPU_PRIM_COUNT];
+	unsigned gpu_prims_max[PMON_GPU_PRIM_COUNT], gpu_pixels_max[PMON_GPU_PRIM_COUNT];
+	float gpu_cmd_words_avg;
+
+	// Poly span drivers that drew the most pixels over the window
+	int gpu_top_drivers;
+	unsigned gpu_top_driver_idx[8];
+	float gpu_top_driver_pixels[8];  // Per frame
 } pmon;
 
+struct pmon_subsys_t pmon_subsys;
+struct pmon_gpu_t pmon_gpu;
+
+static const char * const subsys_names[PMON_SUBSYS_COUNT] = {
+	"CPU", "GPU", "VOUT", "SPU", "CDR", "MDEC", "IDLE"
+};
+
+static const char * const gpu_prim_names[PMON_GPU_PRIM_COUNT] = {
+	"fill", "poly F", "poly FT", "poly G", "poly GT", "line F", "line G",
+	"tile", "sprite", "vram cp", "vram wr", "vram rd"
+};
+
 // Returns # of microseconds spanning interval between tv and tv_old
 static inline suseconds_t tvdiff_usec(const timeval &tv, const timeval &tv_old)
 {
@@ -95,6 +143,144 @@ static float pmonGetCpuUsage(suseconds_t usecs_span)
 }
 #endif //PERFMON_CPU_STATS
 
+static void pmonSubsysResetWindow()
+{
+	pmon.subsys_win.frames = 0;
+	for (int i=0; i < PMON_SUBSYS_COUNT; ++i) {
+		pmon.subsys_win.usec_total[i] = 0;
+		pmon.subsys_win.usec_min[i] = 0x7fffffffffffffffLL;
+		pmon.subsys_win.usec_max[i] = 0;
+	}
+}
+
+static void pmonSubsysReset()
+{
+	pmon_subsys.enabled = Config.PerfmonDetailedStats;
+	memset(pmon_subsys.usec_frame, 0, sizeof(pmon_subsys.usec_frame));
+	pmon.subsys_win.usec_last_frame = 0;
+	pmonSubsysResetWindow();
+}
+
+// Called once per frame: close the frame's subsystem times into the window
+static void pmonSubsysFrameDone(const timeval &tv_now)
+{
+	long long usec_now = (long long)tv_now.tv_sec * 1000000 + tv_now.tv_usec;
+	long long usec_frame = usec_now - pmon.subsys_win.usec_last_frame;
+	bool first_frame = (pmon.subsys_win.usec_last_frame == 0);
+	pmon.subsys_win.usec_last_frame = usec_now;
+
+	if (!first_frame) {
+		// CPU gets whatever frame time wasn't spent elsewhere
+		long long usec_other = 0;
+		for (int i=PMON_SUBSYS_CPU+1; i < PMON_SUBSYS_COUNT; ++i)
+			usec_other += pmon_subsys.usec_frame[i];
+		pmon_subsys.usec_frame[PMON_SUBSYS_CPU] =
+			(usec_frame > usec_other) ? usec_frame - usec_other : 0;
+
+		for (int i=0; i < PMON_SUBSYS_COUNT; ++i) {
+			long long t = pmon_subsys.usec_frame[i];
+			pmon.subsys_win.usec_total[i] += t;
+			if (t < pmon.subsys_win.usec_min[i]) pmon.subsys_win.usec_min[i] = t;
+			if (t > pmon.subsys_win.usec_max[i]) pmon.subsys_win.usec_max[i] = t;
+		}
+		pmon.subsys_win.frames++;
+	}
+
+	memset(pmon_subsys.usec_frame, 0, sizeof(pmon_subsys.usec_frame));
+}
+
+// Called when detailed stats window is complete
+static void pmonSubsysComputeStats()
+{
+	unsigned frames = pmon.subsys_win.frames;
+	pmon.subsys_valid = (frames > 0);
+	if (!pmon.subsys_valid)
+		return;
+
+	pmon.frame_avg = 0;
+	for (int i=0; i < PMON_SUBSYS_COUNT; ++i) {
+		pmon.subsys_min[i] = (float)pmon.subsys_win.usec_min[i] / 1000.0f;
+		pmon.subsys_max[i] = (float)pmon.subsys_win.usec_max[i] / 1000.0f;
+		pmon.subsys_avg[i] = (float)pmon.subsys_win.usec_total[i] / (1000.0f * frames);
+		pmon.frame_avg += pmon.subsys_avg[i];
+	}
+
+	pmonSubsysResetWindow();
+}
+
+static void pmonGpuResetWindow()
+{
+	memset(&pmon.gpu_win, 0, sizeof(pmon.gpu_win));
+	memset(pmon_gpu.poly_driver_pixels, 0, sizeof(pmon_gpu.poly_driver_pixels));
+}
+
+static void pmonGpuReset()
+{
+	pmon_gpu.enabled = Config.PerfmonDetailedStats;
+	memset(pmon_gpu.prims, 0, sizeof(pmon_gpu.prims));
+	memset(pmon_gpu.pixels, 0, sizeof(pmon_gpu.pixels));
+	pmon_gpu.cmd_words = 0;
+	pmonGpuResetWindow();
+}
+
+// Called once per frame: close the frame's GPU counts into the window
+static void pmonGpuFrameDone()
+{
+	for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+		unsigned prims = pmon_gpu.prims[i], pixels = pmon_gpu.pixels[i];
+		pmon.gpu_win.prims_total[i] += prims;
+		pmon.gpu_win.pixels_total[i] += pixels;
+		if (prims > pmon.gpu_win.prims_max[i]) pmon.gpu_win.prims_max[i] = prims;
+		if (pixels > pmon.gpu_win.pixels_max[i]) pmon.gpu_win.pixels_max[i] = pixels;
+	}
+	pmon.gpu_win.cmd_words_total += pmon_gpu.cmd_words;
+	pmon.gpu_win.frames++;
+
+	memset(pmon_gpu.prims, 0, sizeof(pmon_gpu.prims));
+	memset(pmon_gpu.pixels, 0, sizeof(pmon_gpu.pixels));
+	pmon_gpu.cmd_words = 0;
+}
+
+// Called when detailed stats window is complete
+static void pmonGpuComputeStats()
+{
+	unsigned frames = pmon.gpu_win.frames;
+	pmon.gpu_valid = (frames > 0);
+	if (!pmon.gpu_valid)
+		return;
+
+	for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+		pmon.gpu_prims_avg[i] = (float)pmon.gpu_win.prims_total[i] / frames;
+		pmon.gpu_pixels_avg[i] = (float)pmon.gpu_win.pixels_total[i] / frames;
+		pmon.gpu_prims_max[i] = pmon.gpu_win.prims_max[i];
+		pmon.gpu_pixels_max[i] = pmon.gpu_win.pixels_max[i];
+	}
+	pmon.gpu_cmd_words_avg = (float)pmon.gpu_win.cmd_words_total / frames;
+
+	// Insertion-sort the busiest poly span drivers into a short list
+	const int max_top = sizeof(pmon.gpu_top_driver_idx) / sizeof(pmon.gpu_top_driver_idx[0]);
+	unsigned top_pixels[max_top];
+	int num_top = 0;
+	for (unsigned idx=0; idx < PMON_GPU_POLY_DRIVERS; ++idx) {
+		unsigned px = pmon_gpu.poly_driver_pixels[idx];
+		if (px == 0 || (num_top == max_top && px <= top_pixels[num_top-1]))
+			continue;
+		int pos = (num_top < max_top) ? num_top++ : max_top-1;
+		while (pos > 0 && top_pixels[pos-1] < px) {
+			top_pixels[pos] = top_pixels[pos-1];
+			pmon.gpu_top_driver_idx[pos] = pmon.gpu_top_driver_idx[pos-1];
+			--pos;
+		}
+		top_pixels[pos] = px;
+		pmon.gpu_top_driver_idx[pos] = idx;
+	}
+	pmon.gpu_top_drivers = num_top;
+	for (int i=0; i < num_top; ++i)
+		pmon.gpu_top_driver_pixels[i] = (float)top_pixels[i] / frames;
+
+	pmonGpuResetWindow();
+}
+
 void pmonReset()
 {
 	pmon.frame_ctr = 0;
@@ -105,6 +291,10 @@ void pmonReset()
 	pmon.cpu_cur = 0;
 	pmonInitCpuUsage();
 #endif
+	pmon.subsys_valid = false;
+	pmonSubsysReset();
+	pmon.gpu_valid = false;
+	pmonGpuReset();
 	gettimeofday(&pmon.tv_last, 0);
 }
 
@@ -112,6 +302,10 @@ bool pmonUpdate(struct timeval *tv_now)
 {
 	bool ret = false;
 	pmon.frame_ctr++;
+	if (pmon_subsys.enabled)
+		pmonSubsysFrameDone(*tv_now);
+	if (pmon_gpu.enabled)
+		pmonGpuFrameDone();
 	suseconds_t diff = tvdiff_usec(*tv_now, pmon.tv_last);
 
 	if (diff >= 1000000) {
@@ -185,6 +379,11 @@ bool pmonUpdate(struct timeval *tv_now)
 				}
 				pmon.cpu_avg *= 0.25f;
 #endif
+
+				if (pmon_subsys.enabled)
+					pmonSubsysComputeStats();
+				if (pmon_gpu.enabled)
+					pmonGpuComputeStats();
 			}
 		}
 
@@ -205,6 +404,9 @@ void pmonResume()
 #ifdef PERFMON_CPU_STATS
 	pmonInitCpuUsage();
 #endif
+	// Time spent in frontend must not be attributed to any subsystem
+	pmonSubsysReset();
+	pmonGpuReset();
 }
 
 void pmonGetStats(float *fps_cur, float *cpu_cur)
@@ -233,4 +435,36 @@ void pmonPrintStats(bool print_detailed_stats)
 		printf("\n");
 	}
 #endif
+
+	if (print_detailed_stats && pmon.subsys_valid) {
+		printf("ms/frame     min      avg      max  %%frame\n");
+		for (int i=0; i < PMON_SUBSYS_COUNT; ++i) {
+			printf("%-6s %8.2f %8.2f %8.2f  %5.1f%%\n", subsys_names[i],
+			       pmon.subsys_min[i], pmon.subsys_avg[i], pmon.subsys_max[i],
+			       pmon.frame_avg > 0 ? 100.0f * pmon.subsys_avg[i] / pmon.frame_avg : 0.0f);
+		}
+		printf("\n");
+	}
+
+	if (print_detailed_stats && pmon.gpu_valid) {
+		float prims_total = 0, pixels_total = 0;
+		printf("GPU/frame   prims avg    max   pixels avg      max\n");
+		for (int i=0; i < PMON_GPU_PRIM_COUNT; ++i) {
+			printf("%-8s %12.1f %6u %12.0f %8u\n", gpu_prim_names[i],
+			       pmon.gpu_prims_avg[i], pmon.gpu_prims_max[i],
+			       pmon.gpu_pixels_avg[i], pmon.gpu_pixels_max[i]);
+			prims_total += pmon.gpu_prims_avg[i];
+			pixels_total += pmon.gpu_pixels_avg[i];
+		}
+		printf("%-8s %12.1f %6s %12.0f\n", "total", prims_total, "", pixels_total);
+		printf("GP0 words/frame: %.0f  pixels/prim: %.1f\n", pmon.gpu_cmd_words_avg,
+		       prims_total > 0 ? pixels_total / prims_total : 0.0f);
+		if (pmon.gpu_top_drivers > 0) {
+			printf("Top poly span drivers (idx: pixels/frame):");
+			for (int i=0; i < pmon.gpu_top_drivers; ++i)
+				printf(" %03x:%.0f", pmon.gpu_top_driver_idx[i], pmon.gpu_top_driver_pixels[i]);
+			printf("\n");
+		}
+		printf("\n");
+	}
 }
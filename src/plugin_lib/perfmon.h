@@ -43,4 +43,95 @@ void pmonPrintStats(bool print_detailed_stats);
 void pmonPause();
 void pmonResume();
 
+/////////////////////////////////////
+// Per-subsystem time accounting   //
+/////////////////////////////////////
+// Wall time spent inside each subsystem is accumulated per frame while
+//  Config.PerfmonDetailedStats is set, and pmonPrintStats(true) reports
+//  per-frame min/avg/max for each. Begin/End pairs must not be nested for
+//  the same subsystem. CPU time is not measured directly: it is whatever
+//  remains of the frame after all other subsystems and idle time.
+
+enum PmonSubsys {
+	PMON_SUBSYS_CPU = 0,  // Derived, don't pass to pmonSubsysBegin/End
+	PMON_SUBSYS_GPU,      // gpulib do_cmd_buffer()
+	PMON_SUBSYS_VOUT,     // gpulib vout_update() blitting
+	PMON_SUBSYS_SPU,      // SPU_async() sample generation
+	PMON_SUBSYS_CDR,      // CDR_readTrack()
+	PMON_SUBSYS_MDEC,     // MDEC decode
+	PMON_SUBSYS_IDLE,     // Frame limiter sleeping
+	PMON_SUBSYS_COUNT
+};
+
+struct pmon_subsys_t {
+	bool enabled;
+	long long usec_start[PMON_SUBSYS_COUNT];
+	long long usec_frame[PMON_SUBSYS_COUNT];  // Accumulated this frame
+};
+
+extern struct pmon_subsys_t pmon_subsys;
+
+static inline long long pmonGetUsec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static inline void pmonSubsysBegin(PmonSubsys s)
+{
+	if (pmon_subsys.enabled)
+		pmon_subsys.usec_start[s] = pmonGetUsec();
+}
+
+static inline void pmonSubsysEnd(PmonSubsys s)
+{
+	if (pmon_subsys.enabled)
+		pmon_subsys.usec_frame[s] += pmonGetUsec() - pmon_subsys.usec_start[s];
+}
+
+/////////////////////////////////////
+// GPU primitive statistics        //
+/////////////////////////////////////
+// Counted per frame by gpulib and the renderer's do_cmd_list() while
+//  Config.PerfmonDetailedStats is set. Pixel counts are what the rasterizer
+//  actually wrote after clipping, so comparing them against primitive counts
+//  tells whether a scene is primitive-bound or fill-bound.
+
+enum PmonGpuPrim {
+	PMON_GPU_FILL = 0,    // GP0(02h) fill rectangle
+	PMON_GPU_POLY_F,      // Flat-shaded polys (tris and quads)
+	PMON_GPU_POLY_FT,     // Flat-shaded, textured polys
+	PMON_GPU_POLY_G,      // Gouraud-shaded polys
+	PMON_GPU_POLY_GT,     // Gouraud-shaded, textured polys
+	PMON_GPU_LINE_F,      // Flat-shaded lines and polylines
+	PMON_GPU_LINE_G,      // Gouraud-shaded lines and polylines
+	PMON_GPU_TILE,        // Untextured rectangles
+	PMON_GPU_SPRITE,      // Textured rectangles
+	PMON_GPU_VRAM_COPY,   // GP0(80h) VRAM->VRAM
+	PMON_GPU_VRAM_WRITE,  // GP0(A0h) CPU->VRAM
+	PMON_GPU_VRAM_READ,   // GP0(C0h) VRAM->CPU
+	PMON_GPU_PRIM_COUNT
+};
+
+// Size of renderer's poly span driver table (gpu_unai gpuPolySpanDrivers[])
+#define PMON_GPU_POLY_DRIVERS 2048
+
+struct pmon_gpu_t {
+	bool enabled;
+	unsigned prims[PMON_GPU_PRIM_COUNT];   // Counted this frame
+	unsigned pixels[PMON_GPU_PRIM_COUNT];  // Counted this frame
+	unsigned cmd_words;                    // GP0 words processed this frame
+	// Pixels drawn by each poly span driver, over the whole stats window
+	unsigned poly_driver_pixels[PMON_GPU_POLY_DRIVERS];
+};
+
+extern struct pmon_gpu_t pmon_gpu;
+
+static inline void pmonGpuPrim(PmonGpuPrim p, unsigned pixels)
+{
+	pmon_gpu.prims[p]++;
+	pmon_gpu.pixels[p] += pixels;
+}
+
 #endif //PERFMON_H
@@ -138,7 +138,9 @@ void pl_frame_limit(void)
 	}
 
 	if (Config.FrameLimit && (diff > pl_data.frame_interval)) {
+		pmonSubsysBegin(PMON_SUBSYS_IDLE);
 		usleep(diff - pl_data.frame_interval);
+		pmonSubsysEnd(PMON_SUBSYS_IDLE);
 	}
 
 	if (diff < -pl_data.frame_interval) {
@@ -1071,13 +1071,24 @@ static MENUITEM gui_GameMenuItems[] = {
 #define GMENU_SIZE ((sizeof(gui_GameMenuItems) / sizeof(MENUITEM)) - 1)
 static MENU gui_GameMenu = { GMENU_SIZE, 0, 50, 50, (MENUITEM *)&gui_GameMenuItems };
 
+/* Order shown in menu, left to right */
+static const int emu_cores[] = {
+	CPU_INTERPRETER, CPU_CACHED_INTERPRETER,
 #ifdef PSXREC
+	CPU_DYNAREC
+#endif
+};
+#define EMU_NUM_CORES ((int)(sizeof(emu_cores) / sizeof(emu_cores[0])))
+
 static int emu_alter(u32 keys)
 {
+	int i;
+	for (i = 0; i < EMU_NUM_CORES - 1 && emu_cores[i] != Config.Cpu; ++i);
+
 	if (keys & KEY_RIGHT) {
-		if (Config.Cpu == 1) Config.Cpu = 0;
+		if (i < EMU_NUM_CORES - 1) Config.Cpu = emu_cores[i + 1];
 	} else if (keys & KEY_LEFT) {
-		if (Config.Cpu == 0) Config.Cpu = 1;
+		if (i > 0) Config.Cpu = emu_cores[i - 1];
 	}
 
 	return 0;
@@ -1086,10 +1097,12 @@ static int emu_alter(u32 keys)
 static char *emu_show()
 {
 	static char buf[16] = "\0";
-	sprintf(buf, "%s", Config.Cpu ? "int" : "rec");
+	sprintf(buf, "%s", Config.Cpu == CPU_DYNAREC ? "rec" :
+	                   Config.Cpu == CPU_CACHED_INTERPRETER ? "cached int" : "int");
 	return buf;
 }
 
+#ifdef PSXREC
 extern u32 cycle_multiplier; // in mips/recompiler.cpp
 
 static int cycle_alter(u32 keys)
@@ -1296,8 +1309,8 @@ static int settings_defaults()
 }
 
 static MENUITEM gui_SettingsItems[] = {
-#ifdef PSXREC
 	{(char *)"Emulation core   ", NULL, &emu_alter, &emu_show, NULL},
+#ifdef PSXREC
 	{(char *)"Cycle multiplier ", NULL, &cycle_alter, &cycle_show, NULL},
 #endif
 	{(char *)"PSX BIOS         ", &bios_set, &bios_alter, &bios_show, &psx_bios_hint},
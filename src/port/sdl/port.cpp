@@ -1,5 +1,6 @@
 #include <dirent.h>
 #include <unistd.h>
+#include <stddef.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 
@@ -9,6 +10,7 @@
 #include "plugins.h"
 #include "plugin_lib.h"
 #include "perfmon.h"
+#include "psxlockstep.h"
 #include <SDL.h>
 #include <SDL_image.h>
 
@@ -58,14 +60,70 @@ unsigned short *SCREEN;
 static bool pcsx4all_initted = false;
 static bool emu_running = false;
 
+// Headless benchmark mode (-bench <frames>): no SDL window, no audio device,
+//  no frame limiter. Emulation stops after bench.frames emulated frames and
+//  throughput stats are printed to console.
+static struct {
+	int frames;              // 0: benchmark mode disabled
+	int frame_ctr;
+	struct timeval tv_start;
+	unsigned short *screen;  // Off-screen 320x240 buffer standing in for SDL's
+} bench;
+
+// Input movies (-movierec / -movieplay <file>): pad states of every frame
+//  are written to or read back from a file, so benchmark runs can be
+//  repeated with identical input. A movie starts from power-on, or from
+//  the savestate given with -moviestate, which must then be given again
+//  for playback. Emulation must be otherwise deterministic, so settings
+//  that affect timing (-rcntfix, -spuirq, etc.) must match too.
+#define MOVIE_MAGIC            "PCSX4ALL-MOVIE\x1a"
+#define MOVIE_VERSION          1
+#define MOVIE_FLAG_FROM_STATE  (1 << 0)
+
+struct movie_header {
+	char     magic[16];
+	uint32_t version;
+	uint32_t flags;
+	char     cdrom_id[12];
+	uint32_t frames;         // Written when recording stops
+};
+
+static struct {
+	FILE *f;
+	bool recording;
+	bool playing;
+	const char *state_file;  // Savestate movie starts from, NULL: power-on
+	unsigned frame;
+	unsigned frames;         // Length of movie being played
+} movie;
+
+static void movie_stop(void);
+
+// Frame hash log (-hashrec / -hashcheck <file>, benchmark mode only):
+//  a hash of VRAM and PSX RAM is taken every frame and written to, or
+//  compared against, a baseline file. The first frame that differs is
+//  reported and emulation exits with status 1. Used together with
+//  -movieplay, it shows whether a change to the CPU core, GTE or renderer
+//  changed emulated results at all.
+static struct {
+	FILE *f;
+	bool check;              // false: record baseline, true: compare
+	bool baseline_ended;
+	unsigned frame;
+} hashlog;
+
+static void hashlog_stop(void);
+
 void config_load();
 void config_save();
 
 static void pcsx4all_exit(void)
 {
-	if (SDL_MUSTLOCK(screen))
+	if (screen && SDL_MUSTLOCK(screen))
 		SDL_UnlockSurface(screen);
 
+	movie_stop();
+
 	SDL_Quit();
 
 	if (pcsx4all_initted == true) {
@@ -73,10 +131,231 @@ static void pcsx4all_exit(void)
 		psxShutdown();
 	}
 
+	// Don't let settings forced by benchmark mode leak into config file
+	if (bench.frames)
+		return;
+
 	// Store config to file
 	config_save();
 }
 
+static void bench_start(void)
+{
+	bench.frame_ctr = 0;
+	pmonReset();
+	gettimeofday(&bench.tv_start, 0);
+}
+
+// Called once per emulated frame while in benchmark mode
+static void bench_frame(void)
+{
+	if (++bench.frame_ctr < bench.frames)
+		return;
+
+	struct timeval now;
+	gettimeofday(&now, 0);
+	double secs = (double)(now.tv_sec - bench.tv_start.tv_sec) +
+	              (double)(now.tv_usec - bench.tv_start.tv_usec) / 1000000.0;
+	if (secs <= 0.0)
+		secs = 0.000001;
+
+	hashlog_stop();
+
+	printf("BENCHMARK: %d frames in %.3f seconds (wall time)\n"
+	       "BENCHMARK: %.2f emulated FPS (%.1f%% of %s full speed)\n",
+	       bench.frame_ctr, secs, (double)bench.frame_ctr / secs,
+	       100.0 * (double)bench.frame_ctr / secs / (Config.PsxType == PSXTYPE_PAL ? 50.0 : 60.0),
+	       Config.PsxType == PSXTYPE_PAL ? "PAL" : "NTSC");
+	pmonPrintStats(true);
+	fflush(stdout);
+
+	exit(0);
+}
+
+// Returns 0: success, -1: failure
+static int movie_start(const char *file, bool record)
+{
+	struct movie_header hdr;
+
+	if (record) {
+		if ((movie.f = fopen(file, "wb")) == NULL) {
+			printf("ERROR: could not create movie file %s\n", file);
+			return -1;
+		}
+		memset(&hdr, 0, sizeof(hdr));
+		memcpy(hdr.magic, MOVIE_MAGIC, sizeof(MOVIE_MAGIC));
+		hdr.version = MOVIE_VERSION;
+		hdr.flags = movie.state_file ? MOVIE_FLAG_FROM_STATE : 0;
+		memcpy(hdr.cdrom_id, CdromId, sizeof(CdromId));
+		if (fwrite(&hdr, sizeof(hdr), 1, movie.f) != 1) {
+			printf("ERROR: could not write movie file %s\n", file);
+			fclose(movie.f);
+			movie.f = NULL;
+			return -1;
+		}
+		movie.recording = true;
+		printf("Recording input movie to %s\n", file);
+	} else {
+		if ((movie.f = fopen(file, "rb")) == NULL) {
+			printf("ERROR: could not open movie file %s\n", file);
+			return -1;
+		}
+		if (fread(&hdr, sizeof(hdr), 1, movie.f) != 1 ||
+		    memcmp(hdr.magic, MOVIE_MAGIC, sizeof(MOVIE_MAGIC)) != 0 ||
+		    hdr.version != MOVIE_VERSION) {
+			printf("ERROR: %s is not a compatible movie file\n", file);
+			fclose(movie.f);
+			movie.f = NULL;
+			return -1;
+		}
+		if (!(hdr.flags & MOVIE_FLAG_FROM_STATE) != !movie.state_file) {
+			printf("ERROR: movie %s was recorded %s, use %s -moviestate\n", file,
+			       movie.state_file ? "from power-on" : "from a savestate",
+			       movie.state_file ? "it without" : "it with");
+			fclose(movie.f);
+			movie.f = NULL;
+			return -1;
+		}
+		if (strncmp(hdr.cdrom_id, CdromId, sizeof(CdromId)) != 0)
+			printf("WARNING: movie was recorded with game '%.10s', running '%.10s'\n",
+			       hdr.cdrom_id, CdromId);
+		movie.frames = hdr.frames;
+		movie.playing = true;
+		printf("Playing input movie %s (%u frames)\n", file, movie.frames);
+	}
+
+	movie.frame = 0;
+	return 0;
+}
+
+static void movie_stop(void)
+{
+	if (!movie.f)
+		return;
+
+	if (movie.recording) {
+		// Store length in header, so playback can report it
+		fseek(movie.f, offsetof(struct movie_header, frames), SEEK_SET);
+		fwrite(&movie.frame, sizeof(movie.frame), 1, movie.f);
+		printf("Input movie recording stopped after %u frames\n", movie.frame);
+	}
+
+	fclose(movie.f);
+	movie.f = NULL;
+	movie.recording = movie.playing = false;
+}
+
+// Called once per frame from pad_update(). During playback, sets pads to
+//  the movie's next frame. During recording, appends current pad states.
+static void movie_frame(unsigned short *p1, unsigned short *p2)
+{
+	uint16_t pads[2];
+
+	if (movie.playing) {
+		if (fread(pads, sizeof(pads), 1, movie.f) != 1) {
+			printf("Input movie playback finished after %u frames\n", movie.frame);
+			movie_stop();
+			*p1 = *p2 = 0xffff;
+			return;
+		}
+		*p1 = pads[0];
+		*p2 = pads[1];
+	} else if (movie.recording) {
+		pads[0] = *p1;
+		pads[1] = *p2;
+		if (fwrite(pads, sizeof(pads), 1, movie.f) != 1) {
+			printf("ERROR: writing input movie failed, recording stopped\n");
+			movie_stop();
+			return;
+		}
+	}
+
+	movie.frame++;
+}
+
+// Returns 0: success, -1: failure
+static int hashlog_start(const char *file, bool check)
+{
+	if ((hashlog.f = fopen(file, check ? "r" : "w")) == NULL) {
+		printf("ERROR: could not open frame hash file %s\n", file);
+		return -1;
+	}
+	if (!check)
+		fprintf(hashlog.f, "# pcsx4all frame hashes: frame vram_hash ram_hash\n");
+	hashlog.check = check;
+	hashlog.frame = 0;
+	return 0;
+}
+
+// 64-bit FNV-1a, applied per 32-bit word for speed
+static uint64_t hash_words(const uint32_t *p, size_t words)
+{
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for (size_t i=0; i < words; ++i)
+		h = (h ^ p[i]) * 0x100000001b3ULL;
+	return h;
+}
+
+static void hashlog_frame(void)
+{
+	if (!hashlog.f || hashlog.baseline_ended)
+		return;
+
+#ifdef USE_GPULIB
+	const uint32_t *vram = (const uint32_t *)gpu.vram;
+#else
+	static GPUFreeze_t gpu_state;
+	gpu_state.ulFreezeVersion = 1;
+	GPU_freeze(1, &gpu_state);
+	const uint32_t *vram = (const uint32_t *)gpu_state.psxVRam;
+#endif
+	uint64_t vram_hash = hash_words(vram, 1024*512*2/4);
+	uint64_t ram_hash = hash_words((const uint32_t *)psxM, 0x200000/4);
+	unsigned frame = hashlog.frame++;
+
+	if (!hashlog.check) {
+		fprintf(hashlog.f, "%u %016llx %016llx\n", frame,
+		        (unsigned long long)vram_hash, (unsigned long long)ram_hash);
+		return;
+	}
+
+	char line[128];
+	unsigned b_frame;
+	unsigned long long b_vram, b_ram;
+	do {
+		if (!fgets(line, sizeof(line), hashlog.f)) {
+			printf("HASHCHECK: baseline ends at frame %u, not checking further\n", frame);
+			hashlog.baseline_ended = true;
+			return;
+		}
+	} while (line[0] == '#');
+
+	if (sscanf(line, "%u %llx %llx", &b_frame, &b_vram, &b_ram) != 3 || b_frame != frame) {
+		printf("HASHCHECK: baseline file is corrupt at frame %u\n", frame);
+		exit(1);
+	}
+
+	if (b_vram != vram_hash || b_ram != ram_hash) {
+		printf("HASHCHECK: frame %u differs from baseline:%s%s\n", frame,
+		       b_vram != vram_hash ? " VRAM" : "", b_ram != ram_hash ? " RAM" : "");
+		fflush(stdout);
+		exit(1);
+	}
+}
+
+static void hashlog_stop(void)
+{
+	if (!hashlog.f)
+		return;
+
+	if (hashlog.check) {
+		if (!hashlog.baseline_ended)
+			printf("HASHCHECK: all %u frames match baseline\n", hashlog.frame);
+	}
+	fclose(hashlog.f);
+	hashlog.f = NULL;
+}
+
 static char *home = NULL;
 static char homedir[PATH_MAX] =		"./.pcsx4all";
 static char memcardsdir[PATH_MAX] =	"./.pcsx4all/memcards";
@@ -135,7 +414,8 @@ void probe_lastdir()
 }
 
 #ifdef PSXREC
-extern u32 cycle_multiplier; // in mips/recompiler.cpp
+extern u32 cycle_multiplier; // in recompiler/*/recompiler.cpp
+extern u32 rec_mem_size_mb;  // in recompiler/*/recompiler.cpp
 #endif
 
 void config_load()
@@ -308,6 +588,9 @@ void config_load()
 		else if (!strcmp(line, "CycleMultiplier")) {
 			sscanf(arg, "%03x", &value);
 			cycle_multiplier = value;
+		} else if (!strcmp(line, "RecCacheSize")) {
+			sscanf(arg, "%d", &value);
+			rec_mem_size_mb = value;
 		}
 #endif
 #ifdef GPU_UNAI
@@ -389,6 +672,7 @@ void config_save()
 
 #ifdef PSXREC
 	fprintf(f, "CycleMultiplier %03x\n", cycle_multiplier);
+	fprintf(f, "RecCacheSize %d\n", rec_mem_size_mb);
 #endif
 
 #ifdef GPU_UNAI
@@ -430,6 +714,11 @@ int state_load(int slot)
 	sprintf(savename, "%s/%s.%d.sav", sstatesdir, CdromId, slot);
 
 	if (FileExists(savename)) {
+		// Input would no longer match what emulation is doing
+		if (movie.f) {
+			printf("Savestate loaded, input movie stopped\n");
+			movie_stop();
+		}
 		return LoadState(savename);
 	}
 
@@ -483,6 +772,15 @@ static unsigned short pad2 = 0xffff;
 
 void pad_update(void)
 {
+	// Benchmark mode has no SDL input: all buttons stay released unless
+	//  a movie is playing
+	if (bench.frames) {
+		movie_frame(&pad1, &pad2);
+		hashlog_frame();
+		bench_frame();
+		return;
+	}
+
 	SDL_Event event;
 	Uint8 *keys = SDL_GetKeyState(NULL);
 
@@ -508,6 +806,13 @@ void pad_update(void)
 		}
 	}
 
+	// Keyboard is ignored while a movie is playing
+	if (movie.playing) {
+		movie_frame(&pad1, &pad2);
+		if (movie.playing)
+			return;
+	}
+
 	int k = 0;
 	while (keymap[k].key) {
 		if (keys[keymap[k].key]) {
@@ -563,6 +868,9 @@ void pad_update(void)
 		pl_resume();    // Tell plugin_lib we're reentering emu
 	}
 #endif
+
+	if (movie.recording)
+		movie_frame(&pad1, &pad2);
 }
 
 unsigned short pad_read(int num)
@@ -572,6 +880,9 @@ unsigned short pad_read(int num)
 
 void video_blit(void *src)
 {
+	if (bench.frames)
+		return;
+
 	if (SDL_MUSTLOCK(screen)) SDL_UnlockSurface(screen);
 	SDL_BlitSurface((SDL_Surface*)src, NULL, screen, NULL);
 	if (SDL_MUSTLOCK(screen)) SDL_LockSurface(screen);
@@ -583,6 +894,9 @@ void video_flip(void)
 		port_printf_fg_bg(5, 5, pl_data.stats_msg, 0xffff, 0x0000);
 	}
 
+	if (bench.frames)
+		return;
+
 	if (SDL_MUSTLOCK(screen))
 		SDL_UnlockSurface(screen);
 
@@ -615,6 +929,11 @@ void video_set(unsigned short *pVideo, unsigned int width, unsigned int height)
 
 void video_clear(void)
 {
+	if (bench.frames) {
+		memset(SCREEN, 0, 320*240*2);
+		return;
+	}
+
 	memset(screen->pixels, 0, screen->pitch*screen->h);
 }
 
@@ -698,9 +1017,9 @@ int main (int argc, char **argv)
 	Config.Cdda=0; /* 0=Enable Cd audio, 1=Disable Cd audio */
 	Config.HLE=1; /* 0=BIOS, 1=HLE */
 #if defined (PSXREC)
-	Config.Cpu=0; /* 0=recompiler, 1=interpreter */
+	Config.Cpu=0; /* 0=recompiler, 1=interpreter, 2=cached interpreter */
 #else
-	Config.Cpu=1; /* 0=recompiler, 1=interpreter */
+	Config.Cpu=1; /* 0=recompiler, 1=interpreter, 2=cached interpreter */
 #endif
 	Config.SlowBoot=0; /* 0=skip bios logo sequence on boot  1=show sequence (does not apply to HLE) */
 	Config.RCntFix=0; /* 1=Parasite Eve 2, Vandal Hearts 1/2 Fix */
@@ -817,6 +1136,15 @@ int main (int argc, char **argv)
 
 	// command line options
 	bool param_parse_error = 0;
+	int memstats_interval = 0;
+	const char *memstats_csv_file = NULL;
+#ifdef USE_GPULIB
+	const char *gpurec_file = NULL;
+#endif
+	const char *movie_file = NULL;
+	bool movie_record = false;
+	const char *hashlog_file = NULL;
+	bool hashlog_check = false;
 	for (int i = 1; i < argc; i++) {
 		// PCSX
 		// XA audio disabled
@@ -851,6 +1179,25 @@ int main (int argc, char **argv)
 		if (strcmp(argv[i],"-interpreter") == 0)
 			Config.Cpu = 1;
 
+		// Cached interpreter enabled (decodes each block of code only once)
+		if (strcmp(argv[i],"-cachedinterpreter") == 0)
+			Config.Cpu = 2;
+
+#ifdef PSXREC
+		// Recompiler code cache size in MB (2..16, default depends on the
+		//  recompiler). Larger caches need fewer evictions in games with
+		//  lots of code.
+		if (strcmp(argv[i],"-reccache") == 0) {
+			if (++i < argc) {
+				rec_mem_size_mb = atoi(argv[i]);
+			} else {
+				printf("ERROR: missing value for -reccache\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+#endif
+
 		// Show BIOS logo sequence at BIOS startup (doesn't apply to HLE)
 		if (strcmp(argv[i],"-slowboot") == 0)
 			Config.SlowBoot = 1;
@@ -932,6 +1279,111 @@ int main (int argc, char **argv)
 			Config.PerfmonDetailedStats = true;
 		}
 
+		// Sampled memory access stats, printed on exit: every Nth access
+		//  through psxMemRead*()/psxMemWrite*() is sampled.
+		if (strcmp(argv[i],"-memstats") == 0) {
+			int val = -1;
+			if (++i < argc) {
+				val = atoi(argv[i]);
+				if (val > 0) {
+					memstats_interval = val;
+				} else val = -1;
+			} else {
+				printf("ERROR: missing value for -memstats\n");
+			}
+
+			if (val == -1) {
+				printf("ERROR: -memstats value must be a sampling interval > 0\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+
+		// Also write memory access stats to CSV file on exit
+		//  (samples every access if -memstats isn't given)
+		if (strcmp(argv[i],"-memstatscsv") == 0) {
+			if (++i < argc) {
+				memstats_csv_file = argv[i];
+			} else {
+				printf("ERROR: missing filename for -memstatscsv\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+
+		// Check each recompiled block against the interpreter, stopping
+		//  at the first difference (slow, for development)
+		if (strcmp(argv[i],"-lockstep") == 0) {
+			psxLockstepEnable();
+		}
+
+#ifdef USE_GPULIB
+		// Record all data sent to the GPU, for offline replay with gpu_replay
+		if (strcmp(argv[i],"-gpurec") == 0) {
+			if (++i < argc) {
+				gpurec_file = argv[i];
+			} else {
+				printf("ERROR: missing filename for -gpurec\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+#endif
+
+		// Input movie recording/playback, for reproducible benchmarking
+		if (strcmp(argv[i],"-movierec") == 0 || strcmp(argv[i],"-movieplay") == 0) {
+			movie_record = (strcmp(argv[i],"-movierec") == 0);
+			if (++i < argc) {
+				movie_file = argv[i];
+			} else {
+				printf("ERROR: missing filename for %s\n", argv[i-1]);
+				param_parse_error = true;
+				break;
+			}
+		}
+
+		// Savestate an input movie starts from
+		if (strcmp(argv[i],"-moviestate") == 0) {
+			if (++i < argc) {
+				movie.state_file = argv[i];
+			} else {
+				printf("ERROR: missing filename for -moviestate\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+
+		// Per-frame VRAM/RAM hashes, recorded or checked against baseline
+		if (strcmp(argv[i],"-hashrec") == 0 || strcmp(argv[i],"-hashcheck") == 0) {
+			hashlog_check = (strcmp(argv[i],"-hashcheck") == 0);
+			if (++i < argc) {
+				hashlog_file = argv[i];
+			} else {
+				printf("ERROR: missing filename for %s\n", argv[i-1]);
+				param_parse_error = true;
+				break;
+			}
+		}
+
+		// Headless benchmark: run given number of frames without display,
+		//  audio or frame limiter, then print stats and exit.
+		if (strcmp(argv[i],"-bench") == 0) {
+			if (++i < argc) {
+				int val = atoi(argv[i]);
+				if (val > 0) {
+					bench.frames = val;
+				} else {
+					printf("ERROR: -bench value must be a number of frames > 0\n");
+					param_parse_error = true;
+					break;
+				}
+			} else {
+				printf("ERROR: missing value for -bench\n");
+				param_parse_error = true;
+				break;
+			}
+		}
+
 		// GPU
 		// show FPS
 		if (strcmp(argv[i],"-showfps") == 0) {
@@ -1117,31 +1569,79 @@ int main (int argc, char **argv)
 		exit(1);
 	}
 
-	//NOTE: spu_pcsxrearmed will handle audio initialization
-	SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_NOPARACHUTE);
+	if (hashlog_file) {
+		if (!bench.frames) {
+			printf("ERROR: -hashrec and -hashcheck require -bench\n");
+			exit(1);
+		}
+
+		// Auto-frameskip adjusts SPU update rate to host speed, hashes
+		//  mustn't depend on it
+		Config.FrameSkip = FRAMESKIP_OFF;
+	}
+
+	if (movie.state_file && !movie_file) {
+		printf("ERROR: -moviestate requires -movierec or -movieplay\n");
+		exit(1);
+	}
+
+	if (memstats_csv_file && !memstats_interval)
+		memstats_interval = 1;
+	if (memstats_interval)
+		psxMemStatsEnable(memstats_interval, memstats_csv_file);
+
+	if (bench.frames) {
+		// Benchmark needs something to run, there's no frontend to pick it
+		if (cdrfilename[0] == '\0' && filename[0] == '\0' && Config.HLE) {
+			printf("ERROR: -bench requires -iso, -file or -bios\n");
+			exit(1);
+		}
+
+		Config.FrameLimit = 0;
+		Config.FrameSkip = FRAMESKIP_OFF;  // Results mustn't depend on host speed
+		Config.ShowFps = 0;
+		Config.PerfmonDetailedStats = true;
+#ifdef SPU_PCSXREARMED
+		spu_config.iDisabled = 1;
+		spu_config.iUseThread = 0;
+#endif
+	}
 
 	atexit(pcsx4all_exit);
 
+	if (bench.frames) {
+		bench.screen = (unsigned short *)calloc(320*240, sizeof(unsigned short));
+		if (!bench.screen) {
+			printf("ERROR: failed to allocate benchmark screen buffer\n");
+			exit(1);
+		}
+		SCREEN = bench.screen;
+		printf("Benchmark mode: running %d frames headless\n", bench.frames);
+	} else {
+		//NOTE: spu_pcsxrearmed will handle audio initialization
+		SDL_Init(SDL_INIT_VIDEO | SDL_INIT_JOYSTICK | SDL_INIT_NOPARACHUTE);
+
 #ifdef SDL_TRIPLEBUF
-	int flags = SDL_HWSURFACE | SDL_TRIPLEBUF;
+		int flags = SDL_HWSURFACE | SDL_TRIPLEBUF;
 #else
-	int flags = SDL_HWSURFACE | SDL_DOUBLEBUF;
+		int flags = SDL_HWSURFACE | SDL_DOUBLEBUF;
 #endif
 
-	screen = SDL_SetVideoMode(320, 240, 16, flags);
-	if (!screen) {
-		puts("NO Set VideoMode 320x240x16");
-		exit(0);
-	}
+		screen = SDL_SetVideoMode(320, 240, 16, flags);
+		if (!screen) {
+			puts("NO Set VideoMode 320x240x16");
+			exit(0);
+		}
 
-	if (SDL_MUSTLOCK(screen))
-		SDL_LockSurface(screen);
+		if (SDL_MUSTLOCK(screen))
+			SDL_LockSurface(screen);
 
-	SDL_WM_SetCaption("pcsx4all - SDL Version", "pcsx4all");
+		SDL_WM_SetCaption("pcsx4all - SDL Version", "pcsx4all");
 
-	SCREEN = (Uint16 *)screen->pixels;
+		SCREEN = (Uint16 *)screen->pixels;
+	}
 
-	if (argc < 2 || cdrfilename[0] == '\0') {
+	if (!bench.frames && (argc < 2 || cdrfilename[0] == '\0')) {
 		// Enter frontend main-menu:
 		emu_running = false;
 		if (!SelectGame()) {
@@ -1199,6 +1699,22 @@ int main (int argc, char **argv)
 	}
 
 	if ((cdrfilename[0] != '\0') || (filename[0] != '\0') || (Config.HLE == 0)) {
+#ifdef USE_GPULIB
+		if (gpurec_file)
+			gpulib_record_start(gpurec_file);
+#endif
+		if (movie_file) {
+			if (movie.state_file && LoadState(movie.state_file) == -1) {
+				printf("ERROR: failed loading movie savestate %s\n", movie.state_file);
+				exit(1);
+			}
+			if (movie_start(movie_file, movie_record) == -1)
+				exit(1);
+		}
+		if (hashlog_file && hashlog_start(hashlog_file, hashlog_check) == -1)
+			exit(1);
+		if (bench.frames)
+			bench_start();
 		psxCpu->Execute();
 	}
 
@@ -211,7 +211,8 @@ enum {
 
 enum {
 	CPU_DYNAREC = 0,
-	CPU_INTERPRETER
+	CPU_INTERPRETER,
+	CPU_CACHED_INTERPRETER
 }; // CPU Types
 
 void EmuUpdate();
@@ -29,6 +29,9 @@
 //   not every HSync.
 // * SPU updates occur using new event queue (psxevents.cpp)
 // * Some optimizations, more accurate calculation of timer updates.
+// * Counters 0..2 get PSXINT_RCNT events only while they can raise an IRQ.
+//   Otherwise, their target/overflow bookkeeping is caught up lazily from
+//   psxRegs.cycle when they are accessed (see psxRcntCatchUp()).
 //
 // TODO : Implement direct rootcounter mem access of Rearmed dynarec?
 //        (see https://github.com/notaz/pcsx_rearmed/commit/b1be1eeee94d3547c20719acfa6b0082404897f1 )
@@ -40,6 +43,7 @@
 #include "psxcounters.h"
 #include "psxevents.h"
 #include "gpu.h"
+#include "perfmon.h"
 
 /******************************************************************************/
 
@@ -220,6 +224,15 @@ static void _psxRcntWmode( u32 index, u32 value )
 
 /******************************************************************************/
 
+// Can counter raise an IRQ at its next target or overflow? Only these
+//  (and counter 3, for VBlank) need PSXINT_RCNT events.
+static inline bool psxRcntNeedsEvents( u32 index )
+{
+    return index == 3 ||
+           ((rcnts[index].mode & (RcIrqOnTarget | RcIrqOnOverflow)) &&
+            ((rcnts[index].mode & RcIrqRegenerate) || !rcnts[index].irqState));
+}
+
 static void psxRcntSet(void)
 {
     s32 countToUpdate;
@@ -230,6 +243,9 @@ static void psxRcntSet(void)
 
     for( i = 0; i < CounterQuantity; ++i )
     {
+        if( !psxRcntNeedsEvents( i ) )
+            continue;
+
         countToUpdate = rcnts[i].cycle - (psxNextsCounter - rcnts[i].cycleStart);
 
         if( countToUpdate < 0 )
@@ -313,6 +329,49 @@ static void psxRcntReset( u32 index )
     }
 }
 
+// Bring a counter without events up to date with psxRegs.cycle, as
+//  psxRcntUpdate() would have at each target/overflow.
+static void psxRcntCatchUp( u32 index )
+{
+    if( psxRcntNeedsEvents( index ) )
+        return;
+
+    while( psxRegs.cycle - rcnts[index].cycleStart >= rcnts[index].cycle )
+    {
+        u32 elapsed = psxRegs.cycle - rcnts[index].cycleStart;
+        u32 period = 0;
+        u16 flags = 0;
+
+        // Skip whole counting periods at once, each would only set flags
+        if( rcnts[index].mode & RcCountToTarget )
+        {
+            if( rcnts[index].counterState == CountToTarget )
+            {
+                period = rcnts[index].target * rcnts[index].rate;
+                flags  = RcCountEqTarget;
+            }
+            else if( rcnts[index].target == 0 )
+            {
+                period = 0x10000 * rcnts[index].rate;
+                flags  = RcOverflow;
+            }
+        }
+        else
+        {
+            period = 0x10000 * rcnts[index].rate;
+            flags  = RcOverflow | (rcnts[index].target ? RcCountEqTarget : 0);
+        }
+
+        if( period && elapsed / period >= 2 )
+        {
+            rcnts[index].cycleStart += (elapsed / period - 1) * period;
+            rcnts[index].mode |= flags;
+        }
+
+        psxRcntReset( index );
+    }
+}
+
 void psxRcntUpdate()
 {
     u32 cycle;
@@ -371,8 +430,11 @@ void psxRcntUpdate()
             //senquack - PCSX Rearmed updates its SPU plugin once per emulated
             // frame. However, we target slower platforms and update SPU plugin
             // at flexible interval (scheduled event) to avoid audio dropouts.
-            if (Config.SpuUpdateFreq == SPU_UPDATE_FREQ_1)
+            if (Config.SpuUpdateFreq == SPU_UPDATE_FREQ_1) {
+                pmonSubsysBegin(PMON_SUBSYS_SPU);
                 SPU_async(cycle, 1);
+                pmonSubsysEnd(PMON_SUBSYS_SPU);
+            }
         }
 
         // Update lace. (with InuYasha fix)
@@ -416,6 +478,7 @@ void psxRcntWcount( u32 index, u32 value )
 {
     verboseLog( 2, "[RCNT %i] wcount: %x\n", index, value );
 
+    psxRcntCatchUp( index );
     _psxRcntWcount( index, value );
     psxRcntSet();
 }
@@ -435,6 +498,7 @@ void psxRcntWtarget( u32 index, u32 value )
 {
     verboseLog( 1, "[RCNT %i] wtarget: %x\n", index, value );
 
+    psxRcntCatchUp( index );
     rcnts[index].target = value;
 
     _psxRcntWcount( index, _psxRcntRcount( index ) );
@@ -447,6 +511,7 @@ u32 psxRcntRcount( u32 index )
 {
     u32 count;
 
+    psxRcntCatchUp( index );
     count = _psxRcntRcount( index );
 
     // Parasite Eve 2 fix.
@@ -466,6 +531,7 @@ u32 psxRcntRmode( u32 index )
 {
     u16 mode;
 
+    psxRcntCatchUp( index );
     mode = rcnts[index].mode;
     rcnts[index].mode &= 0xe7ff;
 
@@ -523,6 +589,10 @@ int psxRcntFreeze(void *f, FreezeMode mode)
     //  now this is 0 placeholder to maintain savestate compatibilty
     u32 spuSyncCount = 0;
 
+    if (mode == FREEZE_SAVE)
+        for (int i = 0; i < CounterQuantity; ++i)
+            psxRcntCatchUp( i );
+
     if (    freeze_rw(f, mode, &rcnts, sizeof(rcnts))
          || freeze_rw(f, mode, &hSyncCount, sizeof(hSyncCount))
          || freeze_rw(f, mode, &spuSyncCount, sizeof(spuSyncCount))
@@ -77,9 +77,7 @@ void psxDma4(u32 madr, u32 bcr, u32 chcr) { // SPU
 
 			SPU_readDMAMem(ptr, words * 2, psxRegs.cycle);
 
-#ifdef PSXREC
-			psxCpu->Clear(madr, words);
-#endif
+			psxCpuClear(madr, words);
 
 			HW_DMA4_MADR = SWAPu32(madr + words * 4);
 			SPUDMA_INT(words / 2);
@@ -157,9 +155,7 @@ void psxDma2(u32 madr, u32 bcr, u32 chcr) { // GPU
 			// BA blocks * BS words (word = 32-bits)
 			words = (bcr >> 16) * (bcr & 0xffff);
 			GPU_readDataMem(ptr, words);
-			#ifdef PSXREC
-			psxCpu->Clear(madr, words);
-			#endif
+			psxCpuClear(madr, words);
 
 			HW_DMA2_MADR = SWAPu32(madr + words * 4);
 
@@ -20,18 +20,35 @@
  *
  * Added July 2016 by senquack (Daniel Silsby)
  *
- * Queue is an array sorted by event imminency. It can have spare capacity
- * both at the front and at the back. If an event is removed from the front
- * of the queue and a new event enqueued that ends up back at front of queue,
- * the operation is O(1).
+ * Two implementations, both dispatching equally-imminent events in the order
+ * they were added:
+ *
+ * Default: events' deadlines are their psxRegs.intCycle[] entries, plus a
+ * bitmask of queued events. Add and remove are O(1): only the two most
+ * imminent events are tracked, and the bitmask is scanned for them again
+ * when both were removed or dispatched. Events rescheduling themselves when
+ * dispatched, like root counters, usually avoid that scan altogether.
+ *
+ * Build with -DUSE_EVQUEUE_SORTED for the original queue: an array sorted by
+ * event imminency. It can have spare capacity both at the front and at the
+ * back. If an event is removed from the front of the queue and a new event
+ * enqueued that ends up back at front of queue, the operation is O(1).
+ *
+ * 'make bench-events' builds a benchmark of both, see psxevents_bench.cpp.
  *
  * We also handle a small bit of SPU update logic here
  *
+ * Build with -DTRACE_EVENTS to record every add/remove/dispatch in a ring
+ * buffer, written out on shutdown as a Chrome trace_event JSON file
+ * (load it in chrome://tracing or ui.perfetto.dev). Each event number gets
+ * its own track, dispatches show as slices with their host duration.
+ *
  */
 
 #include "psxevents.h"
 #include "r3000a.h"
 #include "plugin_lib.h"
+#include "perfmon.h"
 
 // To get event-handler functions:
 #include "cdrom.h"
@@ -42,6 +59,54 @@
 // When psxRegs.cycle is >= this figure, it gets reset to 0:
 static const u32 reset_cycle_val_at = 2000000000;
 
+#ifdef TRACE_EVENTS
+#include <sys/time.h>
+
+// Number of records kept (power of two), oldest are overwritten
+#ifndef TRACE_EVENTS_SIZE
+#define TRACE_EVENTS_SIZE (1 << 16)
+#endif
+
+#ifndef TRACE_EVENTS_FILE
+#define TRACE_EVENTS_FILE "pcsx4all_events.json"
+#endif
+
+enum TraceType { TRACE_ADD, TRACE_REMOVE, TRACE_DISPATCH };
+
+struct TraceRecord {
+	s64 host_usec;
+	u32 cycle;         // psxRegs.cycle at time of record
+	u32 arg;           // Add: cycles_after, Dispatch: host duration in usecs
+	u8  ev;
+	u8  type;
+};
+
+static struct {
+	TraceRecord buf[TRACE_EVENTS_SIZE];
+	u32 pos;           // Total records ever written
+} evtrace;
+
+static inline s64 evtraceGetUsec(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (s64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static inline TraceRecord* evtraceRecord(u8 type, u8 ev, u32 arg)
+{
+	TraceRecord *r = &evtrace.buf[evtrace.pos++ & (TRACE_EVENTS_SIZE-1)];
+	r->host_usec = evtraceGetUsec();
+	r->cycle = psxRegs.cycle;
+	r->arg = arg;
+	r->ev = ev;
+	r->type = type;
+	return r;
+}
+
+static void evtraceWrite(void);
+#endif //TRACE_EVENTS
+
 ///////////////////////////
 // Internal helper funcs //
 ///////////////////////////
@@ -63,11 +128,25 @@ static const int EVQUEUE_CAPACITY = PSXINT_COUNT;
 
 typedef void (*EventFunc)(void);
 
+#ifndef USE_EVQUEUE_SORTED
+static const u8 EVQUEUE_UNKNOWN = 0xff;
+#endif
+
 static struct {
+#ifdef USE_EVQUEUE_SORTED
 	u8 useBeginIdx;             // Idx of first used element of queue[]
 	u8 useEndIdx;               // Idx one past last used element of queue[], or
 	                            //  same val as useBeginIdx when queue is empty.
 	u8 queue[EVQUEUE_CAPACITY];
+#else
+	u32 pending;                // Bit set for each event in queue
+	u8 front;                   // Most imminent event, and the one after it,
+	u8 second;                  //  or EVQUEUE_UNKNOWN when 'pending' must be
+	                            //  scanned for them. 'second' is only known
+	                            //  when 'front' is.
+	u32 addCount;               // Incremented on every add, and copied to
+	u32 addSeq[EVQUEUE_CAPACITY];  // addSeq[] to order equally-imminent events
+#endif
 	EventFunc funcs[EVQUEUE_CAPACITY];
 	u32 spuUpdateInterval;      // Cycles between SPU plugin updates
 } evqueue;
@@ -82,15 +161,19 @@ static inline void evqueueClear(void);
 static inline size_t evqueueSize(void);
 static inline bool evqueueEmpty(void);
 static inline u8 evqueueFront(void);
-static inline u8* evqueueFrontPtr(void);
-static inline u8* evqueueEndPtr(void);
 static inline void evqueueAdd(u8 ev);
 static inline bool evqueueRemove(u8 ev);
 static inline void evqueueRemoveFront(void);
+#ifdef USE_EVQUEUE_SORTED
+static inline u8* evqueueFrontPtr(void);
+static inline u8* evqueueEndPtr(void);
 static inline void evqueueMoveTowardsFront(u8 *start, u8 *end);
 static inline void evqueueMoveTowardsBack(u8 *start, u8 *end);
 static inline void evqueueInsertFront(u8 *pos, u8 ev);
 static inline void evqueueInsertBack(u8 *pos, u8 ev);
+#else
+static void evqueueFindFront(void);
+#endif
 #ifdef DEBUG_EVENTS
 static bool evqueueConsistencyCheck(void);
 static void evqueuePrintQueue(void);
@@ -129,7 +212,9 @@ void psxEvqueueInitFromFreeze(void)
 		if (psxRegs.interrupt & (1 << ev))
 			evqueueAdd(ev);
 
-	psxRegs.intCycle[PSXINT_NEXT_EVENT] = psxRegs.intCycle[evqueueFront()];
+	// Older savestates can have no events queued
+	if (!evqueueEmpty())
+		psxRegs.intCycle[PSXINT_NEXT_EVENT] = psxRegs.intCycle[evqueueFront()];
 	psxEvqueueSchedulePersistentEvents();
 
 	// Don't trust io_cycle_counter from a freeze, as older savestate versions
@@ -185,15 +270,24 @@ static void psxEvqueueSchedulePersistentEvents(void)
 //  This function fixes up timestamps of all queued events when this occurs.
 static void psxEvqueueAdjustTimestamps(u32 prev_cycle_val)
 {
+#ifdef USE_EVQUEUE_SORTED
 	for (u8 *ev = evqueueFrontPtr(); ev != evqueueEndPtr(); ++ev) {
 		psxRegs.intCycle[*ev].sCycle -= prev_cycle_val;
 	}
+#else
+	for (u32 mask = evqueue.pending; mask; mask &= mask-1)
+		psxRegs.intCycle[__builtin_ctz(mask)].sCycle -= prev_cycle_val;
+#endif
 
 	psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle -= prev_cycle_val;
 }
 
 void psxEvqueueAdd(psxEventNum ev, u32 cycles_after)
 {
+#ifdef TRACE_EVENTS
+	evtraceRecord(TRACE_ADD, ev, cycles_after);
+#endif
+
 	// Dequeue event if it already exists, to match original emu behavior
 	if (psxRegs.interrupt & (1 << ev))
 		evqueueRemove(ev);
@@ -214,6 +308,10 @@ void psxEvqueueRemove(psxEventNum ev)
 	if (!(psxRegs.interrupt & (1 << ev)))
 		return;
 
+#ifdef TRACE_EVENTS
+	evtraceRecord(TRACE_REMOVE, ev, 0);
+#endif
+
 	psxRegs.interrupt &= ~(1 << ev);
 	evqueueRemove(ev);
 
@@ -255,7 +353,13 @@ void psxEvqueueDispatchAndRemoveFront(psxRegisters *pr)
 	}
 #endif
 
+#ifdef TRACE_EVENTS
+	TraceRecord *tr = evtraceRecord(TRACE_DISPATCH, ev, 0);
+	evqueue.funcs[ev]();  // Dispatch event
+	tr->arg = (u32)(evtraceGetUsec() - tr->host_usec);
+#else
 	evqueue.funcs[ev]();  // Dispatch event
+#endif
 
 	// Queue can never be totally empty, as certain persistent events will
 	//  always be rescheduled during dispatch above.
@@ -272,6 +376,74 @@ void psxEvqueueDispatchAndRemoveFront(psxRegisters *pr)
 	//  psxRegs.io_cycle_counter after all pending events are dispatched.
 }
 
+void psxEvqueueShutdown(void)
+{
+#ifdef TRACE_EVENTS
+	evtraceWrite();
+#endif
+}
+
+#ifdef TRACE_EVENTS
+static void evtraceWrite(void)
+{
+	static const char * const ev_names[PSXINT_COUNT] = {
+		"SIO", "CDR", "CDREAD", "GPUDMA", "MDECOUTDMA", "SPUDMA", "GPUBUSY",
+		"MDECINDMA", "GPUOTCDMA", "CDRDMA", "NEWDRC_CHECK", "RCNT", "CDRLID",
+		"CDRPLAY", "SPUIRQ", "SPU_UPDATE", "RESET_CYCLE_VAL", "SIO_SYNC_MCD"
+	};
+
+	if (evtrace.pos == 0)
+		return;
+
+	FILE *f = fopen(TRACE_EVENTS_FILE, "w");
+	if (!f) {
+		printf("ERROR: %s() could not open %s for writing\n", __func__, TRACE_EVENTS_FILE);
+		return;
+	}
+
+	u32 count = evtrace.pos < TRACE_EVENTS_SIZE ? evtrace.pos : TRACE_EVENTS_SIZE;
+	u32 first = evtrace.pos - count;
+	s64 usec_base = evtrace.buf[first & (TRACE_EVENTS_SIZE-1)].host_usec;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+
+	// Name the tracks, one per event number
+	for (int ev=0; ev < PSXINT_COUNT; ++ev) {
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+		           "\"args\":{\"name\":\"%s\"}},\n", ev, ev_names[ev]);
+	}
+
+	for (u32 i=first; i != evtrace.pos; ++i) {
+		const TraceRecord *r = &evtrace.buf[i & (TRACE_EVENTS_SIZE-1)];
+		const char *sep = (i+1 == evtrace.pos) ? "" : ",";
+		s64 ts = r->host_usec - usec_base;
+		switch (r->type) {
+			case TRACE_ADD:
+				fprintf(f, "{\"name\":\"add\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+				           "\"ts\":%lld,\"args\":{\"cycle\":%u,\"cycles_after\":%u}}%s\n",
+				        r->ev, (long long)ts, r->cycle, r->arg, sep);
+				break;
+			case TRACE_REMOVE:
+				fprintf(f, "{\"name\":\"remove\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%u,"
+				           "\"ts\":%lld,\"args\":{\"cycle\":%u}}%s\n",
+				        r->ev, (long long)ts, r->cycle, sep);
+				break;
+			default:
+				fprintf(f, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,"
+				           "\"ts\":%lld,\"dur\":%u,\"args\":{\"cycle\":%u}}%s\n",
+				        ev_names[r->ev], r->ev, (long long)ts, r->arg, r->cycle, sep);
+				break;
+		}
+	}
+
+	fprintf(f, "]}\n");
+	fclose(f);
+
+	printf("Wrote %u event trace records to %s (%u total recorded)\n",
+	       count, TRACE_EVENTS_FILE, evtrace.pos);
+}
+#endif //TRACE_EVENTS
+
 // Should be called if Config.PsxType, Config.SpuUpdateFreq is changed
 void SPU_resetUpdateInterval(void)
 {
@@ -294,7 +466,9 @@ void SPU_update(void)
 	// this call to SPU_async(), and new SPUIRQ scheduled if necessary.
 	psxEvqueueRemove(PSXINT_SPUIRQ);
 
+	pmonSubsysBegin(PMON_SUBSYS_SPU);
 	SPU_async(psxRegs.cycle, 1);
+	pmonSubsysEnd(PMON_SUBSYS_SPU);
 
 	// If frameskip is advised, update SPU more frequently to avoid dropouts
 	if (Config.SpuUpdateFreq > SPU_UPDATE_FREQ_1) {
@@ -309,7 +483,9 @@ void SPU_update(void)
 // allowing handling as a generic event
 static void SPU_handleIRQ(void)
 {
+	pmonSubsysBegin(PMON_SUBSYS_SPU);
 	SPU_async(psxRegs.cycle, 0);
+	pmonSubsysEnd(PMON_SUBSYS_SPU);
 }
 
 // Returns true if event 'lh_ev' is more imminent than 'rh_ev'.
@@ -324,6 +500,7 @@ static inline bool EventMoreImminent(u8 lh_ev, u8 rh_ev)
 	return lh_tmp < rh_tmp;
 }
 
+#ifdef USE_EVQUEUE_SORTED
 static inline void evqueueClear(void)
 {
 	evqueue.useEndIdx = evqueue.useBeginIdx = 0;
@@ -473,7 +650,135 @@ static inline void evqueueInsertBack(u8 *pos, u8 ev)
 	*pos = ev;
 }
 
+#else //!USE_EVQUEUE_SORTED
+
+// Cycles until event is due, negative if past due
+static inline int EventCyclesLeft(u8 ev)
+{
+	return psxRegs.intCycle[ev].sCycle + psxRegs.intCycle[ev].cycle - psxRegs.cycle;
+}
+
+// Returns true if event 'lh_ev' is to be dispatched before 'rh_ev'
+static inline bool EventDispatchedBefore(u8 lh_ev, u8 rh_ev)
+{
+	int lh_tmp = EventCyclesLeft(lh_ev);
+	int rh_tmp = EventCyclesLeft(rh_ev);
+	return lh_tmp < rh_tmp ||
+	       (lh_tmp == rh_tmp && (int)(evqueue.addSeq[lh_ev] - evqueue.addSeq[rh_ev]) < 0);
+}
+
+static inline void evqueueClear(void)
+{
+	evqueue.pending = 0;
+	evqueue.front = evqueue.second = EVQUEUE_UNKNOWN;
+}
+
+static inline size_t evqueueSize(void)
+{
+	return __builtin_popcount(evqueue.pending);
+}
+
+static inline bool evqueueEmpty(void)
+{
+	return evqueue.pending == 0;
+}
+
+static inline u8 evqueueFront(void)
+{
+	if (evqueue.front == EVQUEUE_UNKNOWN)
+		evqueueFindFront();
+	return evqueue.front;
+}
+
+// Scan pending events for the two to dispatch first
+static void evqueueFindFront(void)
+{
+	u8 front = EVQUEUE_UNKNOWN, second = EVQUEUE_UNKNOWN;
+	int front_left = 0, second_left = 0;
+
+	for (u32 mask = evqueue.pending; mask; mask &= mask-1) {
+		u8 ev = __builtin_ctz(mask);
+		int left = EventCyclesLeft(ev);
+		if (front == EVQUEUE_UNKNOWN || left < front_left ||
+		    (left == front_left && (int)(evqueue.addSeq[ev] - evqueue.addSeq[front]) < 0)) {
+			second = front;
+			second_left = front_left;
+			front = ev;
+			front_left = left;
+		} else if (second == EVQUEUE_UNKNOWN || left < second_left ||
+		           (left == second_left && (int)(evqueue.addSeq[ev] - evqueue.addSeq[second]) < 0)) {
+			second = ev;
+			second_left = left;
+		}
+	}
+
+	// Both stay EVQUEUE_UNKNOWN if queue is empty
+	evqueue.front = front;
+	evqueue.second = second;
+}
+
+// Event's timestamp in psxRegs.intCycle[] must be set before call, and event
+//  must not be in queue already. New events are dispatched after existing
+//  equally-imminent events, like with the sorted queue.
+static inline void evqueueAdd(u8 ev)
+{
+	evqueue.addSeq[ev] = evqueue.addCount++;
+	evqueue.pending |= (1 << ev);
+
+	// When 'front' isn't known, both will be found by next evqueueFront()
+	if (evqueue.front != EVQUEUE_UNKNOWN) {
+		if (EventDispatchedBefore(ev, evqueue.front)) {
+			evqueue.second = evqueue.front;
+			evqueue.front = ev;
+		} else if (evqueue.second != EVQUEUE_UNKNOWN &&
+		           EventDispatchedBefore(ev, evqueue.second)) {
+			evqueue.second = ev;
+		}
+	}
+
 #ifdef DEBUG_EVENTS
+	if (!evqueueConsistencyCheck()) {
+		printf("ERROR: Queue consistent ordering check failed in %s(),\n"
+	           "after adding event %u\n", __func__, ev);
+		evqueuePrintQueue();
+	}
+#endif
+}
+
+// Remove element, returning false if not found
+static inline bool evqueueRemove(u8 ev)
+{
+	if (!(evqueue.pending & (1 << ev)))
+		return false;
+
+	evqueue.pending &= ~(1 << ev);
+	if (evqueue.front == ev) {
+		evqueue.front = evqueue.second;
+		evqueue.second = EVQUEUE_UNKNOWN;
+	} else if (evqueue.second == ev) {
+		evqueue.second = EVQUEUE_UNKNOWN;
+	}
+	return true;
+}
+
+static inline void evqueueRemoveFront(void)
+{
+#ifdef DEBUG_EVENTS
+	if (evqueueEmpty()) {
+		printf("ERROR: %s() called when queue is empty\n", __func__);
+		return;
+	}
+#endif
+
+	evqueue.pending &= ~(1 << evqueueFront());
+	evqueue.front = evqueue.second;
+	evqueue.second = EVQUEUE_UNKNOWN;
+}
+
+#endif //USE_EVQUEUE_SORTED
+
+#ifdef DEBUG_EVENTS
+#ifdef USE_EVQUEUE_SORTED
 static bool evqueueConsistencyCheck(void)
 {
 	if (evqueueSize() < 2)
@@ -503,4 +808,48 @@ static void evqueuePrintQueue(void)
 	if (evqueueConsistencyCheck())
 		printf("Queue consistent ordering check passes.\n");
 }
-#endif
+#else
+// Front and second, when known, must be dispatched before all other
+//  pending events
+static bool evqueueConsistencyCheck(void)
+{
+	if (evqueue.front == EVQUEUE_UNKNOWN)
+		return true;
+
+	const u8 front = evqueue.front, second = evqueue.second;
+	if (!(evqueue.pending & (1 << front)) ||
+	    (second != EVQUEUE_UNKNOWN && (second == front || !(evqueue.pending & (1 << second))))) {
+		printf("ERROR: %s() failed: front EV %u or second EV %u not pending\n",
+		       __func__, front, second);
+		return false;
+	}
+
+	for (u32 mask = evqueue.pending; mask; mask &= mask-1) {
+		u8 ev = __builtin_ctz(mask);
+		if (ev == front || ev == second)
+			continue;
+		if (EventDispatchedBefore(ev, front) ||
+		    (second != EVQUEUE_UNKNOWN && EventDispatchedBefore(ev, second))) {
+			printf("ERROR: %s() failed: EV %u before front EV %u or second EV %u\n",
+			       __func__, ev, front, second);
+			return false;
+		}
+	}
+	return true;
+}
+
+static void evqueuePrintQueue(void)
+{
+	printf("Queue contains %zu events, front: %u second: %u\n",
+	       evqueueSize(), evqueue.front, evqueue.second);
+	for (u32 mask = evqueue.pending; mask; mask &= mask-1) {
+		u8 ev = __builtin_ctz(mask);
+		printf("EV: %u SCYCLE: %u CYCLE: %u SEQ: %u\n", ev,
+		       psxRegs.intCycle[ev].sCycle, psxRegs.intCycle[ev].cycle, evqueue.addSeq[ev]);
+	}
+
+	if (evqueueConsistencyCheck())
+		printf("Queue consistent ordering check passes.\n");
+}
+#endif //USE_EVQUEUE_SORTED
+#endif //DEBUG_EVENTS
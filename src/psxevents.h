@@ -64,6 +64,9 @@ void psxEvqueueAdd(psxEventNum ev, u32 cycles_after);
 void psxEvqueueRemove(psxEventNum ev);
 void psxEvqueueDispatchAndRemoveFront(psxRegisters *pr);
 
+// Called on emu shutdown (writes event trace file if built with TRACE_EVENTS)
+void psxEvqueueShutdown(void);
+
 // Should be called when Config.PsxType changes
 void SPU_resetUpdateInterval(void);
 
@@ -0,0 +1,279 @@
+/***************************************************************************
+*   Copyright (C) 2016 PCSX4ALL Team                                      *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+/*
+ * Standalone event scheduler benchmark, built with 'make bench-events'.
+ * Only psxevents.cpp is linked in, and it is built twice: bench_events
+ * uses the default bitmask scheduler, bench_events_sorted the original
+ * sorted queue (-DUSE_EVQUEUE_SORTED).
+ *
+ * A fixed-seed workload resembling a game's is run for a number of
+ * emulated seconds: root counter events every scanline or so, SPU updates,
+ * CD sector reads, and HW register writes at random times scheduling
+ * (and sometimes cancelling) DMA, CDR, SIO and SPU IRQ events. Event
+ * handlers reschedule themselves like the real ones do. The CPU is not
+ * emulated, emulated time jumps straight to the next HW write or event.
+ *
+ * The order events are dispatched in (event number and psxRegs.cycle) is
+ * hashed, so both builds must print the same hash.
+ *
+ *   bench_events [-s emulated_seconds] [-r runs]
+ *
+ * Reported time is the best of all runs (5 by default).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "psxevents.h"
+#include "psxcounters.h"
+#include "plugins.h"
+#include "plugin_lib.h"
+#include "perfmon.h"
+
+// Only symbols psxevents.cpp needs from the rest of the emulator
+PcsxConfig Config;
+psxRegisters psxRegs;
+const u32 FrameRate[2] = { 60, 50 };
+struct pl_data_t pl_data;
+struct pmon_subsys_t pmon_subsys;
+
+// Random numbers are generated before timing starts, to keep the
+//  workload's own overhead low
+#define RNG_TABLE_SIZE (1 << 16)
+static u32 rng_table[RNG_TABLE_SIZE];
+static u32 rng_pos;
+
+static void rng_init()
+{
+	// xorshift32
+	u32 state = 1;
+	for (int i=0; i < RNG_TABLE_SIZE; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		rng_table[i] = state;
+	}
+}
+
+static inline u32 rng()
+{
+	return rng_table[rng_pos++ & (RNG_TABLE_SIZE-1)];
+}
+
+static inline u32 rnd_range(u32 lo, u32 hi)
+{
+	return lo + (u32)(((unsigned long long)rng() * (hi - lo + 1)) >> 32);
+}
+
+static u32 order_hash = 2166136261u;
+static u32 num_adds, num_removes, num_dispatches;
+
+static inline void hash_dispatch(psxEventNum ev)
+{
+	// FNV-1a
+	order_hash = (order_hash ^ ev) * 16777619u;
+	order_hash = (order_hash ^ psxRegs.cycle) * 16777619u;
+	num_dispatches++;
+}
+
+static inline void add_event(psxEventNum ev, u32 cycles_after)
+{
+	psxEvqueueAdd(ev, cycles_after);
+	num_adds++;
+}
+
+static inline void remove_event(psxEventNum ev)
+{
+	psxEvqueueRemove(ev);
+	num_removes++;
+}
+
+// Event handlers
+static bool cd_reading;
+
+void sioInterrupt(void)     { hash_dispatch(PSXINT_SIO); }
+void sioSyncMcds(void)      { hash_dispatch(PSXINT_SIO_SYNC_MCD); }
+void gpuInterrupt(void)     { hash_dispatch(PSXINT_GPUDMA); }
+void gpuotcInterrupt(void)  { hash_dispatch(PSXINT_GPUOTCDMA); }
+void spuInterrupt(void)     { hash_dispatch(PSXINT_SPUDMA); }
+void mdec0Interrupt(void)   { hash_dispatch(PSXINT_MDECINDMA); }
+void mdec1Interrupt(void)   { hash_dispatch(PSXINT_MDECOUTDMA); }
+void cdrDmaInterrupt(void)  { hash_dispatch(PSXINT_CDRDMA); }
+void cdrLidSeekInterrupt(void) { hash_dispatch(PSXINT_CDRLID); }
+void cdrPlayInterrupt(void) { hash_dispatch(PSXINT_CDRPLAY); }
+
+void cdrInterrupt(void)
+{
+	hash_dispatch(PSXINT_CDR);
+
+	// Command acknowledged: start or stop reading sectors
+	cd_reading = (rng() & 3) != 0;
+	if (cd_reading)
+		add_event(PSXINT_CDREAD, rnd_range(PSXCLK / 150, PSXCLK / 75));
+}
+
+void cdrReadInterrupt(void)
+{
+	hash_dispatch(PSXINT_CDREAD);
+
+	if (cd_reading) {
+		add_event(PSXINT_CDREAD, PSXCLK / 150);
+		if ((rng() & 7) == 0)
+			add_event(PSXINT_CDRDMA, rnd_range(500, 2000));
+	}
+}
+
+// Root counters: next event is the nearest counter target, usually a
+//  scanline away, sometimes sooner.
+void psxRcntUpdate(void)
+{
+	hash_dispatch(PSXINT_RCNT);
+	add_event(PSXINT_RCNT, (rng() & 15) ? 2172 : rnd_range(100, 2172));
+}
+
+void psxRcntAdjustTimestamps(const uint32_t prev_cycle_val) {}
+
+// SPU plugin schedules its IRQ event when it sees one coming
+void CALLBACK SPUasync(uint32_t cycle, uint32_t flags)
+{
+	hash_dispatch(flags ? PSXINT_SPU_UPDATE : PSXINT_SPUIRQ);
+	if ((rng() & 7) == 0)
+		add_event(PSXINT_SPUIRQ, rnd_range(1000, 100000));
+}
+
+// HW register write by the CPU, scheduling or cancelling an event
+static void hw_write(void)
+{
+	static const struct { psxEventNum ev; u32 min, max; } hw_events[] = {
+		{ PSXINT_GPUDMA,     100,   20000 },
+		{ PSXINT_GPUDMA,     100,   20000 },
+		{ PSXINT_GPUOTCDMA,  1000,  10000 },
+		{ PSXINT_SPUDMA,     100,   5000  },
+		{ PSXINT_CDR,        5000,  50000 },
+		{ PSXINT_SIO,        500,   1000  },
+		{ PSXINT_SIO,        500,   1000  },
+		{ PSXINT_MDECINDMA,  1000,  8000  },
+		{ PSXINT_MDECOUTDMA, 1000,  30000 },
+		{ PSXINT_SPUIRQ,     1000,  100000 },
+	};
+	static const int num_hw_events = sizeof(hw_events) / sizeof(hw_events[0]);
+
+	int i = rng() % num_hw_events;
+	if ((rng() & 15) == 0)
+		remove_event(hw_events[i].ev);
+	else
+		add_event(hw_events[i].ev, rnd_range(hw_events[i].min, hw_events[i].max));
+}
+
+// Same as psxBranchTest(), minus IRQs
+static inline void branch_test(void)
+{
+	while ((psxRegs.cycle - psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle) >=
+			psxRegs.intCycle[PSXINT_NEXT_EVENT].cycle) {
+		psxEvqueueDispatchAndRemoveFront(&psxRegs);
+	}
+
+	psxRegs.io_cycle_counter = psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle +
+	                           psxRegs.intCycle[PSXINT_NEXT_EVENT].cycle;
+}
+
+static double now_sec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Runs the workload from scratch, returns host seconds taken
+static double run_workload(u32 emu_secs)
+{
+	rng_pos = 0;
+	cd_reading = false;
+	order_hash = 2166136261u;
+	num_adds = num_removes = num_dispatches = 0;
+
+	memset(&psxRegs, 0, sizeof(psxRegs));
+	psxEvqueueInit();
+	psxEvqueueAdd(PSXINT_RCNT, 2172);
+	branch_test();
+
+	// Emulated time. Counted by steps, as psxRegs.cycle gets reset to 0
+	//  every now and then.
+	unsigned long long cycles_left = (unsigned long long)emu_secs * PSXCLK;
+
+	double start = now_sec();
+	while (cycles_left > 0) {
+		// Next HW write, or next event if it comes first (with a few
+		//  cycles of overshoot, as at the end of a recompiled block)
+		u32 step = rnd_range(1, 4000);
+		s32 until_event = psxRegs.io_cycle_counter - psxRegs.cycle;
+		if (until_event > (s32)step) {
+			psxRegs.cycle += step;
+			hw_write();
+		} else {
+			step = (until_event > 0 ? until_event : 0) + (rng() & 15);
+			psxRegs.cycle += step;
+			branch_test();
+		}
+		cycles_left -= (step < cycles_left) ? step : cycles_left;
+	}
+	return now_sec() - start;
+}
+
+int main(int argc, char **argv)
+{
+	u32 emu_secs = 120;
+	int runs = 5;
+
+	for (int i=1; i < argc; ++i) {
+		if (strcmp(argv[i], "-s") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			emu_secs = atoi(argv[++i]);
+		} else if (strcmp(argv[i], "-r") == 0 && i+1 < argc && atoi(argv[i+1]) > 0) {
+			runs = atoi(argv[++i]);
+		} else {
+			printf("Usage: %s [-s emulated_seconds] [-r runs]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	rng_init();
+	Config.PsxType = PSX_TYPE_NTSC;
+	Config.SpuUpdateFreq = SPU_UPDATE_FREQ_4;
+
+	// Best of several runs, they all do exactly the same work
+	double secs = run_workload(emu_secs);
+	for (int i=1; i < runs; ++i) {
+		double t = run_workload(emu_secs);
+		if (t < secs)
+			secs = t;
+	}
+
+	psxEvqueueShutdown();
+
+	u32 num_ops = num_adds + num_removes + num_dispatches;
+	printf("Emulated %u seconds: %u dispatches, %u adds, %u removes\n",
+	       emu_secs, num_dispatches, num_adds, num_removes);
+	printf("Host time (best of %d): %.3f s, %.1f ns per scheduler call\n",
+	       runs, secs, secs * 1000000000.0 / num_ops);
+	printf("Dispatch order hash: %08x\n", order_hash);
+	return 0;
+}
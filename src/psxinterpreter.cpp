@@ -25,6 +25,15 @@
 #include "r3000a.h"
 #include "gte.h"
 #include "psxhle.h"
+#include "psxlockstep.h"
+
+/* Run psxInt through a single computed-goto dispatch loop, see intRun().
+ *  Needs the GCC 'labels as values' extension. Disabled when logging, as it
+ *  doesn't go through execI()/debugI().
+ */
+#if defined(__GNUC__) && !defined(PSXCPU_LOG)
+#define USE_INT_THREADED_DISPATCH
+#endif
 
 static int branch = 0;
 static int branch2 = 0;
@@ -305,6 +314,166 @@ void psxDelayTest(int reg, u32 bpc) {
 	psxBranchTest();
 }
 
+/* Idle loop detection
+ *  Many games spin in a short loop polling I_STAT or a RAM flag until an
+ *  IRQ handler or a DMA changes it. If the loop only loads, computes and
+ *  branches back, and carries no register value from one iteration to the
+ *  next, every iteration does exactly the same thing until the next
+ *  scheduled event. The CPU cores can then fast-forward psxRegs.cycle to
+ *  that event with psxIdleLoopSkip() instead of running the spin.
+ *
+ *  Returns PC of the branch closing the loop that starts at 'loop_pc', or 0
+ *  if it isn't an idle loop. The static check only looks at the opcodes and
+ *  is suitable at recompile time. With 'check_addresses' set, the loop is
+ *  also evaluated using current register values, and each load must hit
+ *  RAM, scratchpad, BIOS or a HW reg that only changes on events.
+ */
+#define IDLE_LOOP_MAX_OPS 16
+
+static bool psxIdleLoopAddr(u32 addr) {
+	addr &= 0x1fffffff;
+	if (addr < 0x00800000) return true;                     // RAM + mirrors
+	if ((addr & 0xfffffc00) == 0x1f800000) return true;     // Scratchpad
+	if (addr >= 0x1fc00000 && addr < 0x1fc80000) return true; // BIOS
+	if ((addr & 0xfffffff8) == 0x1f801070) return true;     // I_STAT/I_MASK
+	if (addr >= 0x1f801080 && addr < 0x1f801100) return true; // DMA
+	if (addr == 0x1f801800 || addr == 0x1f801803) return true; // CD status/IRQ flags
+	return false;
+}
+
+u32 psxTestIdleLoop(u32 loop_pc, bool check_addresses) {
+	u32 r[32];
+	u32 known = ~0;       // Regs whose value is known
+	u32 written = 0;      // Regs written inside loop
+	u32 read_first = 0;   // Regs read before being written in an iteration
+	u32 branch_pc = 0;
+
+	memcpy(r, psxRegs.GPR.r, sizeof(r));
+
+	for (int i = 0; i < IDLE_LOOP_MAX_OPS; i++) {
+		u32 pc = loop_pc + i * 4;
+		u32 *code = (u32 *)PSXM(pc);
+		if (code == NULL)
+			return 0;
+
+		u32 tmp = SWAP32(*code);
+		u32 rs = _tRs_, rt = _tRt_, rd = _tRd_;
+		u32 imm = (s32)(s16)tmp;
+		u32 src = 0, dst = 0, val = 0;
+		u32 target = 0;
+		bool is_load = false;
+
+		switch (tmp >> 26) {
+			case 0x00: // SPECIAL
+				switch (_tFunct_) {
+					case 0x00: src = 1u << rt; dst = rd; val = r[rt] << _tSa_; break;            // SLL
+					case 0x02: src = 1u << rt; dst = rd; val = r[rt] >> _tSa_; break;            // SRL
+					case 0x03: src = 1u << rt; dst = rd; val = (s32)r[rt] >> _tSa_; break;       // SRA
+					case 0x04: src = (1u << rt) | (1u << rs); dst = rd; val = r[rt] << (r[rs] & 31); break;       // SLLV
+					case 0x06: src = (1u << rt) | (1u << rs); dst = rd; val = r[rt] >> (r[rs] & 31); break;       // SRLV
+					case 0x07: src = (1u << rt) | (1u << rs); dst = rd; val = (s32)r[rt] >> (r[rs] & 31); break;  // SRAV
+					case 0x20: case 0x21: src = (1u << rs) | (1u << rt); dst = rd; val = r[rs] + r[rt]; break;    // ADD/ADDU
+					case 0x22: case 0x23: src = (1u << rs) | (1u << rt); dst = rd; val = r[rs] - r[rt]; break;    // SUB/SUBU
+					case 0x24: src = (1u << rs) | (1u << rt); dst = rd; val = r[rs] & r[rt]; break;               // AND
+					case 0x25: src = (1u << rs) | (1u << rt); dst = rd; val = r[rs] | r[rt]; break;               // OR
+					case 0x26: src = (1u << rs) | (1u << rt); dst = rd; val = r[rs] ^ r[rt]; break;               // XOR
+					case 0x27: src = (1u << rs) | (1u << rt); dst = rd; val = ~(r[rs] | r[rt]); break;            // NOR
+					case 0x2a: src = (1u << rs) | (1u << rt); dst = rd; val = (s32)r[rs] < (s32)r[rt]; break;     // SLT
+					case 0x2b: src = (1u << rs) | (1u << rt); dst = rd; val = r[rs] < r[rt]; break;               // SLTU
+					default: return 0;
+				}
+				break;
+
+			case 0x01: // REGIMM
+				if (rt != 0x00 && rt != 0x01) // BLTZ/BGEZ, but not the linking forms
+					return 0;
+				src = 1u << rs; target = pc + 4 + (imm << 2);
+				break;
+
+			case 0x02: // J
+				target = ((pc + 4) & 0xf0000000) | ((tmp & 0x03ffffff) << 2);
+				break;
+
+			case 0x04: case 0x05: // BEQ/BNE
+				src = (1u << rs) | (1u << rt); target = pc + 4 + (imm << 2);
+				break;
+
+			case 0x06: case 0x07: // BLEZ/BGTZ
+				src = 1u << rs; target = pc + 4 + (imm << 2);
+				break;
+
+			case 0x08: case 0x09: src = 1u << rs; dst = rt; val = r[rs] + imm; break;        // ADDI/ADDIU
+			case 0x0a: src = 1u << rs; dst = rt; val = (s32)r[rs] < (s32)imm; break;         // SLTI
+			case 0x0b: src = 1u << rs; dst = rt; val = r[rs] < imm; break;                   // SLTIU
+			case 0x0c: src = 1u << rs; dst = rt; val = r[rs] & (imm & 0xffff); break;        // ANDI
+			case 0x0d: src = 1u << rs; dst = rt; val = r[rs] | (imm & 0xffff); break;        // ORI
+			case 0x0e: src = 1u << rs; dst = rt; val = r[rs] ^ (imm & 0xffff); break;        // XORI
+			case 0x0f: dst = rt; val = imm << 16; break;                                     // LUI
+
+			case 0x20: case 0x21: case 0x23: // LB/LH/LW
+			case 0x24: case 0x25:            // LBU/LHU
+				src = 1u << rs; dst = rt; is_load = true;
+				break;
+
+			case 0x22: case 0x26: // LWL/LWR merge into rt
+				src = (1u << rs) | (1u << rt); dst = rt; is_load = true;
+				break;
+
+			default:
+				return 0;
+		}
+
+		src &= ~1;
+		if (branch_pc && target)
+			return 0; // Branch in BD slot
+
+		read_first |= src & ~written;
+		if (dst)
+			written |= 1u << dst;
+
+		if (check_addresses) {
+			bool src_known = (src & known) == src;
+			if (is_load && (!src_known || !psxIdleLoopAddr(r[rs] + imm)))
+				return 0;
+			if (dst) {
+				if (src_known && !is_load) {
+					r[dst] = val;
+					known |= 1u << dst;
+				} else {
+					known &= ~(1u << dst);
+				}
+			}
+		}
+
+		if (branch_pc)
+			return (read_first & written) ? 0 : branch_pc; // BD slot done
+
+		if (target) {
+			if (target != loop_pc)
+				return 0;
+			branch_pc = pc;
+		}
+	}
+
+	return 0;
+}
+
+/* Branches that failed psxTestIdleLoop(), so short loops that aren't idle
+ *  don't get analyzed again on every iteration.
+ */
+static u32 idle_loop_rejects[64];
+
+static void intTestIdleLoop(u32 bpc) {
+	u32 *reject = &idle_loop_rejects[(bpc >> 2) & 63];
+	if (*reject == bpc)
+		return;
+
+	if (psxTestIdleLoop(branchPC, true) == bpc)
+		psxIdleLoopSkip();
+	else
+		*reject = bpc;
+}
+
 static u32 psxBranchNoDelay(void) {
 	u32 *code;
 	u32 temp;
@@ -430,6 +599,7 @@ static int psxDelayBranchTest(u32 tar1) {
 static void doBranch(u32 tar) {
 	u32 *code;
 	u32 tmp;
+	u32 bpc = psxRegs.pc - 4;
 
 	branch2 = branch = 1;
 	branchPC = tar;
@@ -485,6 +655,10 @@ static void doBranch(u32 tar) {
 	branch = 0;
 	psxRegs.pc = branchPC;
 
+	// Short backward branch, could be a loop polling for an event
+	if ((bpc - branchPC) < IDLE_LOOP_MAX_OPS * 4)
+		intTestIdleLoop(bpc);
+
 	psxBranchTest();
 }
 
@@ -947,19 +1121,282 @@ static int intInit(void) {
 }
 
 static void intReset(void) {
+	memset(idle_loop_rejects, 0, sizeof(idle_loop_rejects));
+}
+
+#ifdef USE_INT_THREADED_DISPATCH
+/* Threaded dispatch
+ *  Everything execI() does, in one function: each opcode has a label, and
+ *  each handler ends by fetching the next opcode and jumping straight to its
+ *  label through a table of label addresses (GCC computed goto). The host
+ *  branch predictor then sees one indirect jump per handler instead of the
+ *  single shared one behind psxBSC[], and PC and cycle count stay in locals.
+ *  They are written back to psxRegs only before calling out: memory
+ *  handlers, doBranch() (which runs the delay slot and psxBranchTest()), and
+ *  the regular handlers for anything not inlined here (COP0/COP2, HLE...).
+ *  Everything that can change PC or cycle behind our back is reloaded.
+ *
+ *  Unlike the psxBSC[] handlers, inlined ops write rt/rd unconditionally and
+ *  GPR 0 is cleared again after each op.
+ *
+ *  Returns when PC reaches 'stop_pc', after at least one opcode; pass an odd
+ *  value to run forever.
+ */
+#define _gRs_ gpr[_fRs_(code)]
+#define _gRt_ gpr[_fRt_(code)]
+#define _gRd_ gpr[_fRd_(code)]
+#define _gOB_ (_gRs_ + _fImm_(code))
+
+#define INT_SYNC()   do { psxRegs.pc = pc; psxRegs.cycle = cycle; } while (0)
+#define INT_RELOAD() do { pc = psxRegs.pc; cycle = psxRegs.cycle; } while (0)
+
+#define INT_DISPATCH() do {                          \
+	u32 *p = (u32 *)PSXM(pc);                        \
+	code = ((p == NULL) ? 0 : SWAP32(*p));           \
+	pc += 4;                                         \
+	cycle += BIAS;                                   \
+	goto *bsc[code >> 26];                           \
+} while (0)
+
+#define INT_NEXT() do {                              \
+	gpr[0] = 0;                                      \
+	if (pc == stop_pc) goto out;                     \
+	INT_DISPATCH();                                  \
+} while (0)
+
+/* Call a regular handler with psxRegs up to date */
+#define INT_CALL(f) do {                             \
+	psxRegs.code = code;                             \
+	INT_SYNC();                                      \
+	f;                                               \
+	INT_RELOAD();                                    \
+} while (0)
+
+#define INT_BRANCH(cond) do {                        \
+	if (cond) INT_CALL(doBranch(pc + (_fImm_(code) << 2))); \
+	INT_NEXT();                                      \
+} while (0)
+
+/* Memory handlers may run DMA, which adds to psxRegs.cycle */
+#define INT_LOAD(dst, expr) do {                     \
+	INT_SYNC();                                      \
+	u32 val = expr;                                  \
+	cycle = psxRegs.cycle;                           \
+	dst = val;                                       \
+	INT_NEXT();                                      \
+} while (0)
+
+#define INT_STORE(expr) do {                         \
+	INT_SYNC();                                      \
+	expr;                                            \
+	cycle = psxRegs.cycle;                           \
+	INT_NEXT();                                      \
+} while (0)
+
+static void intRun(u32 stop_pc)
+{
+	static const void * const bsc[64] = {
+		&&op_special, &&op_regimm, &&op_j     , &&op_jal  , &&op_beq  , &&op_bne  , &&op_blez , &&op_bgtz ,
+		&&op_addiu  , &&op_addiu , &&op_slti  , &&op_sltiu, &&op_andi , &&op_ori  , &&op_xori , &&op_lui  ,
+		&&op_call   , &&op_call  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_call   , &&op_call  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_lb     , &&op_lh    , &&op_lwl   , &&op_lw   , &&op_lbu  , &&op_lhu  , &&op_lwr  , &&op_call ,
+		&&op_sb     , &&op_sh    , &&op_swl   , &&op_sw   , &&op_call , &&op_call , &&op_swr  , &&op_call ,
+		&&op_call   , &&op_call  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_call   , &&op_call  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call
+	};
+
+	static const void * const spc[64] = {
+		&&op_sll    , &&op_call  , &&op_srl   , &&op_sra  , &&op_sllv , &&op_call , &&op_srlv , &&op_srav ,
+		&&op_jr     , &&op_jalr  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_mfhi   , &&op_mthi  , &&op_mflo  , &&op_mtlo , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_mult   , &&op_multu , &&op_div   , &&op_divu , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_addu   , &&op_addu  , &&op_subu  , &&op_subu , &&op_and  , &&op_or   , &&op_xor  , &&op_nor  ,
+		&&op_call   , &&op_call  , &&op_slt   , &&op_sltu , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_call   , &&op_call  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call ,
+		&&op_call   , &&op_call  , &&op_call  , &&op_call , &&op_call , &&op_call , &&op_call , &&op_call
+	};
+
+	u32 * const gpr = psxRegs.GPR.r;
+	u32 pc = psxRegs.pc;
+	u32 cycle = psxRegs.cycle;
+	u32 code;
+
+	INT_DISPATCH();
+
+op_special:
+	goto *spc[_fFunct_(code)];
+
+op_regimm:
+	switch (_fRt_(code)) {
+		case 0x00: INT_BRANCH((s32)_gRs_ < 0);  // BLTZ
+		case 0x01: INT_BRANCH((s32)_gRs_ >= 0); // BGEZ
+	}
+	goto op_call;
+
+op_call:
+	INT_CALL(psxBSC[code >> 26]());
+	INT_NEXT();
+
+	// Branches and jumps
+op_beq:   INT_BRANCH(_gRs_ == _gRt_);
+op_bne:   INT_BRANCH(_gRs_ != _gRt_);
+op_blez:  INT_BRANCH((s32)_gRs_ <= 0);
+op_bgtz:  INT_BRANCH((s32)_gRs_ > 0);
+
+op_j:
+	INT_CALL(doBranch(_fTarget_(code) * 4 + (pc & 0xf0000000)));
+	INT_NEXT();
+
+op_jal:
+	gpr[31] = pc + 4;
+	INT_CALL(doBranch(_fTarget_(code) * 4 + (pc & 0xf0000000)));
+	INT_NEXT();
+
+op_jr:
+	INT_CALL(doBranch(_gRs_); psxJumpTest());
+	INT_NEXT();
+
+op_jalr: {
+	u32 tar = _gRs_;
+	if (_fRd_(code)) _gRd_ = pc + 4;
+	INT_CALL(doBranch(tar));
+	INT_NEXT();
+}
+
+	// Arithmetic with immediate operand (ADDI doesn't trap, same as psxADDI)
+op_addiu: _gRt_ = _gRs_ + _fImm_(code);           INT_NEXT();
+op_slti:  _gRt_ = (s32)_gRs_ < _fImm_(code);      INT_NEXT();
+op_sltiu: _gRt_ = _gRs_ < (u32)_fImm_(code);      INT_NEXT();
+op_andi:  _gRt_ = _gRs_ & _fImmU_(code);          INT_NEXT();
+op_ori:   _gRt_ = _gRs_ | _fImmU_(code);          INT_NEXT();
+op_xori:  _gRt_ = _gRs_ ^ _fImmU_(code);          INT_NEXT();
+op_lui:   _gRt_ = code << 16;                     INT_NEXT();
+
+	// Register arithmetic (ADD/SUB don't trap either)
+op_addu:  _gRd_ = _gRs_ + _gRt_;                  INT_NEXT();
+op_subu:  _gRd_ = _gRs_ - _gRt_;                  INT_NEXT();
+op_and:   _gRd_ = _gRs_ & _gRt_;                  INT_NEXT();
+op_or:    _gRd_ = _gRs_ | _gRt_;                  INT_NEXT();
+op_xor:   _gRd_ = _gRs_ ^ _gRt_;                  INT_NEXT();
+op_nor:   _gRd_ = ~(_gRs_ | _gRt_);               INT_NEXT();
+op_slt:   _gRd_ = (s32)_gRs_ < (s32)_gRt_;        INT_NEXT();
+op_sltu:  _gRd_ = _gRs_ < _gRt_;                  INT_NEXT();
+
+	// Shifts
+op_sll:   _gRd_ = _gRt_ << _fSa_(code);           INT_NEXT();
+op_srl:   _gRd_ = _gRt_ >> _fSa_(code);           INT_NEXT();
+op_sra:   _gRd_ = (s32)_gRt_ >> _fSa_(code);      INT_NEXT();
+op_sllv:  _gRd_ = _gRt_ << _gRs_;                 INT_NEXT();
+op_srlv:  _gRd_ = _gRt_ >> _gRs_;                 INT_NEXT();
+op_srav:  _gRd_ = (s32)_gRt_ >> _gRs_;            INT_NEXT();
+
+	// HI/LO
+op_mfhi:  _gRd_ = _rHi_;                          INT_NEXT();
+op_mflo:  _gRd_ = _rLo_;                          INT_NEXT();
+op_mthi:  _rHi_ = _gRs_;                          INT_NEXT();
+op_mtlo:  _rLo_ = _gRs_;                          INT_NEXT();
+
+op_mult: {
+	u64 res = (s64)(s32)_gRs_ * (s64)(s32)_gRt_;
+	_rLo_ = (u32)res;
+	_rHi_ = (u32)(res >> 32);
+	INT_NEXT();
+}
+
+op_multu: {
+	u64 res = (u64)_gRs_ * (u64)_gRt_;
+	_rLo_ = (u32)res;
+	_rHi_ = (u32)(res >> 32);
+	INT_NEXT();
+}
+
+op_div: {
+	s32 rs = _gRs_, rt = _gRt_;
+	if (rt != 0) {
+		_rLo_ = rs / rt;
+		_rHi_ = rs % rt;
+	} else {
+		_rLo_ = rs >= 0 ? 0xffffffff : 1;
+		_rHi_ = rs;
+	}
+	INT_NEXT();
 }
 
+op_divu: {
+	u32 rs = _gRs_, rt = _gRt_;
+	if (rt != 0) {
+		_rLo_ = rs / rt;
+		_rHi_ = rs % rt;
+	} else {
+		_rLo_ = 0xffffffff;
+		_rHi_ = rs;
+	}
+	INT_NEXT();
+}
+
+	// Loads and stores
+op_lb:    INT_LOAD(_gRt_, (s8)psxMemRead8(_gOB_));
+op_lbu:   INT_LOAD(_gRt_, psxMemRead8(_gOB_));
+op_lh:    INT_LOAD(_gRt_, (s16)psxMemRead16(_gOB_));
+op_lhu:   INT_LOAD(_gRt_, psxMemRead16(_gOB_));
+op_lw:    INT_LOAD(_gRt_, psxMemRead32(_gOB_));
+
+op_lwl: {
+	u32 addr = _gOB_;
+	u32 shift = addr & 3;
+	INT_LOAD(_gRt_, (_gRt_ & LWL_MASK[shift]) |
+	                (psxMemRead32(addr & ~3) << LWL_SHIFT[shift]));
+}
+
+op_lwr: {
+	u32 addr = _gOB_;
+	u32 shift = addr & 3;
+	INT_LOAD(_gRt_, (_gRt_ & LWR_MASK[shift]) |
+	                (psxMemRead32(addr & ~3) >> LWR_SHIFT[shift]));
+}
+
+op_sb:    INT_STORE(psxMemWrite8 (_gOB_, _gRt_ &   0xff));
+op_sh:    INT_STORE(psxMemWrite16(_gOB_, _gRt_ & 0xffff));
+op_sw:    INT_STORE(psxMemWrite32(_gOB_, _gRt_));
+
+op_swl: {
+	u32 addr = _gOB_;
+	u32 shift = addr & 3;
+	INT_STORE(u32 mem = psxMemRead32(addr & ~3);
+	          psxMemWrite32(addr & ~3, (_gRt_ >> SWL_SHIFT[shift]) |
+	                                   (mem & SWL_MASK[shift])));
+}
+
+op_swr: {
+	u32 addr = _gOB_;
+	u32 shift = addr & 3;
+	INT_STORE(u32 mem = psxMemRead32(addr & ~3);
+	          psxMemWrite32(addr & ~3, (_gRt_ << SWR_SHIFT[shift]) |
+	                                   (mem & SWR_MASK[shift])));
+}
+
+out:
+	INT_SYNC();
+}
+#endif // USE_INT_THREADED_DISPATCH
+
 static void intExecute(void) {
+#ifdef USE_INT_THREADED_DISPATCH
+	intRun(1);
+#else
 	for (;;)
 		execI();
+#endif
 }
 
 static void intExecuteBlock(unsigned target_pc) {
 	branch2 = 0;
+#ifdef USE_INT_THREADED_DISPATCH
+	intRun(target_pc);
+#else
 	do{ execI(); }while(psxRegs.pc!=target_pc);
-}
-
-static void intClear(u32 Addr, u32 Size) {
+#endif
 }
 
 /* Custom function added to notify dynarecs about icache-related events.
@@ -987,12 +1424,498 @@ void execI(void) {
 	psxBSC[psxRegs.code >> 26]();
 }
 
+/* Lockstep checker support: runs the block at psxRegs.pc the way the
+ *  recompilers split code, i.e. up to and including the delay slot of the
+ *  first branch or jump. Returns number of ops run, or 0 when the block
+ *  can't be replayed: HW I/O (see psxLockstepShadowHw()), HLE, SYSCALL and
+ *  BREAK, BIOS calls, or more than LOCKSTEP_MAX_OPS ops. Stops *before*
+ *  running the latter ones, as they have side effects beyond psxRegs/RAM.
+ */
+#define LOCKSTEP_MAX_OPS 1024
+
+static bool lockstepOpIsSafe(u32 code)
+{
+	switch (code >> 26) {
+		case 0x00:
+			switch (code & 0x3f) {
+				case 0x08: case 0x09: { // JR/JALR to BIOS A0/B0/C0 tables
+					u32 tar = psxRegs.GPR.r[_fRs_(code)] & 0x1fffff;
+					return tar != 0xa0 && tar != 0xb0 && tar != 0xc0;
+				}
+				case 0x0c: case 0x0d:   // SYSCALL/BREAK
+					return false;
+			}
+			return true;
+		case 0x3b:                      // HLE
+			return false;
+	}
+	return true;
+}
+
+static bool lockstepOpIsBranch(u32 code)
+{
+	switch (code >> 26) {
+		case 0x00:
+			return (code & 0x3e) == 0x08;         // JR/JALR
+		case 0x01:
+			return (_fRt_(code) & 0x0e) == 0x00;  // BLTZ/BGEZ(AL)
+	}
+	return (code >> 26) <= 0x07;
+}
+
+int psxIntExecuteShadowBlock(void)
+{
+	for (int ops = 1; ops <= LOCKSTEP_MAX_OPS; ++ops) {
+		u32 *code = (u32 *)PSXM(psxRegs.pc);
+		u32 op = ((code == NULL) ? 0 : SWAP32(*code));
+		if (!lockstepOpIsSafe(op))
+			return 0;
+
+		if (lockstepOpIsBranch(op)) {
+			code = (u32 *)PSXM(psxRegs.pc + 4);
+			if (!lockstepOpIsSafe((code == NULL) ? 0 : SWAP32(*code)))
+				return 0;
+
+			// Taken branches run the delay slot in doBranch()
+			branch2 = 0;
+			execI();
+			if (!branch2)
+				execI();
+			return !psxLockstepShadowFailed ? ops + 1 : 0;
+		}
+
+		execI();
+		if (psxLockstepShadowFailed)
+			return 0;
+	}
+	return 0;
+}
+
 R3000Acpu psxInt = {
 	intInit,
 	intReset,
 	intExecute,
 	intExecuteBlock,
-	intClear,
+	NULL,  // Clear: no code is cached
 	intNotify,
 	intShutdown
 };
+
+
+///////////////////////////////////////////////////////////////////////////////
+// -BEGIN- Cached interpreter
+///////////////////////////////////////////////////////////////////////////////
+/* Decodes each block of PS1 code once into an array of handler pointers with
+ *  pre-extracted operands, instead of fetching and decoding through psxBSC[]
+ *  etc. on every instruction. Blocks end at the first branch/jump or any other
+ *  op that might change PC or raise an exception, and that op is executed by
+ *  the regular interpreter handler, so delay slots, load delays and
+ *  psxBranchTest() behave exactly as in psxInt.
+ *
+ *  Invalidation uses the same per-page idea as the recompilers: blocks never
+ *  cross a 256-byte code page, and code_pages[] marks RAM pages that blocks
+ *  were decoded from. A write to a marked page drops all blocks in it.
+ */
+#define CINT_PAGE_SHIFT     8
+#define CINT_PAGE_SIZE      (1 << CINT_PAGE_SHIFT)
+#define CINT_NUM_PAGES      (0x200000 >> CINT_PAGE_SHIFT)
+#define CINT_MAX_BLOCK_OPS  (CINT_PAGE_SIZE / 4)
+#define CINT_MAX_OPS        (128*1024)
+
+/* cint_op.flags */
+#define CINT_END            1  /* Last op of block */
+#define CINT_CHECK          2  /* Op writes memory, check for invalidation */
+
+struct cint_op;
+typedef void (*cint_func)(const cint_op *);
+
+typedef struct cint_op {
+	cint_func func;
+	u32 code;          /* Raw opcode, for ops run by regular interpreter */
+	u32 imm;           /* Extended immediate, or shift amount */
+	u8  rs, rt, rd;
+	u8  flags;
+} cint_op;
+
+static cint_op  *cint_ops;          /* Decoded ops of all blocks */
+static u32       cint_num_ops;      /* Entries of cint_ops[] in use */
+static cint_op **cint_RAM;          /* Block ptr for each word of RAM/ROM */
+static cint_op **cint_ROM;
+static cint_op **cint_LUT[0x10000];
+static u8        code_pages[CINT_NUM_PAGES];
+static bool      cint_invalidated;  /* Some block dropped by a write? */
+
+#define CINT_RAM_SIZE (0x200000 / 4 * sizeof(cint_op *))
+#define CINT_ROM_SIZE (0x080000 / 4 * sizeof(cint_op *))
+#define PC_CINT(x) (cint_LUT[(x) >> 16] + (((x) & 0xffff) >> 2))
+
+#define _oR_(x) psxRegs.GPR.r[op->x]
+#define _oB_c   (_oR_(rs) + op->imm)
+
+static void cint_NOP(const cint_op *op) {}
+
+static void cint_ADDIU(const cint_op *op) { _oR_(rt) = _oR_(rs) + op->imm; }
+static void cint_SLTI(const cint_op *op)  { _oR_(rt) = (s32)_oR_(rs) < (s32)op->imm; }
+static void cint_SLTIU(const cint_op *op) { _oR_(rt) = _oR_(rs) < op->imm; }
+static void cint_ANDI(const cint_op *op)  { _oR_(rt) = _oR_(rs) & op->imm; }
+static void cint_ORI(const cint_op *op)   { _oR_(rt) = _oR_(rs) | op->imm; }
+static void cint_XORI(const cint_op *op)  { _oR_(rt) = _oR_(rs) ^ op->imm; }
+static void cint_LUI(const cint_op *op)   { _oR_(rt) = op->imm; }
+
+static void cint_ADDU(const cint_op *op)  { _oR_(rd) = _oR_(rs) + _oR_(rt); }
+static void cint_SUBU(const cint_op *op)  { _oR_(rd) = _oR_(rs) - _oR_(rt); }
+static void cint_AND(const cint_op *op)   { _oR_(rd) = _oR_(rs) & _oR_(rt); }
+static void cint_OR(const cint_op *op)    { _oR_(rd) = _oR_(rs) | _oR_(rt); }
+static void cint_XOR(const cint_op *op)   { _oR_(rd) = _oR_(rs) ^ _oR_(rt); }
+static void cint_NOR(const cint_op *op)   { _oR_(rd) = ~(_oR_(rs) | _oR_(rt)); }
+static void cint_SLT(const cint_op *op)   { _oR_(rd) = (s32)_oR_(rs) < (s32)_oR_(rt); }
+static void cint_SLTU(const cint_op *op)  { _oR_(rd) = _oR_(rs) < _oR_(rt); }
+
+static void cint_SLL(const cint_op *op)   { _oR_(rd) = _oR_(rt) << op->imm; }
+static void cint_SRL(const cint_op *op)   { _oR_(rd) = _oR_(rt) >> op->imm; }
+static void cint_SRA(const cint_op *op)   { _oR_(rd) = (s32)_oR_(rt) >> op->imm; }
+static void cint_SLLV(const cint_op *op)  { _oR_(rd) = _oR_(rt) << _oR_(rs); }
+static void cint_SRLV(const cint_op *op)  { _oR_(rd) = _oR_(rt) >> _oR_(rs); }
+static void cint_SRAV(const cint_op *op)  { _oR_(rd) = (s32)_oR_(rt) >> _oR_(rs); }
+
+static void cint_MFHI(const cint_op *op)  { _oR_(rd) = _rHi_; }
+static void cint_MFLO(const cint_op *op)  { _oR_(rd) = _rLo_; }
+static void cint_MTHI(const cint_op *op)  { _rHi_ = _oR_(rs); }
+static void cint_MTLO(const cint_op *op)  { _rLo_ = _oR_(rs); }
+
+static void cint_MULT(const cint_op *op) {
+	u64 res = (s64)((s64)(s32)_oR_(rs) * (s64)(s32)_oR_(rt));
+	_rLo_ = (u32)res;
+	_rHi_ = (u32)(res >> 32);
+}
+
+static void cint_MULTU(const cint_op *op) {
+	u64 res = (u64)((u64)_oR_(rs) * (u64)_oR_(rt));
+	_rLo_ = (u32)res;
+	_rHi_ = (u32)(res >> 32);
+}
+
+static void cint_DIV(const cint_op *op) {
+	s32 rs = _oR_(rs), rt = _oR_(rt);
+	if (rt != 0) {
+		_i32(_rLo_) = rs / rt;
+		_i32(_rHi_) = rs % rt;
+	} else {
+		_i32(_rLo_) = rs >= 0 ? 0xffffffff : 1;
+		_i32(_rHi_) = rs;
+	}
+}
+
+static void cint_DIVU(const cint_op *op) {
+	u32 rs = _oR_(rs), rt = _oR_(rt);
+	if (rt != 0) {
+		_rLo_ = rs / rt;
+		_rHi_ = rs % rt;
+	} else {
+		_i32(_rLo_) = 0xffffffff;
+		_i32(_rHi_) = rs;
+	}
+}
+
+static void cint_LB(const cint_op *op)  { _oR_(rt) = (s8)psxMemRead8(_oB_c); }
+static void cint_LBU(const cint_op *op) { _oR_(rt) = psxMemRead8(_oB_c); }
+static void cint_LH(const cint_op *op)  { _oR_(rt) = (s16)psxMemRead16(_oB_c); }
+static void cint_LHU(const cint_op *op) { _oR_(rt) = psxMemRead16(_oB_c); }
+static void cint_LW(const cint_op *op)  { _oR_(rt) = psxMemRead32(_oB_c); }
+
+static void cint_LWL(const cint_op *op) {
+	u32 addr = _oB_c;
+	u32 shift = addr & 3;
+	u32 mem = psxMemRead32(addr & ~3);
+	_oR_(rt) = (_oR_(rt) & LWL_MASK[shift]) | (mem << LWL_SHIFT[shift]);
+}
+
+static void cint_LWR(const cint_op *op) {
+	u32 addr = _oB_c;
+	u32 shift = addr & 3;
+	u32 mem = psxMemRead32(addr & ~3);
+	_oR_(rt) = (_oR_(rt) & LWR_MASK[shift]) | (mem >> LWR_SHIFT[shift]);
+}
+
+static void cint_SB(const cint_op *op) { psxMemWrite8 (_oB_c, _oR_(rt) &   0xff); }
+static void cint_SH(const cint_op *op) { psxMemWrite16(_oB_c, _oR_(rt) & 0xffff); }
+static void cint_SW(const cint_op *op) { psxMemWrite32(_oB_c, _oR_(rt)); }
+
+static void cint_SWL(const cint_op *op) {
+	u32 addr = _oB_c;
+	u32 shift = addr & 3;
+	u32 mem = psxMemRead32(addr & ~3);
+	psxMemWrite32(addr & ~3, (_oR_(rt) >> SWL_SHIFT[shift]) | (mem & SWL_MASK[shift]));
+}
+
+static void cint_SWR(const cint_op *op) {
+	u32 addr = _oB_c;
+	u32 shift = addr & 3;
+	u32 mem = psxMemRead32(addr & ~3);
+	psxMemWrite32(addr & ~3, (_oR_(rt) << SWR_SHIFT[shift]) | (mem & SWR_MASK[shift]));
+}
+
+/* Anything not handled above goes through the regular interpreter */
+static void cint_Interp(const cint_op *op) {
+	psxRegs.code = op->code;
+	psxBSC[op->code >> 26]();
+}
+
+#undef _oR_
+#undef _oB_c
+
+/* Decode opcode 'code' into 'op' */
+static void cint_decode(cint_op *op, u32 code)
+{
+	const u32 rs = _fRs_(code), rt = _fRt_(code), rd = _fRd_(code);
+	cint_func f = NULL;
+
+	op->code = code;
+	op->rs = rs;
+	op->rt = rt;
+	op->rd = rd;
+	op->imm = (s32)_fImm_(code);
+	op->flags = 0;
+
+	switch (_fOp_(code)) {
+		case 0x00: // SPECIAL
+			switch (_fFunct_(code)) {
+				case 0x00: f = cint_SLL;  op->imm = _fSa_(code); break;
+				case 0x02: f = cint_SRL;  op->imm = _fSa_(code); break;
+				case 0x03: f = cint_SRA;  op->imm = _fSa_(code); break;
+				case 0x04: f = cint_SLLV; break;
+				case 0x06: f = cint_SRLV; break;
+				case 0x07: f = cint_SRAV; break;
+				case 0x10: f = cint_MFHI; break;
+				case 0x12: f = cint_MFLO; break;
+				case 0x11: op->func = cint_MTHI;  return;
+				case 0x13: op->func = cint_MTLO;  return;
+				case 0x18: op->func = cint_MULT;  return;
+				case 0x19: op->func = cint_MULTU; return;
+				case 0x1a: op->func = cint_DIV;   return;
+				case 0x1b: op->func = cint_DIVU;  return;
+				case 0x20: case 0x21: f = cint_ADDU; break;
+				case 0x22: case 0x23: f = cint_SUBU; break;
+				case 0x24: f = cint_AND;  break;
+				case 0x25: f = cint_OR;   break;
+				case 0x26: f = cint_XOR;  break;
+				case 0x27: f = cint_NOR;  break;
+				case 0x2a: f = cint_SLT;  break;
+				case 0x2b: f = cint_SLTU; break;
+				case 0x0d: // BREAK is a nop in psxInt
+					op->func = cint_NOP;
+					return;
+				default:   // JR, JALR, SYSCALL, unknown
+					op->func = cint_Interp;
+					op->flags = CINT_END;
+					return;
+			}
+			// All of the above write rd
+			op->func = rd ? f : cint_NOP;
+			return;
+
+		case 0x08: case 0x09: f = cint_ADDIU; break;
+		case 0x0a: f = cint_SLTI;  break;
+		case 0x0b: f = cint_SLTIU; break;
+		case 0x0c: f = cint_ANDI;  op->imm = _fImmU_(code); break;
+		case 0x0d: f = cint_ORI;   op->imm = _fImmU_(code); break;
+		case 0x0e: f = cint_XORI;  op->imm = _fImmU_(code); break;
+		case 0x0f: f = cint_LUI;   op->imm = code << 16;    break;
+
+		case 0x20: f = cint_LB;  break;
+		case 0x21: f = cint_LH;  break;
+		case 0x22: f = cint_LWL; break;
+		case 0x23: f = cint_LW;  break;
+		case 0x24: f = cint_LBU; break;
+		case 0x25: f = cint_LHU; break;
+		case 0x26: f = cint_LWR; break;
+
+		case 0x28: op->func = cint_SB;  op->flags = CINT_CHECK; return;
+		case 0x29: op->func = cint_SH;  op->flags = CINT_CHECK; return;
+		case 0x2a: op->func = cint_SWL; op->flags = CINT_CHECK; return;
+		case 0x2b: op->func = cint_SW;  op->flags = CINT_CHECK; return;
+		case 0x2e: op->func = cint_SWR; op->flags = CINT_CHECK; return;
+
+		case 0x10: // COP0
+			if (_fRs_(code) == 0x00 || _fRs_(code) == 0x02) {
+				// MFC0/CFC0 can't change PC
+				op->func = cint_Interp;
+				return;
+			}
+			// MTC0/CTC0 can raise an exception, RFE can unmask one
+			op->func = cint_Interp;
+			op->flags = CINT_END;
+			return;
+
+		case 0x12: // COP2
+		case 0x32: // LWC2
+		case 0x3a: // SWC2
+			op->func = cint_Interp;
+			op->flags = CINT_CHECK;
+			return;
+
+		default:   // Branches, jumps, HLE, unknown
+			op->func = cint_Interp;
+			op->flags = CINT_END;
+			return;
+	}
+
+	// All of the above write rt. Loads into $zero must still do the read.
+	if (rt)
+		op->func = f;
+	else if (_fOp_(code) >= 0x20)
+		op->func = cint_Interp;
+	else
+		op->func = cint_NOP;
+}
+
+static void cint_flush()
+{
+	memset(cint_RAM, 0, CINT_RAM_SIZE);
+	memset(cint_ROM, 0, CINT_ROM_SIZE);
+	memset(code_pages, 0, sizeof(code_pages));
+	cint_num_ops = 0;
+}
+
+/* Decode block at psxRegs.pc, returns its first op */
+static cint_op *cint_decode_block()
+{
+	if (cint_num_ops + CINT_MAX_BLOCK_OPS > CINT_MAX_OPS)
+		cint_flush();
+
+	const u32 start_pc = psxRegs.pc;
+	cint_op *block = &cint_ops[cint_num_ops];
+	cint_op *op = block;
+	u32 pc = start_pc;
+
+	do {
+		cint_decode(op, PSXMu32(pc));
+		pc += 4;
+	} while (!((op++)->flags & CINT_END) && (pc & (CINT_PAGE_SIZE-1)) != 0);
+
+	op[-1].flags |= CINT_END;
+	cint_num_ops += op - block;
+
+	*PC_CINT(start_pc) = block;
+
+	// For the range check, bit 27 is interpreted as a sign bit.
+	if ((s32)(start_pc << 4) >= 0)
+		code_pages[(start_pc & 0x1fffff) >> CINT_PAGE_SHIFT] = 1;
+
+	return block;
+}
+
+/* Execute block at psxRegs.pc, decoding it first if needed */
+static inline void cint_run_block()
+{
+	cint_op **lut = cint_LUT[psxRegs.pc >> 16];
+
+	if (lut == NULL) {
+		// PC isn't in RAM or ROM
+		execI();
+		return;
+	}
+
+	const cint_op *op = *PC_CINT(psxRegs.pc);
+	if (op == NULL)
+		op = cint_decode_block();
+
+	cint_invalidated = false;
+	for (;;) {
+		// Read flags first: an op that re-enters the CPU (HLE) can
+		//  flush the cache, but it is always the last one in its block.
+		const u32 flags = op->flags;
+
+		psxRegs.pc += 4;
+		psxRegs.cycle += BIAS;
+		op->func(op);
+
+		if (flags && ((flags & CINT_END) || cint_invalidated))
+			break;
+		op++;
+	}
+}
+
+static int cintInit(void) {
+	cint_ops = (cint_op *)malloc(CINT_MAX_OPS * sizeof(cint_op));
+	cint_RAM = (cint_op **)malloc(CINT_RAM_SIZE);
+	cint_ROM = (cint_op **)malloc(CINT_ROM_SIZE);
+	if (cint_ops == NULL || cint_RAM == NULL || cint_ROM == NULL) {
+		printf("Error allocating memory\n");
+		return -1;
+	}
+
+	for (int i = 0; i < 0x80; i++)
+		cint_LUT[i + 0x0000] = cint_RAM + (((i & 0x1f) << 16) >> 2);
+	memcpy(&cint_LUT[0x8000], cint_LUT, 0x80 * sizeof(cint_LUT[0]));
+	memcpy(&cint_LUT[0xa000], cint_LUT, 0x80 * sizeof(cint_LUT[0]));
+	for (int i = 0; i < 0x08; i++) {
+		cint_LUT[i + 0x1fc0] = cint_ROM + ((i << 16) >> 2);
+		cint_LUT[i + 0x9fc0] = cint_ROM + ((i << 16) >> 2);
+		cint_LUT[i + 0xbfc0] = cint_ROM + ((i << 16) >> 2);
+	}
+
+	cint_flush();
+	return 0;
+}
+
+static void cintReset(void) {
+	memset(idle_loop_rejects, 0, sizeof(idle_loop_rejects));
+	cint_flush();
+}
+
+static void cintExecute(void) {
+	for (;;)
+		cint_run_block();
+}
+
+static void cintExecuteBlock(unsigned target_pc) {
+	branch2 = 0;
+	do { cint_run_block(); } while (psxRegs.pc != target_pc);
+}
+
+/* Drop all blocks in code pages overlapping the 'Size' words at 'Addr' */
+static void cintClear(u32 Addr, u32 Size) {
+	u32 start = Addr & 0x1ffffc;
+	u32 end = start + Size*4;
+	if (end > 0x200000)
+		end = 0x200000;
+	if (start >= end)
+		return;
+
+	for (u32 page = start >> CINT_PAGE_SHIFT; page <= (end-1) >> CINT_PAGE_SHIFT; ++page) {
+		if (code_pages[page]) {
+			code_pages[page] = 0;
+			memset(&cint_RAM[(page << CINT_PAGE_SHIFT) >> 2], 0,
+			       CINT_PAGE_SIZE / 4 * sizeof(cint_op *));
+			cint_invalidated = true;
+		}
+	}
+}
+
+static void cintNotify(int note, void *data) {
+	// Same as recompilers: game has loaded new code
+	if (note == R3000ACPU_NOTIFY_CACHE_UNISOLATED)
+		cintClear(0, 0x200000/4);
+}
+
+static void cintShutdown(void) {
+	free(cint_ops);
+	free(cint_RAM);
+	free(cint_ROM);
+	cint_ops = NULL;
+	cint_RAM = cint_ROM = NULL;
+}
+
+R3000Acpu psxIntCached = {
+	cintInit,
+	cintReset,
+	cintExecute,
+	cintExecuteBlock,
+	cintClear,
+	cintNotify,
+	cintShutdown
+};
+///////////////////////////////////////////////////////////////////////////////
+// -END- Cached interpreter
+///////////////////////////////////////////////////////////////////////////////
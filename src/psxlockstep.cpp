@@ -0,0 +1,438 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * Lockstep checker (for development purposes, enabled with '-lockstep')
+ *
+ *  Wraps the recompiler as psxCpu. For every block, psxInt first replays it
+ *  from the current state as a 'shadow' run: its memory writes are logged
+ *  and undone afterwards, and it refuses to touch HW I/O. psxRegs is then
+ *  restored and the recompiler runs the same code for real. Both results
+ *  are compared: all of psxRegs that the CPU itself changes (GPRs, LO/HI,
+ *  COP0, GTE, PC) and the RAM/scratchpad bytes psxInt wrote. The first
+ *  difference is reported with a disassembly of the block, and emulation
+ *  stops.
+ *
+ *  Blocks psxInt can't replay without side effects (HW I/O, HLE, SYSCALL,
+ *  BIOS calls) run on the recompiler alone, unchecked. Cycle counts aren't
+ *  compared: recompilers can scale them (cycle_multiplier), and psxInt's
+ *  idle loop detection may fast-forward at different points. Stray
+ *  recompiler writes to RAM that psxInt didn't write aren't detected.
+ */
+
+#include "psxlockstep.h"
+
+bool psxLockstepInBlock;
+bool psxLockstepShadow;
+bool psxLockstepShadowFailed;
+
+static bool lockstep_enabled;
+
+#define LOCKSTEP_MAX_WRITES 1024
+
+typedef struct {
+	u32 addr;      // PS1 address
+	u8 *ptr;       // Host address written
+	u32 size;
+	u32 old_val;   // Raw bytes before the write
+	u32 new_val;   // Raw bytes at the end of the block
+} lockstep_write;
+
+static lockstep_write writes[LOCKSTEP_MAX_WRITES];
+static int num_writes;
+
+void psxLockstepShadowWrite(u32 addr, void *ptr, u32 size)
+{
+	if (num_writes == LOCKSTEP_MAX_WRITES) {
+		psxLockstepShadowFailed = true;
+		return;
+	}
+
+	lockstep_write *w = &writes[num_writes++];
+	w->addr = addr;
+	w->ptr = (u8 *)ptr;
+	w->size = size;
+	memcpy(&w->old_val, ptr, size);
+}
+
+void psxLockstepShadowHw(u32 addr)
+{
+	psxLockstepShadowFailed = true;
+}
+
+void psxLockstepEnable(void)
+{
+#ifdef PSXREC
+	lockstep_enabled = true;
+#else
+	printf("Lockstep checker needs a recompiler build, disabled.\n");
+#endif
+}
+
+bool psxLockstepEnabled(void)
+{
+	return lockstep_enabled;
+}
+
+#ifdef PSXREC
+
+extern void execI();
+
+///////////////////////////////////////////////////////////////////////////////
+// Disassembler, for divergence reports
+///////////////////////////////////////////////////////////////////////////////
+
+static const char * const gpr_names[34] = {
+	"r0", "at", "v0", "v1", "a0", "a1", "a2", "a3",
+	"t0", "t1", "t2", "t3", "t4", "t5", "t6", "t7",
+	"s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7",
+	"t8", "t9", "k0", "k1", "gp", "sp", "fp", "ra",
+	"lo", "hi"
+};
+
+static const char * const bsc_names[64] = {
+	NULL  , NULL   , "j"   , "jal"  , "beq" , "bne" , "blez", "bgtz",
+	"addi", "addiu", "slti", "sltiu", "andi", "ori" , "xori", "lui" ,
+	NULL  , NULL   , NULL  , NULL   , NULL  , NULL  , NULL  , NULL  ,
+	NULL  , NULL   , NULL  , NULL   , NULL  , NULL  , NULL  , NULL  ,
+	"lb"  , "lh"   , "lwl" , "lw"   , "lbu" , "lhu" , "lwr" , NULL  ,
+	"sb"  , "sh"   , "swl" , "sw"   , NULL  , NULL  , "swr" , NULL  ,
+	NULL  , NULL   , "lwc2", NULL   , NULL  , NULL  , NULL  , NULL  ,
+	NULL  , NULL   , "swc2", NULL   , NULL  , NULL  , NULL  , NULL
+};
+
+static const char * const spc_names[64] = {
+	"sll" , NULL   , "srl" , "sra"  , "sllv"   , NULL   , "srlv", "srav",
+	"jr"  , "jalr" , NULL  , NULL   , "syscall", "break", NULL  , NULL  ,
+	"mfhi", "mthi" , "mflo", "mtlo" , NULL     , NULL   , NULL  , NULL  ,
+	"mult", "multu", "div" , "divu" , NULL     , NULL   , NULL  , NULL  ,
+	"add" , "addu" , "sub" , "subu" , "and"    , "or"   , "xor" , "nor" ,
+	NULL  , NULL   , "slt" , "sltu" , NULL     , NULL   , NULL  , NULL  ,
+	NULL  , NULL   , NULL  , NULL   , NULL     , NULL   , NULL  , NULL  ,
+	NULL  , NULL   , NULL  , NULL   , NULL     , NULL   , NULL  , NULL
+};
+
+static const char * const gte_names[64] = {
+	NULL   , "rtps"  , NULL   , NULL   , NULL   , NULL   , "nclip", NULL   ,
+	NULL   , NULL    , NULL   , NULL   , "op"   , NULL   , NULL   , NULL   ,
+	"dpcs" , "intpl" , "mvmva", "ncds" , "cdp"  , NULL   , "ncdt" , NULL   ,
+	NULL   , NULL    , NULL   , "nccs" , "cc"   , NULL   , "ncs"  , NULL   ,
+	"nct"  , NULL    , NULL   , NULL   , NULL   , NULL   , NULL   , NULL   ,
+	"sqr"  , "dcpl"  , "dpct" , NULL   , NULL   , "avsz3", "avsz4", NULL   ,
+	"rtpt" , NULL    , NULL   , NULL   , NULL   , NULL   , NULL   , NULL   ,
+	NULL   , NULL    , NULL   , NULL   , NULL   , "gpf"  , "gpl"  , "ncct"
+};
+
+static const char * const cop_mv_names[8] = {
+	"mfc", NULL, "cfc", NULL, "mtc", NULL, "ctc", NULL
+};
+
+#define RS gpr_names[_fRs_(code)]
+#define RT gpr_names[_fRt_(code)]
+#define RD gpr_names[_fRd_(code)]
+
+static void disasm(char *buf, u32 code, u32 pc)
+{
+	const u32 op = _fOp_(code);
+	const u32 funct = _fFunct_(code);
+	const u32 btarget = pc + 4 + (_fImm_(code) << 2);
+	const char *name = bsc_names[op];
+
+	if (code == 0) {
+		sprintf(buf, "nop");
+		return;
+	}
+
+	switch (op) {
+		case 0x00:
+			name = spc_names[funct];
+			if (name == NULL)
+				break;
+			switch (funct) {
+				case 0x00: case 0x02: case 0x03:
+					sprintf(buf, "%-7s %s, %s, %u", name, RD, RT, _fSa_(code));
+					return;
+				case 0x04: case 0x06: case 0x07:
+					sprintf(buf, "%-7s %s, %s, %s", name, RD, RT, RS);
+					return;
+				case 0x08: case 0x11: case 0x13:
+					sprintf(buf, "%-7s %s", name, RS);
+					return;
+				case 0x09:
+					sprintf(buf, "%-7s %s, %s", name, RD, RS);
+					return;
+				case 0x0c: case 0x0d:
+					sprintf(buf, "%s", name);
+					return;
+				case 0x10: case 0x12:
+					sprintf(buf, "%-7s %s", name, RD);
+					return;
+				case 0x18: case 0x19: case 0x1a: case 0x1b:
+					sprintf(buf, "%-7s %s, %s", name, RS, RT);
+					return;
+				default:
+					sprintf(buf, "%-7s %s, %s, %s", name, RD, RS, RT);
+					return;
+			}
+			break;
+		case 0x01:
+			switch (_fRt_(code)) {
+				case 0x00: name = "bltz";   break;
+				case 0x01: name = "bgez";   break;
+				case 0x10: name = "bltzal"; break;
+				case 0x11: name = "bgezal"; break;
+			}
+			if (name == NULL)
+				break;
+			sprintf(buf, "%-7s %s, %08x", name, RS, btarget);
+			return;
+		case 0x02: case 0x03:
+			sprintf(buf, "%-7s %08x", name, (_fTarget_(code) << 2) | ((pc + 4) & 0xf0000000));
+			return;
+		case 0x04: case 0x05:
+			sprintf(buf, "%-7s %s, %s, %08x", name, RS, RT, btarget);
+			return;
+		case 0x06: case 0x07:
+			sprintf(buf, "%-7s %s, %08x", name, RS, btarget);
+			return;
+		case 0x08: case 0x09: case 0x0a: case 0x0b:
+			sprintf(buf, "%-7s %s, %s, %d", name, RT, RS, _fImm_(code));
+			return;
+		case 0x0c: case 0x0d: case 0x0e:
+			sprintf(buf, "%-7s %s, %s, 0x%04x", name, RT, RS, _fImmU_(code));
+			return;
+		case 0x0f:
+			sprintf(buf, "%-7s %s, 0x%04x", name, RT, _fImmU_(code));
+			return;
+		case 0x10: case 0x12:
+			if (op == 0x10 && _fRs_(code) == 0x10 && funct == 0x10) {
+				sprintf(buf, "rfe");
+				return;
+			}
+			if (op == 0x12 && (code & 0x02000000)) {
+				if ((name = gte_names[funct]) == NULL)
+					break;
+				sprintf(buf, "%-7s 0x%07x", name, code & 0x1ffffff);
+				return;
+			}
+			if (_fRs_(code) >= 8 || (name = cop_mv_names[_fRs_(code)]) == NULL)
+				break;
+			sprintf(buf, "%s%-4u %s, $%u", name, op == 0x10 ? 0 : 2, RT, _fRd_(code));
+			return;
+		case 0x32: case 0x3a:
+			sprintf(buf, "%-7s $%u, %d(%s)", name, _fRt_(code), _fImm_(code), RS);
+			return;
+		case 0x3b:
+			sprintf(buf, "hle     %u", code & 0x07);
+			return;
+		default:
+			if (name == NULL)
+				break;
+			sprintf(buf, "%-7s %s, %d(%s)", name, RT, _fImm_(code), RS);
+			return;
+	}
+
+	sprintf(buf, ".word   0x%08x", code);
+}
+
+#undef RS
+#undef RT
+#undef RD
+
+///////////////////////////////////////////////////////////////////////////////
+// Checker
+///////////////////////////////////////////////////////////////////////////////
+
+// Recompiler blocks can be shorter than psxInt's, but never longer
+#define LOCKSTEP_MAX_BLOCKS 1024
+
+static psxRegisters regs_before, regs_int;
+static u32 num_checked, num_unchecked;
+
+static void lockstep_print_regs(const psxRegisters *regs)
+{
+	for (int i = 0; i < 34; ++i)
+		printf("%s%-2s %08x", (i & 7) ? "  " : "\n  ", gpr_names[i], regs->GPR.r[i]);
+	printf("\n");
+}
+
+static void lockstep_report(int ops)
+{
+	char buf[64];
+
+	printf("\nLockstep: recompiler and interpreter differ after block %08x "
+	       "(%d ops, %u blocks checked before it):\n", regs_before.pc, ops, num_checked);
+
+	for (int i = 0; i < ops; ++i) {
+		const u32 pc = regs_before.pc + i*4;
+		const u32 *p = (u32 *)PSXM(pc);
+		const u32 code = (p == NULL) ? 0 : SWAP32(*p);
+		disasm(buf, code, pc);
+		printf("  %08x: %08x  %s\n", pc, code, buf);
+	}
+
+	printf("\n                 rec       int\n");
+	if (psxRegs.pc != regs_int.pc)
+		printf("  pc        %08x  %08x\n", psxRegs.pc, regs_int.pc);
+	for (int i = 0; i < 34; ++i)
+		if (psxRegs.GPR.r[i] != regs_int.GPR.r[i])
+			printf("  %-8s  %08x  %08x\n", gpr_names[i], psxRegs.GPR.r[i], regs_int.GPR.r[i]);
+	for (int i = 0; i < 32; ++i)
+		if (psxRegs.CP0.r[i] != regs_int.CP0.r[i])
+			printf("  cop0 $%-2d  %08x  %08x\n", i, psxRegs.CP0.r[i], regs_int.CP0.r[i]);
+	for (int i = 0; i < 32; ++i)
+		if (psxRegs.CP2D.r[i] != regs_int.CP2D.r[i])
+			printf("  gte d%-2d   %08x  %08x\n", i, psxRegs.CP2D.r[i], regs_int.CP2D.r[i]);
+	for (int i = 0; i < 32; ++i)
+		if (psxRegs.CP2C.r[i] != regs_int.CP2C.r[i])
+			printf("  gte c%-2d   %08x  %08x\n", i, psxRegs.CP2C.r[i], regs_int.CP2C.r[i]);
+	for (int i = 0; i < num_writes; ++i) {
+		const lockstep_write *w = &writes[i];
+		u32 rec_val = 0;
+		memcpy(&rec_val, w->ptr, w->size);
+		if (rec_val != w->new_val)
+			printf("  mem %08x  %0*x  %0*x  (%u bytes)\n", w->addr, w->size*2, rec_val,
+			       w->size*2, w->new_val, w->size);
+	}
+
+	printf("\nRegisters before the block:");
+	lockstep_print_regs(&regs_before);
+}
+
+static bool lockstep_compare(void)
+{
+	if (psxRegs.pc != regs_int.pc ||
+	    memcmp(&psxRegs.GPR, &regs_int.GPR, sizeof(psxRegs.GPR)) ||
+	    memcmp(&psxRegs.CP0, &regs_int.CP0, sizeof(psxRegs.CP0)) ||
+	    memcmp(&psxRegs.CP2D, &regs_int.CP2D, sizeof(psxRegs.CP2D)) ||
+	    memcmp(&psxRegs.CP2C, &regs_int.CP2C, sizeof(psxRegs.CP2C)))
+		return false;
+
+	for (int i = 0; i < num_writes; ++i)
+		if (memcmp(writes[i].ptr, &writes[i].new_val, writes[i].size))
+			return false;
+
+	return true;
+}
+
+static void lockstep_step(void)
+{
+	regs_before = psxRegs;
+	psxLockstepInBlock = true;
+
+	// Shadow run on psxInt
+	num_writes = 0;
+	psxLockstepShadowFailed = false;
+	psxLockstepShadow = true;
+	const int ops = psxIntExecuteShadowBlock();
+	psxLockstepShadow = false;
+
+	// Keep the results, then undo psxInt's writes, newest first
+	for (int i = 0; i < num_writes; ++i) {
+		writes[i].new_val = 0;
+		memcpy(&writes[i].new_val, writes[i].ptr, writes[i].size);
+	}
+	for (int i = num_writes-1; i >= 0; --i)
+		memcpy(writes[i].ptr, &writes[i].old_val, writes[i].size);
+	regs_int = psxRegs;
+	psxRegs = regs_before;
+
+	if (ops == 0) {
+		// Unchecked, run it as usual. This also lets HLE BIOS calls
+		//  re-enter lockstepExecuteBlock().
+		psxLockstepInBlock = false;
+		psxRec.ExecuteSingleBlock();
+		num_unchecked++;
+	} else {
+		// When psxInt's block ended with a branch not taken, the recompiler
+		//  may leave its BD slot to the next block (branch run through an
+		//  interpreter handler). Run just that op, on psxInt.
+		const u32 bd_pc = regs_before.pc + (ops-1)*4;
+		const bool not_taken = (regs_int.pc == bd_pc + 4);
+
+		int blocks = 0;
+		do {
+			psxRec.ExecuteSingleBlock();
+		} while (psxRegs.pc != regs_int.pc && !(not_taken && psxRegs.pc == bd_pc) &&
+		         ++blocks < LOCKSTEP_MAX_BLOCKS);
+		if (psxRegs.pc != regs_int.pc && not_taken && psxRegs.pc == bd_pc)
+			execI();
+		psxLockstepInBlock = false;
+
+		if (!lockstep_compare()) {
+			lockstep_report(ops);
+			exit(1);
+		}
+		num_checked++;
+	}
+
+	if (psxRegs.cycle >= psxRegs.io_cycle_counter)
+		psxBranchTest();
+}
+
+static int lockstepInit(void)
+{
+	printf("Lockstep checker enabled, comparing recompiler with interpreter.\n");
+	return psxRec.Init();
+}
+
+static void lockstepReset(void)
+{
+	psxRec.Reset();
+	num_checked = num_unchecked = 0;
+}
+
+static void lockstepExecute(void)
+{
+	for (;;)
+		lockstep_step();
+}
+
+static void lockstepExecuteBlock(unsigned target_pc)
+{
+	do {
+		lockstep_step();
+	} while (psxRegs.pc != target_pc);
+}
+
+static void lockstepClear(u32 Addr, u32 Size)
+{
+	psxRec.Clear(Addr, Size);
+}
+
+static void lockstepNotify(int note, void *data)
+{
+	psxRec.Notify(note, data);
+}
+
+static void lockstepShutdown(void)
+{
+	printf("Lockstep: %u blocks checked, %u run unchecked.\n", num_checked, num_unchecked);
+	psxRec.Shutdown();
+}
+
+R3000Acpu psxLockstep = {
+	lockstepInit,
+	lockstepReset,
+	lockstepExecute,
+	lockstepExecuteBlock,
+	lockstepClear,
+	lockstepNotify,
+	lockstepShutdown
+};
+
+#endif // PSXREC
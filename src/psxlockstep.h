@@ -0,0 +1,52 @@
+/***************************************************************************
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ *                                                                         *
+ *   This program is distributed in the hope that it will be useful,       *
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *   GNU General Public License for more details.                          *
+ *                                                                         *
+ *   You should have received a copy of the GNU General Public License     *
+ *   along with this program; if not, write to the                         *
+ *   Free Software Foundation, Inc.,                                       *
+ *   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+ ***************************************************************************/
+
+/*
+ * Lockstep checker: runs each block on both psxInt and the recompiler and
+ *  stops at the first difference (for development purposes).
+ */
+
+#ifndef PSXLOCKSTEP_H
+#define PSXLOCKSTEP_H
+
+#include "r3000a.h"
+
+// Set while the checker is running a block on either CPU core:
+//  psxBranchTest() is deferred until both results have been compared.
+extern bool psxLockstepInBlock;
+
+// Set while psxInt replays a block: memory writes are logged so they can
+//  be undone, and HW I/O is refused (see psxLockstepShadowHw()).
+extern bool psxLockstepShadow;
+
+// Set by psxLockstepShadowHw() or when the write log is full
+extern bool psxLockstepShadowFailed;
+
+// Called by psxMemWrite*() before writing 'size' bytes at host address 'ptr'
+void psxLockstepShadowWrite(u32 addr, void *ptr, u32 size);
+
+// Called by psxMem*() instead of accessing HW I/O during a replay. The
+//  block is then run on the recompiler alone, unchecked.
+void psxLockstepShadowHw(u32 addr);
+
+void psxLockstepEnable(void);
+bool psxLockstepEnabled(void);
+
+// Wraps psxRec, if the recompiler supports ExecuteSingleBlock()
+extern R3000Acpu psxLockstep;
+
+#endif /* PSXLOCKSTEP_H */
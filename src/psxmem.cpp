@@ -28,8 +28,12 @@
 #include "psxmem.h"
 #include "r3000a.h"
 #include "psxhw.h"
+#include "psxlockstep.h"
 
-/* Uncomment for memory statistics (for development purposes) */
+/* Uncomment to enable memory statistics from startup, sampling every access
+ *  (for development purposes). They can also be enabled at runtime, see
+ *  psxMemStatsEnable().
+ */
 //#define DEBUG_MEM_STATS
 
 /* Uncomment for debug logging to console */
@@ -44,17 +48,43 @@ enum MemstatWidth  { MEMSTAT_WIDTH_8, MEMSTAT_WIDTH_16, MEMSTAT_WIDTH_32, MEMSTA
 enum MemstatRegion { MEMSTAT_REGION_ANY, MEMSTAT_REGION_RAM, MEMSTAT_REGION_BLOCKED,
                      MEMSTAT_REGION_PPORT, MEMSTAT_REGION_SCRATCHPAD, MEMSTAT_REGION_HW,
                      MEMSTAT_REGION_ROM, MEMSTAT_REGION_CACHE, MEMSTAT_REGION_COUNT };
-#ifdef DEBUG_MEM_STATS
 static void memstats_reset();
 static void memstats_print();
-static void memstats_add_read(u32 addr, MemstatWidth width);
-static void memstats_add_write(u32 addr, MemstatWidth width);
-#else
-static inline void memstats_reset() {}
-static inline void memstats_print() {}
-static inline void memstats_add_read(u32 addr, MemstatWidth width) {}
-static inline void memstats_add_write(u32 addr, MemstatWidth width) {}
-#endif // DEBUG_MEM_STATS
+static void memstats_sample(MemstatType type, u32 addr, MemstatWidth width);
+
+// Every Nth access is sampled, counting down to 0. When stats are disabled,
+//  countdown stays at 0 and the hooks cost one load and branch.
+static u32 memstats_interval;
+static u32 memstats_countdown;
+
+static inline void memstats_add_read(u32 addr, MemstatWidth width)
+{
+	if (__builtin_expect(memstats_countdown != 0, 0) && --memstats_countdown == 0)
+		memstats_sample(MEMSTAT_TYPE_READ, addr, width);
+}
+
+static inline void memstats_add_write(u32 addr, MemstatWidth width)
+{
+	if (__builtin_expect(memstats_countdown != 0, 0) && --memstats_countdown == 0)
+		memstats_sample(MEMSTAT_TYPE_WRITE, addr, width);
+}
+
+// Lockstep checker replaying a block on psxInt, see psxlockstep.cpp. When
+//  the checker isn't running, these cost one load and branch.
+static inline bool lockstep_shadow_hw(u32 addr)
+{
+	if (__builtin_expect(psxLockstepShadow, 0)) {
+		psxLockstepShadowHw(addr);
+		return true;
+	}
+	return false;
+}
+
+static inline void lockstep_shadow_write(u32 addr, void *ptr, u32 size)
+{
+	if (__builtin_expect(psxLockstepShadow, 0))
+		psxLockstepShadowWrite(addr, ptr, size);
+}
 
 s8 *psxM;
 s8 *psxP;
@@ -112,6 +142,11 @@ int psxMemInit()
 	// Allocate 512KB for PSX ROM 0xbfc0_0000 region
 	if (!psxR_allocated) { psxR = (s8*)malloc(0x80000);   psxR_allocated = psxR != NULL; }
 
+#ifdef DEBUG_MEM_STATS
+	if (memstats_interval == 0)
+		psxMemStatsEnable(1, NULL);
+#endif
+
 	if (psxMemRLUT == NULL || psxMemWLUT == NULL || psxNULLread == NULL ||
 	    !psxM_allocated || !psxP_allocated || !psxR_allocated || !psxH_allocated)
 	{
@@ -232,6 +267,8 @@ u8 psxMemRead8(u32 mem)
 	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
 		if (m < 0x400)
 			ret = psxHu8(mem);
+		else if (lockstep_shadow_hw(mem))
+			ret = 0;
 		else
 			ret = psxHwRead8(mem);
 	} else {
@@ -256,6 +293,8 @@ u16 psxMemRead16(u32 mem)
 	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
 		if (m < 0x400)
 			ret = psxHu16(mem);
+		else if (lockstep_shadow_hw(mem))
+			ret = 0;
 		else
 			ret = psxHwRead16(mem);
 	} else {
@@ -280,6 +319,8 @@ u32 psxMemRead32(u32 mem)
 	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
 		if (m < 0x400)
 			ret = psxHu32(mem);
+		else if (lockstep_shadow_hw(mem))
+			ret = 0;
 		else
 			ret = psxHwRead32(mem);
 	} else {
@@ -301,17 +342,17 @@ void psxMemWrite8(u32 mem, u8 value)
 	u32 t = mem >> 16;
 	u32 m = mem & 0xffff;
 	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
+		if (m < 0x400) {
+			lockstep_shadow_write(mem, &psxHu8ref(mem), 1);
 			psxHu8(mem) = value;
-		else
+		} else if (!lockstep_shadow_hw(mem))
 			psxHwWrite8(mem, value);
 	} else {
 		u8 *p = (u8*)(psxMemWLUT[t]);
 		if (p != NULL) {
+			lockstep_shadow_write(mem, p + m, 1);
 			*(u8*)(p + m) = value;
-#ifdef PSXREC
-			psxCpu->Clear((mem & (~3)), 1);
-#endif
+			psxCpuClear((mem & (~3)), 1);
 		} else {
 			PSXMEM_LOG("%s(): err sb 0x%08x\n", __func__, mem);
 		}
@@ -324,17 +365,17 @@ void psxMemWrite16(u32 mem, u16 value)
 	u32 t = mem >> 16;
 	u32 m = mem & 0xffff;
 	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
+		if (m < 0x400) {
+			lockstep_shadow_write(mem, &psxHu16ref(mem), 2);
 			psxHu16ref(mem) = SWAPu16(value);
-		else
+		} else if (!lockstep_shadow_hw(mem))
 			psxHwWrite16(mem, value);
 	} else {
 		u8 *p = (u8*)(psxMemWLUT[t]);
 		if (p != NULL) {
+			lockstep_shadow_write(mem, p + m, 2);
 			*(u16*)(p + m) = SWAPu16(value);
-#ifdef PSXREC
-			psxCpu->Clear((mem & (~3)), 1);
-#endif
+			psxCpuClear((mem & (~3)), 1);
 		} else {
 			PSXMEM_LOG("%s(): err sh 0x%08x\n", __func__, mem);
 		}
@@ -347,24 +388,22 @@ void psxMemWrite32(u32 mem, u32 value)
 	u32 t = mem >> 16;
 	u32 m = mem & 0xffff;
 	if (t == 0x1f80 || t == 0x9f80 || t == 0xbf80) {
-		if (m < 0x400)
+		if (m < 0x400) {
+			lockstep_shadow_write(mem, &psxHu32ref(mem), 4);
 			psxHu32ref(mem) = SWAPu32(value);
-		else
+		} else if (!lockstep_shadow_hw(mem))
 			psxHwWrite32(mem, value);
 	} else {
 		u8 *p = (u8*)(psxMemWLUT[t]);
 		if (p != NULL) {
+			lockstep_shadow_write(mem, p + m, 4);
 			*(u32*)(p + m) = SWAPu32(value);
-#ifdef PSXREC
-			psxCpu->Clear(mem, 1);
-#endif
+			psxCpuClear(mem, 1);
 		} else {
 			if (mem != 0xfffe0130) {
-#ifdef PSXREC
-				if (!psxRegs.writeok) psxCpu->Clear(mem, 1);
-#endif
+				if (!psxRegs.writeok) psxCpuClear(mem, 1);
 				if (psxRegs.writeok) { PSXMEM_LOG("%s(): err sw 0x%08x\n", __func__, mem); }
-			} else {
+			} else if (!lockstep_shadow_hw(mem)) {
 				// Write to cache control port 0xfffe0130
 				psxMemWrite32_CacheCtrlPort(value);
 			}
@@ -548,15 +587,60 @@ void psxMemWrite32_direct(u32 mem, u32 value,void *_regs) {
 }
 
 
-#ifdef DEBUG_MEM_STATS
 ///////////////////////////////////////////////////////////////////////////////
 // -BEGIN- Memory statistics (for development purposes)
+//
+// Accesses made through psxMemRead*()/psxMemWrite*() are sampled every Nth
+// time, and counted per region, per HW I/O register and per PC. Counts shown
+// are estimates: samples multiplied by the sampling interval.
+// NOTE: Recompiled code accesses RAM, scratchpad and most HW I/O directly,
+//  so under the dynarec, stats only reflect its slow-path C accesses (which
+//  is what's useful when deciding on new dynarec fast paths).
+// NOTE: PCs are exact under the interpreter. Under the dynarec, they are the
+//  PC at the start of the block doing the access.
 ///////////////////////////////////////////////////////////////////////////////
-long long unsigned int memstats[MEMSTAT_TYPE_COUNT][MEMSTAT_REGION_COUNT][MEMSTAT_WIDTH_COUNT];
+#define MEMSTAT_HW_REGS   0x2000  // HW I/O spans 0x1f80_1000..0x1f80_2fff
+#define MEMSTAT_PC_SLOTS  4096    // Hash table size, must be power of two
+
+typedef struct {
+	u32 pc;
+	u32 count[MEMSTAT_TYPE_COUNT];
+} MemstatPC;
+
+static u64 memstats[MEMSTAT_TYPE_COUNT][MEMSTAT_REGION_COUNT][MEMSTAT_WIDTH_COUNT];
+static u32 memstats_hw[MEMSTAT_TYPE_COUNT][MEMSTAT_HW_REGS];
+static MemstatPC memstats_pc[MEMSTAT_PC_SLOTS];
+static u32 memstats_pc_used;
+static u64 memstats_pc_dropped[MEMSTAT_TYPE_COUNT];  // Samples lost to full table
+static const char *memstats_csv_file;
+
+// Sample every 'sample_interval'th access, 0 disables sampling (collected
+//  stats are kept). If 'csv_file' is non-NULL, stats are written to it
+//  at shutdown.
+void psxMemStatsEnable(u32 sample_interval, const char *csv_file)
+{
+	memstats_interval = memstats_countdown = sample_interval;
+	if (csv_file)
+		memstats_csv_file = csv_file;
+}
 
 static void memstats_reset()
 {
 	memset((void*)memstats, 0, sizeof(memstats));
+	memset((void*)memstats_hw, 0, sizeof(memstats_hw));
+	memset((void*)memstats_pc, 0, sizeof(memstats_pc));
+	memset((void*)memstats_pc_dropped, 0, sizeof(memstats_pc_dropped));
+	memstats_pc_used = 0;
+}
+
+void psxMemStatsReset()
+{
+	memstats_reset();
+}
+
+static inline u64 memstats_estimate(u64 samples)
+{
+	return samples * memstats_interval;
 }
 
 static void memstats_region_print(const char *region_description, MemstatRegion region)
@@ -572,17 +656,21 @@ static void memstats_region_print(const char *region_description, MemstatRegion
 	       "  reads:%23llu %23llu %23llu\n"
 	       " writes:%23llu %23llu %23llu\n",
 	       separator_line,
-	       memstats[MEMSTAT_TYPE_READ][region][MEMSTAT_WIDTH_8],
-	       memstats[MEMSTAT_TYPE_READ][region][MEMSTAT_WIDTH_16],
-	       memstats[MEMSTAT_TYPE_READ][region][MEMSTAT_WIDTH_32],
-	       memstats[MEMSTAT_TYPE_WRITE][region][MEMSTAT_WIDTH_8],
-	       memstats[MEMSTAT_TYPE_WRITE][region][MEMSTAT_WIDTH_16],
-	       memstats[MEMSTAT_TYPE_WRITE][region][MEMSTAT_WIDTH_32]);
+	       (unsigned long long)memstats_estimate(memstats[MEMSTAT_TYPE_READ][region][MEMSTAT_WIDTH_8]),
+	       (unsigned long long)memstats_estimate(memstats[MEMSTAT_TYPE_READ][region][MEMSTAT_WIDTH_16]),
+	       (unsigned long long)memstats_estimate(memstats[MEMSTAT_TYPE_READ][region][MEMSTAT_WIDTH_32]),
+	       (unsigned long long)memstats_estimate(memstats[MEMSTAT_TYPE_WRITE][region][MEMSTAT_WIDTH_8]),
+	       (unsigned long long)memstats_estimate(memstats[MEMSTAT_TYPE_WRITE][region][MEMSTAT_WIDTH_16]),
+	       (unsigned long long)memstats_estimate(memstats[MEMSTAT_TYPE_WRITE][region][MEMSTAT_WIDTH_32]));
 }
 
 static void memstats_print()
 {
-	printf("MEMORY STATS:              byte                   short                    word\n");
+	if (memstats_interval == 0)
+		return;
+
+	printf("MEMORY STATS (sampling 1 in %u accesses)\n", memstats_interval);
+	printf("                           byte                   short                    word\n");
 	memstats_region_print("BLOCKED RAM (ISOLATED CACHE)", MEMSTAT_REGION_BLOCKED);
 	memstats_region_print("PPORT (ROM EXPANSION)",        MEMSTAT_REGION_PPORT);
 	memstats_region_print("ROM",                          MEMSTAT_REGION_ROM);
@@ -591,55 +679,117 @@ static void memstats_print()
 	memstats_region_print("SCRATCHPAD",                   MEMSTAT_REGION_SCRATCHPAD);
 	memstats_region_print("HW I/O",                       MEMSTAT_REGION_HW);
 	memstats_region_print("TOTAL",                        MEMSTAT_REGION_ANY);
+
+	if (memstats_csv_file)
+		psxMemStatsWriteCSV(memstats_csv_file);
 }
 
-static inline void memstats_add_read(u32 addr, MemstatWidth width)
+// Write stats as CSV with columns: section,key,reads,writes
+//  Sections are 'region', 'hwreg' (key is address) and 'pc' (key is PC).
+int psxMemStatsWriteCSV(const char *filename)
 {
-	MemstatRegion region;
-	addr &= 0xfffffff;
-	switch (addr >> 16) {
-		case 0x0000 ... 0x007f:
-			region = MEMSTAT_REGION_RAM;
-			break;
-		case 0x0f00 ... 0x0f7f:
-			region = MEMSTAT_REGION_PPORT;
-			break;
-		case 0x0f80:
-			if ((addr & 0xffff) < 0x0400)
-				region = MEMSTAT_REGION_SCRATCHPAD;
-			else
-				region = MEMSTAT_REGION_HW;
-			break;
-		case 0x0ffe:
-			region = MEMSTAT_REGION_CACHE;
-			break;
-		default:
-			region = MEMSTAT_REGION_ROM;
-			break;
+	static const char * const region_names[MEMSTAT_REGION_COUNT] = {
+		"TOTAL", "RAM", "BLOCKED", "PPORT", "SCRATCHPAD", "HW", "ROM", "CACHE"
+	};
+
+	FILE *f = fopen(filename, "w");
+	if (!f) {
+		printf("Error: could not open memory stats file %s for writing\n", filename);
+		return -1;
+	}
+
+	fprintf(f, "# sample_interval=%u\n", memstats_interval);
+	fprintf(f, "section,key,reads,writes\n");
+
+	for (int r = 0; r < MEMSTAT_REGION_COUNT; ++r) {
+		u64 cnt[MEMSTAT_TYPE_COUNT] = { 0, 0 };
+		for (int t = 0; t < MEMSTAT_TYPE_COUNT; ++t)
+			for (int w = 0; w < MEMSTAT_WIDTH_COUNT; ++w)
+				cnt[t] += memstats[t][r][w];
+		fprintf(f, "region,%s,%llu,%llu\n", region_names[r],
+		        (unsigned long long)memstats_estimate(cnt[MEMSTAT_TYPE_READ]),
+		        (unsigned long long)memstats_estimate(cnt[MEMSTAT_TYPE_WRITE]));
+	}
+
+	for (int i = 0; i < MEMSTAT_HW_REGS; ++i) {
+		if (memstats_hw[MEMSTAT_TYPE_READ][i] || memstats_hw[MEMSTAT_TYPE_WRITE][i]) {
+			fprintf(f, "hwreg,%08x,%llu,%llu\n", 0x1f801000 + i,
+			        (unsigned long long)memstats_estimate(memstats_hw[MEMSTAT_TYPE_READ][i]),
+			        (unsigned long long)memstats_estimate(memstats_hw[MEMSTAT_TYPE_WRITE][i]));
+		}
 	}
-	memstats[MEMSTAT_TYPE_READ][region][width]++;
-	memstats[MEMSTAT_TYPE_READ][MEMSTAT_REGION_ANY][width]++;
+
+	for (int i = 0; i < MEMSTAT_PC_SLOTS; ++i) {
+		const MemstatPC *p = &memstats_pc[i];
+		if (p->count[MEMSTAT_TYPE_READ] || p->count[MEMSTAT_TYPE_WRITE]) {
+			fprintf(f, "pc,%08x,%llu,%llu\n", p->pc,
+			        (unsigned long long)memstats_estimate(p->count[MEMSTAT_TYPE_READ]),
+			        (unsigned long long)memstats_estimate(p->count[MEMSTAT_TYPE_WRITE]));
+		}
+	}
+
+	if (memstats_pc_dropped[MEMSTAT_TYPE_READ] || memstats_pc_dropped[MEMSTAT_TYPE_WRITE]) {
+		fprintf(f, "pc,other,%llu,%llu\n",
+		        (unsigned long long)memstats_estimate(memstats_pc_dropped[MEMSTAT_TYPE_READ]),
+		        (unsigned long long)memstats_estimate(memstats_pc_dropped[MEMSTAT_TYPE_WRITE]));
+	}
+
+	fclose(f);
+	printf("Wrote memory stats to %s\n", filename);
+	return 0;
 }
 
-static inline void memstats_add_write(u32 addr, MemstatWidth width)
+static void memstats_add_pc(MemstatType type, u32 pc)
 {
+	u32 idx = (pc >> 2) * 2654435761u;  // Knuth multiplicative hash
+	idx = (idx >> 20) & (MEMSTAT_PC_SLOTS-1);
+
+	// Linear probing. Keep table at most 3/4 full so probes stay short.
+	for (;;) {
+		MemstatPC *p = &memstats_pc[idx];
+		if (p->pc == pc && (p->count[0] || p->count[1])) {
+			p->count[type]++;
+			return;
+		}
+		if (!p->count[0] && !p->count[1]) {
+			if (memstats_pc_used >= (MEMSTAT_PC_SLOTS/4)*3)
+				break;
+			memstats_pc_used++;
+			p->pc = pc;
+			p->count[type] = 1;
+			return;
+		}
+		idx = (idx + 1) & (MEMSTAT_PC_SLOTS-1);
+	}
+
+	memstats_pc_dropped[type]++;
+}
+
+static void memstats_sample(MemstatType type, u32 addr, MemstatWidth width)
+{
+	memstats_countdown = memstats_interval;
+
 	MemstatRegion region;
 	addr &= 0xfffffff;
 	switch (addr >> 16) {
 		case 0x0000 ... 0x007f:
-			if (psxRegs.writeok)
-				region = MEMSTAT_REGION_RAM;
-			else
+			if (type == MEMSTAT_TYPE_WRITE && !psxRegs.writeok)
 				region = MEMSTAT_REGION_BLOCKED;
+			else
+				region = MEMSTAT_REGION_RAM;
 			break;
 		case 0x0f00 ... 0x0f7f:
 			region = MEMSTAT_REGION_PPORT;
 			break;
 		case 0x0f80:
-			if ((addr & 0xffff) < 0x0400)
+			if ((addr & 0xffff) < 0x0400) {
 				region = MEMSTAT_REGION_SCRATCHPAD;
-			else
+			} else {
 				region = MEMSTAT_REGION_HW;
+				u32 hw_idx = (addr & 0xffff) - 0x1000;
+				if (hw_idx < MEMSTAT_HW_REGS)
+					memstats_hw[type][hw_idx]++;
+			}
 			break;
 		case 0x0ffe:
 			region = MEMSTAT_REGION_CACHE;
@@ -648,10 +798,15 @@ static inline void memstats_add_write(u32 addr, MemstatWidth width)
 			region = MEMSTAT_REGION_ROM;
 			break;
 	}
-	memstats[MEMSTAT_TYPE_WRITE][region][width]++;
-	memstats[MEMSTAT_TYPE_WRITE][MEMSTAT_REGION_ANY][width]++;
+	memstats[type][region][width]++;
+	memstats[type][MEMSTAT_REGION_ANY][width]++;
+
+	// Interpreters have already advanced psxRegs.pc past the instruction
+	u32 pc = psxRegs.pc;
+	if (Config.Cpu != CPU_DYNAREC)
+		pc -= 4;
+	memstats_add_pc(type, pc);
 }
 ///////////////////////////////////////////////////////////////////////////////
 // -END- Memory statistics (for development purposes)
 ///////////////////////////////////////////////////////////////////////////////
-#endif // DEBUG_MEM_STATS
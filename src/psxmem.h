@@ -140,6 +140,11 @@ void psxMemWrite32(u32 mem, u32 value);
 
 void psxMemWrite32_CacheCtrlPort(u32 value);
 
+// Sampled memory access statistics (for development purposes), see psxmem.cpp
+void psxMemStatsEnable(u32 sample_interval, const char *csv_file);
+void psxMemStatsReset(void);
+int  psxMemStatsWriteCSV(const char *filename);
+
 u8   psxMemRead8_direct(u32 mem,void *regs);
 u16  psxMemRead16_direct(u32 mem,void *regs);
 u32  psxMemRead32_direct(u32 mem,void *regs);
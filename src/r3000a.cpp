@@ -31,6 +31,7 @@
 #include "mdec.h"
 #include "gte.h"
 #include "psxevents.h"
+#include "psxlockstep.h"
 
 PcsxConfig Config;
 R3000Acpu *psxCpu=NULL;
@@ -43,11 +44,23 @@ int psxInit() {
 	#ifndef interpreter_none
 	if (Config.Cpu == CPU_INTERPRETER) {
 		psxCpu = &psxInt;
+	} else if (Config.Cpu == CPU_CACHED_INTERPRETER) {
+		psxCpu = &psxIntCached;
 	} else
 	#endif
 	psxCpu = &psxRec;
+
+	if (psxLockstepEnabled()) {
+		if (psxCpu == &psxRec && psxRec.ExecuteSingleBlock)
+			psxCpu = &psxLockstep;
+		else
+			printf("Lockstep checker needs a recompiler that supports it, disabled.\n");
+	}
 #else
-	psxCpu = &psxInt;
+	if (Config.Cpu == CPU_CACHED_INTERPRETER)
+		psxCpu = &psxIntCached;
+	else
+		psxCpu = &psxInt;
 #endif
 
 	// Initialize CPU *before* calling psxMemInit(), so it can make any
@@ -92,6 +105,7 @@ void psxShutdown() {
 
 	psxMemShutdown();
 	psxBiosShutdown();
+	psxEvqueueShutdown();
 
 }
 
@@ -128,6 +142,10 @@ void psxException(u32 code, u32 bd) {
 
 void psxBranchTest()
 {
+	// Lockstep checker calls us itself once both cores ran the block
+	if (psxLockstepInBlock)
+		return;
+
 	//senquack - Do not rearrange the math here! Events' sCycle val can end up
 	// negative (very large unsigned int) when a PSXINT_RESET_CYCLE_VAL event
 	// resets psxRegs.cycle to 0 and subtracts the previous psxRegs.cycle value
@@ -160,6 +178,22 @@ void psxBranchTest()
 	}
 }
 
+/* Called by CPU cores when psxTestIdleLoop() found the CPU spinning in a
+ *  loop that can't exit before the next event: fast-forward to that event.
+ */
+void psxIdleLoopSkip()
+{
+	// A pending IRQ will be taken by psxBranchTest() right away
+	if ((psxHu32(0x1070) & psxHu32(0x1074)) &&
+	    (psxRegs.CP0.n.Status & 0x401) == 0x401)
+		return;
+
+	u32 next_event = psxRegs.intCycle[PSXINT_NEXT_EVENT].sCycle +
+	                 psxRegs.intCycle[PSXINT_NEXT_EVENT].cycle;
+	if ((s32)(next_event - psxRegs.cycle) > 0)
+		psxRegs.cycle = next_event;
+}
+
 void psxExecuteBios() {
 	while (psxRegs.pc != 0x80030000)
 		psxCpu->ExecuteBlock(0x80030000);
@@ -38,17 +38,29 @@ typedef struct {
 	void (*Reset)(void);
 	void (*Execute)(void);
 	void (*ExecuteBlock)(unsigned target_pc);
+	// Invalidates any code cached from 'Size' words at 'Addr'. NULL for
+	//  cores that cache none, call through psxCpuClear().
 	void (*Clear)(u32 Addr, u32 Size);
 	void (*Notify)(int note, void *data);
 	void (*Shutdown)(void);
+	// Runs the one block at psxRegs.pc and returns, without calling
+	//  psxBranchTest(). Optional, used by the lockstep checker.
+	void (*ExecuteSingleBlock)(void);
 } R3000Acpu;
 
 extern R3000Acpu *psxCpu;
 extern R3000Acpu psxInt;
+extern R3000Acpu psxIntCached;
 #ifdef PSXREC
 extern R3000Acpu psxRec;
 #endif
 
+static inline void psxCpuClear(u32 Addr, u32 Size)
+{
+	if (psxCpu->Clear)
+		psxCpu->Clear(Addr, Size);
+}
+
 typedef union {
 #if defined(__BIGENDIAN__)
 	struct { u8 h3, h2, h, l; } b;
@@ -260,6 +272,9 @@ void psxBranchTest(void);
 void psxExecuteBios(void);
 int  psxTestLoadDelay(int reg, u32 tmp);
 void psxDelayTest(int reg, u32 bpc);
+u32  psxTestIdleLoop(u32 loop_pc, bool check_addresses);
+void psxIdleLoopSkip(void);
+int  psxIntExecuteShadowBlock(void);
 void psxTestSWInts(void);
 
 #endif /* __R3000A_H__ */
@@ -197,8 +197,10 @@ u64 opcodeGetReads(const u32 op)
 			switch (_fRs_(op))
 			{
 				case 0x0: /* Coprocessor 0 opcode 0x0: MFC0 */
+				case 0x2: /* Coprocessor 0 opcode 0x2: CFC0 */
 					return 0;
 				case 0x4: /* Coprocessor 0 opcode 0x4: MTC0 */
+				case 0x6: /* Coprocessor 0 opcode 0x6: CTC0 */
 					return BIT(_fRt_(op));
 				case 0x10: /* Coprocessor 0 opcode 0x10: RFE */
 					return 0;
@@ -240,6 +242,9 @@ u64 opcodeGetReads(const u32 op)
 			return BIT(_fRs_(op));
 		case 0x3a: /* Major opcode 0x32: SWC2 (GTE) */
 			return BIT(_fRs_(op));
+		case 0x3b: /* Major opcode 0x3b: HLE */
+			/* HLE BIOS call can read any register */
+			return ~(u64)0;
 	}
 
 	printf("Unknown opcode in %s(): %08x\n", __func__, op);
@@ -333,8 +338,10 @@ u64 opcodeGetWrites(const u32 op)
 			switch (_fRs_(op))
 			{
 				case 0x0: /* Coprocessor 0 opcode 0x0: MFC0 */
+				case 0x2: /* Coprocessor 0 opcode 0x2: CFC0 */
 					return BIT(_fRt_(op)) & ~BIT(0);
 				case 0x4: /* Coprocessor 0 opcode 0x4: MTC0 */
+				case 0x6: /* Coprocessor 0 opcode 0x6: CTC0 */
 					return 0;
 				case 0x10: /* Coprocessor 0 opcode 0x10: RFE */
 					return 0;
@@ -370,6 +377,9 @@ u64 opcodeGetWrites(const u32 op)
 		case 0x32: /* Major opcode 0x32: LWC2 (GTE) */
 		case 0x3a: /* Major opcode 0x32: SWC2 (GTE) */
 			return 0;
+		case 0x3b: /* Major opcode 0x3b: HLE */
+			/* HLE BIOS call can write any register */
+			return ~(u64)0;
 	}
 
 	printf("Unknown opcode in %s(): %08x\n", __func__, op);
@@ -217,6 +217,9 @@ do { \
 #define SW(rd, rs, imm16) \
 	write32(0xac000000 | ((rs) << 21) | ((rd) << 16) | ((imm16) & 0xffff))
 
+#define SH(rd, rs, imm16) \
+	write32(0xa4000000 | ((rs) << 21) | ((rd) << 16) | ((imm16) & 0xffff))
+
 #define LWL(rt, rs, imm16) \
 	write32(0x88000000 | ((rs) << 21) | ((rt) << 16) | ((imm16) & 0xffff))
 
@@ -337,6 +340,15 @@ do { \
 #define MFHI(rd) \
 	write32(0x00000010 | ((rd) << 11))
 
+#define MTLO(rs) \
+	write32(0x00000013 | ((rs) << 21))
+
+#define MTHI(rs) \
+	write32(0x00000011 | ((rs) << 21))
+
+#define MADD(rs, rt) \
+	write32(0x70000000 | ((rs) << 21) | ((rt) << 16))
+
 #define SLT(rd, rs, rt) \
 	write32(0x0000002a | ((rs) << 21) | ((rt) << 16) | ((rd) << 11))
 
@@ -458,6 +470,8 @@ do {                                                                           \
 #define rec_recompile_end_part2(use_fastpath_return)                           \
 do {                                                                           \
     const u32 cycles = ADJUST_CLOCK((pc-oldpc)/4);                             \
+    if (use_fastpath_return)                                                   \
+        block_has_fastpath_return = true;                                      \
     if (cycles <= 0xffff) {                                                    \
         if (block_ret_addr) {                                                  \
             if (use_fastpath_return)                                           \
@@ -482,6 +496,18 @@ do {                                                                           \
     }                                                                          \
 } while (0)
 
+/* Same as rec_recompile_end_part2(), but for block exits whose new PC is the
+ *  known-const 'target_pc'. When possible, emits an exit that can later be
+ *  linked directly to the target block (see rec_emit_linkable_exit()).
+ *  Idle loop blocks first call C code to skip ahead to the next event.
+ */
+#define rec_recompile_end_part2_const(use_fastpath_return, target_pc)          \
+do {                                                                           \
+    rec_emit_idle_loop_skip(target_pc);                                        \
+    if ((use_fastpath_return) || !rec_emit_linkable_exit(target_pc))           \
+        rec_recompile_end_part2(use_fastpath_return);                          \
+} while (0)
+
 #define mips_relative_offset(source, offset, next) \
 	((((u32)(offset) - ((u32)(source) + (next))) >> 2) & 0xFFFF)
 
@@ -14,6 +14,51 @@
 #endif
 
 
+/* Fold ALU ops whose operands are all known-const into a load of the
+ *  result, and ops with one known-const operand into immediate forms.
+ */
+#define USE_CONST_ALU_FOLDING
+
+#ifdef USE_CONST_ALU_FOLDING
+/* Can LI32() load 'val' using just one opcode? */
+static inline bool constIsOneOp(const u32 val)
+{
+	return (val <= 0xffff) || !(val & 0xffff) || ((s32)val < 0 && (s32)val >= -32768);
+}
+
+static inline bool regIsMapped(const u32 psxreg)
+{
+	return !psxreg || regcache.psx[psxreg].ismapped;
+}
+
+/* Called by emitters when all source operands of op writing 'rd' are
+ *  known-const, and its result is 'val'. Loads the result directly instead of
+ *  emitting the op, so the sources needn't be loaded into host regs, and
+ *  emits nothing if 'rd' already holds the value.
+ * Returns false if emitting the op is cheaper: its sources are already in
+ *  host regs and loading 'val' would take two opcodes. Caller then emits the
+ *  op normally.
+ */
+static bool emitConstResult(const u32 rd, const u32 val, const u32 src1, const u32 src2)
+{
+	if (!rd)
+		return true;
+
+	if (IsConst(rd) && GetConst(rd) == val)
+		return true;
+
+	if (!constIsOneOp(val) && regIsMapped(src1) && regIsMapped(src2))
+		return false;
+
+	const u32 r1 = regMipsToHost(rd, REG_FIND, REG_REGISTER);
+	LI32(r1, val);
+	regMipsChanged(rd);
+	regUnlock(r1);
+	SetConst(rd, val);
+	return true;
+}
+#endif // USE_CONST_ALU_FOLDING
+
 /* NOTE: There's no need to do zero register optimizations since we have
          native zero reg on mips. */
 #define REC_ITYPE_RT_RS_I16(insn, _rt_, _rs_, _imm_) \
@@ -43,10 +88,15 @@ static void recADDIU()
 
 	const bool set_const = IsConst(_Rs_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rt_, GetConst(_Rs_) + (s32)_Imm_, _Rs_, 0))
+		return;
+#else
 	/* Catch ADDIU reg, $0, imm */
 	/* Exit if const already loaded */
 	if (!_Rs_ && IsConst(_Rt_) && GetConst(_Rt_) == (s32)_Imm_)
 		return;
+#endif
 
 	REC_ITYPE_RT_RS_I16(ADDIU,  _Rt_, _Rs_, _Imm_);
 
@@ -61,6 +111,11 @@ static void recSLTI()
 
 	const bool set_const = IsConst(_Rs_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rt_, (s32)GetConst(_Rs_) < (s32)_Imm_, _Rs_, 0))
+		return;
+#endif
+
 	REC_ITYPE_RT_RS_I16(SLTI, _Rt_, _Rs_, _Imm_);
 
 	if (set_const)
@@ -74,6 +129,11 @@ static void recSLTIU()
 
 	const bool set_const = IsConst(_Rs_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rt_, GetConst(_Rs_) < (u32)((s32)_Imm_), _Rs_, 0))
+		return;
+#endif
+
 	REC_ITYPE_RT_RS_I16(SLTIU, _Rt_, _Rs_, _Imm_);
 
 	if (set_const)
@@ -108,6 +168,11 @@ static void recANDI()
 
 	const bool set_const = IsConst(_Rs_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rt_, GetConst(_Rs_) & (u32)_ImmU_, _Rs_, 0))
+		return;
+#endif
+
 	REC_ITYPE_RT_RS_U16(ANDI, _Rt_, _Rs_, _ImmU_);
 
 	if (set_const)
@@ -120,10 +185,15 @@ static void recORI()
 
 	bool set_const = IsConst(_Rs_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rt_, GetConst(_Rs_) | (u32)_ImmU_, _Rs_, 0))
+		return;
+#else
 	/* Catch ORI reg, $0, imm */
 	/* Exit if const already loaded */
 	if (!_Rs_ && IsConst(_Rt_) && GetConst(_Rt_) == (u32)_ImmU_)
 		return;
+#endif
 
 	REC_ITYPE_RT_RS_U16(ORI,  _Rt_, _Rs_, _ImmU_);
 
@@ -137,6 +207,11 @@ static void recXORI()
 
 	const bool set_const = IsConst(_Rs_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rt_, GetConst(_Rs_) ^ (u32)_ImmU_, _Rs_, 0))
+		return;
+#endif
+
 	REC_ITYPE_RT_RS_U16(XORI, _Rt_, _Rs_, _ImmU_);
 
 	if (set_const)
@@ -209,6 +284,11 @@ static void recADDU()
 	const bool rt_const = IsConst(_Rt_);
 	const bool set_const = rs_const && rt_const;
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rs_) + GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+#endif
+
 	//  When an ADDU adds an unknown val to a known-const val:
 	// Propagate information about the known-const val's range with respect to
 	// PS1 address regions. If the dest reg is later used as a load/store base
@@ -238,6 +318,16 @@ static void recADDU()
 			fuzzy_scratchpad_addr = true;
 	}
 
+#ifdef USE_CONST_ALU_FOLDING
+	// If one operand is a known-const 16-bit signed val, emit ADDIU instead
+	if (!set_const && (rs_const || rt_const) &&
+	    (s32)GetConst(rs_const ? _Rs_ : _Rt_) == (s16)GetConst(rs_const ? _Rs_ : _Rt_))
+	{
+		const u32 const_reg = rs_const ? _Rs_ : _Rt_;
+		const u32 var_reg   = rs_const ? _Rt_ : _Rs_;
+		REC_ITYPE_RT_RS_I16(ADDIU, _Rd_, var_reg, (s32)GetConst(const_reg));
+	} else
+#endif
 	REC_RTYPE_RD_RS_RT(ADDU, _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -258,6 +348,19 @@ static void recSUBU()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rs_) - GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+
+	// If subtrahend is a known-const val whose negation fits in a 16-bit
+	//  signed imm, emit ADDIU instead
+	if (!set_const && IsConst(_Rt_) &&
+	    (s32)GetConst(_Rt_) <= 32768 && (s32)GetConst(_Rt_) > -32768) {
+		REC_ITYPE_RT_RS_I16(ADDIU, _Rd_, _Rs_, -(s32)GetConst(_Rt_));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RS_RT(SUBU, _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -271,6 +374,21 @@ static void recAND()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rs_) & GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+
+	// If one operand is a known-const 16-bit unsigned val, emit ANDI instead
+	const bool rs_imm = IsConst(_Rs_) && GetConst(_Rs_) <= 0xffff;
+	const bool rt_imm = IsConst(_Rt_) && GetConst(_Rt_) <= 0xffff;
+	if (!set_const && (rs_imm || rt_imm)) {
+		const u32 const_reg = rs_imm ? _Rs_ : _Rt_;
+		const u32 var_reg   = rs_imm ? _Rt_ : _Rs_;
+		REC_ITYPE_RT_RS_U16(ANDI, _Rd_, var_reg, GetConst(const_reg));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RS_RT(AND, _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -283,6 +401,21 @@ static void recOR()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rs_) | GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+
+	// If one operand is a known-const 16-bit unsigned val, emit ORI instead
+	const bool rs_imm = IsConst(_Rs_) && GetConst(_Rs_) <= 0xffff;
+	const bool rt_imm = IsConst(_Rt_) && GetConst(_Rt_) <= 0xffff;
+	if (!set_const && (rs_imm || rt_imm)) {
+		const u32 const_reg = rs_imm ? _Rs_ : _Rt_;
+		const u32 var_reg   = rs_imm ? _Rt_ : _Rs_;
+		REC_ITYPE_RT_RS_U16(ORI, _Rd_, var_reg, GetConst(const_reg));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RS_RT(OR,  _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -295,6 +428,21 @@ static void recXOR()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rs_) ^ GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+
+	// If one operand is a known-const 16-bit unsigned val, emit XORI instead
+	const bool rs_imm = IsConst(_Rs_) && GetConst(_Rs_) <= 0xffff;
+	const bool rt_imm = IsConst(_Rt_) && GetConst(_Rt_) <= 0xffff;
+	if (!set_const && (rs_imm || rt_imm)) {
+		const u32 const_reg = rs_imm ? _Rs_ : _Rt_;
+		const u32 var_reg   = rs_imm ? _Rt_ : _Rs_;
+		REC_ITYPE_RT_RS_U16(XORI, _Rd_, var_reg, GetConst(const_reg));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RS_RT(XOR, _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -307,6 +455,11 @@ static void recNOR()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, ~(GetConst(_Rs_) | GetConst(_Rt_)), _Rs_, _Rt_))
+		return;
+#endif
+
 	REC_RTYPE_RD_RS_RT(NOR, _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -319,6 +472,17 @@ static void recSLT()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, (s32)GetConst(_Rs_) < (s32)GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+
+	// If second operand is a known-const 16-bit signed val, emit SLTI instead
+	if (!set_const && IsConst(_Rt_) && (s32)GetConst(_Rt_) == (s16)GetConst(_Rt_)) {
+		REC_ITYPE_RT_RS_I16(SLTI, _Rd_, _Rs_, (s32)GetConst(_Rt_));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RS_RT(SLT,  _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -331,6 +495,18 @@ static void recSLTU()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rs_) < GetConst(_Rt_), _Rs_, _Rt_))
+		return;
+
+	// If second operand is a known-const val that SLTIU can represent,
+	//  i.e. a sign-extended 16-bit val, emit SLTIU instead
+	if (!set_const && IsConst(_Rt_) && (s32)GetConst(_Rt_) == (s16)GetConst(_Rt_)) {
+		REC_ITYPE_RT_RS_I16(SLTIU, _Rd_, _Rs_, (s32)GetConst(_Rt_));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RS_RT(SLTU, _Rd_, _Rs_, _Rt_);
 
 	if (set_const)
@@ -366,6 +542,11 @@ static void recSLL()
 
 	const bool set_const = IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rt_) << _Sa_, _Rt_, 0))
+		return;
+#endif
+
 #ifdef USE_MIPS32R2_ALU_OPCODE_CONVERSION
 	if (!branch)
 	{
@@ -475,6 +656,11 @@ static void recSRL()
 
 	const bool set_const = IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, (u32)GetConst(_Rt_) >> _Sa_, _Rt_, 0))
+		return;
+#endif
+
 #ifdef USE_MIPS32R2_ALU_OPCODE_CONVERSION
 	if (!branch)
 	{
@@ -594,6 +780,11 @@ static void recSRA()
 
 	const bool set_const = IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, (s32)GetConst(_Rt_) >> _Sa_, _Rt_, 0))
+		return;
+#endif
+
 #ifdef USE_MIPS32R2_ALU_OPCODE_CONVERSION
 	if (!branch)
 	{
@@ -687,10 +878,23 @@ static void recSLLV()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rt_) << (GetConst(_Rs_) & 31), _Rs_, _Rt_))
+		return;
+
+	// If shift amount is known-const, emit SLL instead
+	if (IsConst(_Rs_)) {
+		REC_RTYPE_RD_RT_SA(SLL, _Rd_, _Rt_, (GetConst(_Rs_) & 31));
+		if (set_const)
+			SetConst(_Rd_, GetConst(_Rt_) << (GetConst(_Rs_) & 31));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RT_RS(SLLV, _Rd_, _Rt_, _Rs_);
 
 	if (set_const)
-		SetConst(_Rd_, GetConst(_Rt_) << GetConst(_Rs_));
+		SetConst(_Rd_, GetConst(_Rt_) << (GetConst(_Rs_) & 31));
 }
 
 static void recSRLV()
@@ -699,10 +903,23 @@ static void recSRLV()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, GetConst(_Rt_) >> (GetConst(_Rs_) & 31), _Rs_, _Rt_))
+		return;
+
+	// If shift amount is known-const, emit SRL instead
+	if (IsConst(_Rs_)) {
+		REC_RTYPE_RD_RT_SA(SRL, _Rd_, _Rt_, (GetConst(_Rs_) & 31));
+		if (set_const)
+			SetConst(_Rd_, GetConst(_Rt_) >> (GetConst(_Rs_) & 31));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RT_RS(SRLV, _Rd_, _Rt_, _Rs_);
 
 	if (set_const)
-		SetConst(_Rd_, GetConst(_Rt_) >> GetConst(_Rs_));
+		SetConst(_Rd_, GetConst(_Rt_) >> (GetConst(_Rs_) & 31));
 }
 
 static void recSRAV()
@@ -711,8 +928,21 @@ static void recSRAV()
 
 	const bool set_const = IsConst(_Rs_) && IsConst(_Rt_);
 
+#ifdef USE_CONST_ALU_FOLDING
+	if (set_const && emitConstResult(_Rd_, (s32)GetConst(_Rt_) >> (GetConst(_Rs_) & 31), _Rs_, _Rt_))
+		return;
+
+	// If shift amount is known-const, emit SRA instead
+	if (IsConst(_Rs_)) {
+		REC_RTYPE_RD_RT_SA(SRA, _Rd_, _Rt_, (GetConst(_Rs_) & 31));
+		if (set_const)
+			SetConst(_Rd_, (s32)GetConst(_Rt_) >> (GetConst(_Rs_) & 31));
+		return;
+	}
+#endif
+
 	REC_RTYPE_RD_RT_RS(SRAV, _Rd_, _Rt_, _Rs_);
 
 	if (set_const)
-		SetConst(_Rd_, (s32)GetConst(_Rt_) >> GetConst(_Rs_));
+		SetConst(_Rd_, (s32)GetConst(_Rt_) >> (GetConst(_Rs_) & 31));
 }
@@ -288,7 +288,7 @@ static void iJumpNormal(u32 bpc)
 	if (!use_fastpath_return)
 		emitBlockReturnPC(bpc, BCU_FIRST_INSTRUCTION_ALWAYS_EXECUTED);
 
-	rec_recompile_end_part2(use_fastpath_return);
+	rec_recompile_end_part2_const(use_fastpath_return, bpc);
 
 	end_block = 1;
 }
@@ -322,7 +322,7 @@ static void iJumpAL(u32 bpc, u32 nbpc)
 	if (!use_fastpath_return)
 		emitBlockReturnPC(bpc, BCU_FIRST_INSTRUCTION_ALWAYS_EXECUTED);
 
-	rec_recompile_end_part2(use_fastpath_return);
+	rec_recompile_end_part2_const(use_fastpath_return, bpc);
 
 	end_block = 1;
 }
@@ -483,7 +483,7 @@ static void emitBxxZ(int andlink, u32 bpc, u32 nbpc)
 	if (bd_slot_loc == (uptr)recMem)
 		NOP();  // <BD slot>
 
-	rec_recompile_end_part2(use_fastpath_return);
+	rec_recompile_end_part2_const(use_fastpath_return, bpc);
 
 	regPopState();
 
@@ -555,6 +555,13 @@ static void emitBxx(u32 bpc)
 		bd_slot_writes = (u32)opcodeGetWrites(OPCODE_AT(pc)) & ~1;
 
 	u32 br1;
+#ifdef USE_CONST_BRANCH_OPTIMIZATIONS
+	if (IsConst(_Rs_) && GetConst(_Rs_) == 0) {
+		// Comparing against known-const 0: use host $zero. The decision is
+		//  made before the BD slot executes, so a write there doesn't matter.
+		br1 = 0;
+	} else
+#endif
 	if (bd_slot_writes & (1 << _Rs_)) {
 		// BD slot writes to reg read by branch: must get private copy.
 		br1 = regMipsToHost(_Rs_, REG_LOADBRANCH, REG_REGISTERBRANCH);
@@ -562,6 +569,12 @@ static void emitBxx(u32 bpc)
 		br1 = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	}
 	u32 br2;
+#ifdef USE_CONST_BRANCH_OPTIMIZATIONS
+	if (IsConst(_Rt_) && GetConst(_Rt_) == 0) {
+		// See above
+		br2 = 0;
+	} else
+#endif
 	if (bd_slot_writes & (1 << _Rt_)) {
 		// BD slot writes to reg read by branch: must get private copy.
 		br2 = regMipsToHost(_Rt_, REG_LOADBRANCH, REG_REGISTERBRANCH);
@@ -605,7 +618,7 @@ static void emitBxx(u32 bpc)
 	if (bd_slot_loc == (uptr)recMem)
 		NOP();  // <BD slot>
 
-	rec_recompile_end_part2(use_fastpath_return);
+	rec_recompile_end_part2_const(use_fastpath_return, bpc);
 
 	fixup_branch(backpatch);
 	regUnlock(br1);
@@ -843,7 +856,7 @@ static void recBNE()
 	if (bpc == nbpc && psxTestLoadDelay(_Rs_, OPCODE_AT(bpc)) == 0)
 		return;
 
-	if (!(_Rs_) && !(_Rt_)) {
+	if (_Rs_ == _Rt_) {
 		recDelaySlot();
 		return;
 	}
@@ -22,6 +22,11 @@
 //  creates load stalls.
 #define SKIP_MFC2_WRITEBACK
 
+// Emit inline code for the most frequent GTE compute ops (RTPS, RTPT, NCLIP,
+//  AVSZ3, AVSZ4, MVMVA) instead of calling the C functions in gte.cpp.
+//  Results and FLAG bits match gte.cpp as built for MIPS (native divide).
+#define USE_GTE_INLINE_OPS
+
 
 /* Emit code to call a GTE func that takes no arguments */
 #define CP2_FUNC_0(f) \
@@ -44,8 +49,6 @@ void rec##f() \
 	LI16(MIPSREG_A0, (u16)(psxRegs.code >> 10)); /* <BD slot> */ \
 }
 
-CP2_FUNC_0(RTPS)
-CP2_FUNC_0(NCLIP)
 CP2_FUNC_0(NCDS)
 CP2_FUNC_0(NCDT)
 CP2_FUNC_0(CDP)
@@ -54,19 +57,353 @@ CP2_FUNC_0(CC)
 CP2_FUNC_0(NCS)
 CP2_FUNC_0(NCT)
 CP2_FUNC_0(DPCT)
-CP2_FUNC_0(AVSZ3)
-CP2_FUNC_0(AVSZ4)
-CP2_FUNC_0(RTPT)
 CP2_FUNC_0(NCCT)
 CP2_FUNC_1(OP)
 CP2_FUNC_1(DPCS)
 CP2_FUNC_1(INTPL)
-CP2_FUNC_1(MVMVA)
 CP2_FUNC_1(SQR)
 CP2_FUNC_1(DCPL)
 CP2_FUNC_1(GPF)
 CP2_FUNC_1(GPL)
 
+#ifndef USE_GTE_INLINE_OPS
+CP2_FUNC_0(RTPS)
+CP2_FUNC_0(RTPT)
+CP2_FUNC_0(NCLIP)
+CP2_FUNC_0(AVSZ3)
+CP2_FUNC_0(AVSZ4)
+CP2_FUNC_1(MVMVA)
+#else
+
+/* Host regs used by inline GTE ops, besides TEMP_0..TEMP_3. None of these
+ *  are used by the reg allocator, or hold values across PS1 opcodes.
+ *  64-bit sums of products are accumulated in host HI/LO with MADD.
+ */
+#define GTE_FLAG  MIPSREG_A3  /* gteFLAG being computed */
+#define GTE_VX    MIPSREG_T4  /* Input vector */
+#define GTE_VY    MIPSREG_T5
+#define GTE_VZ    MIPSREG_T6
+#define GTE_LO    MIPSREG_T7  /* 64-bit result read from HI/LO */
+#define GTE_HI    MIPSREG_T8
+#define GTE_Q     MIPSREG_T9  /* Perspective divide quotient */
+#define GTE_IR1   MIPSREG_A0  /* Results written to gteIR1..3 */
+#define GTE_IR2   MIPSREG_A1
+#define GTE_IR3   MIPSREG_A2
+
+/* FLAG bits set by A1..A3(), limB1..3(), limD(), limE(), F(), limG1..2()
+ *  and limH() in gte.cpp
+ */
+static const u32 gte_flag_A_pos[3] = { 1 << 30, 1 << 29, 1 << 28 };
+static const u32 gte_flag_A_neg[3] = { (1u << 31) | (1 << 27),
+                                       (1u << 31) | (1 << 26),
+                                       (1u << 31) | (1 << 25) };
+static const u32 gte_flag_B[3]     = { (1u << 31) | (1 << 24),
+                                       (1u << 31) | (1 << 23),
+                                       (1 << 22) };
+#define GTE_FLAG_D      ((1u << 31) | (1 << 18))
+#define GTE_FLAG_E      ((1u << 31) | (1 << 17))
+#define GTE_FLAG_F_POS  ((1u << 31) | (1 << 16))
+#define GTE_FLAG_F_NEG  ((1u << 31) | (1 << 15))
+#define GTE_FLAG_G1     ((1u << 31) | (1 << 14))
+#define GTE_FLAG_G2     ((1u << 31) | (1 << 13))
+#define GTE_FLAG_H      (1 << 12)
+
+/* Like BOUNDS() in gte.cpp: if s64 value in GTE_HI:GTE_LO doesn't fit in
+ *  s32, set 'pos_flag' or 'neg_flag' bits in GTE_FLAG.
+ */
+static void emitGteBounds(u32 pos_flag, u32 neg_flag)
+{
+	SRA(TEMP_0, GTE_LO, 31);
+	XOR(TEMP_0, TEMP_0, GTE_HI);     // TEMP_0 = 0 if value fits in s32
+	LI32(TEMP_1, pos_flag);
+	LI32(TEMP_2, neg_flag);
+	SLT(TEMP_3, GTE_HI, 0);
+	MOVN(TEMP_1, TEMP_2, TEMP_3);    // if (value < 0) TEMP_1 = neg_flag
+	MOVZ(TEMP_1, 0, TEMP_0);         // if (value fits) TEMP_1 = 0
+	OR(GTE_FLAG, GTE_FLAG, TEMP_1);
+}
+
+/* Like LIM() in gte.cpp: clamp s32 value in 'reg' to min..max, setting
+ *  'flag' bits in GTE_FLAG if it was out of range.
+ */
+static void emitGteLim(u32 reg, s32 max, s32 min, u32 flag)
+{
+	LI32(TEMP_0, max);
+	SLT(TEMP_1, TEMP_0, reg);        // TEMP_1 = (reg > max)
+	MOVN(reg, TEMP_0, TEMP_1);
+	if (min == 0) {
+		SLT(TEMP_2, reg, 0);         // TEMP_2 = (reg < 0)
+		MOVN(reg, 0, TEMP_2);
+	} else {
+		LI32(TEMP_0, min);
+		SLT(TEMP_2, reg, TEMP_0);    // TEMP_2 = (reg < min)
+		MOVN(reg, TEMP_0, TEMP_2);
+	}
+	OR(TEMP_1, TEMP_1, TEMP_2);
+	LI32(TEMP_0, flag);
+	MOVZ(TEMP_0, 0, TEMP_1);         // if (in range) TEMP_0 = 0
+	OR(GTE_FLAG, GTE_FLAG, TEMP_0);
+}
+
+/* GTE_LO = (s32)(GTE_HI:GTE_LO >> shift), GTE_HI = upper half */
+static void emitGteShift64(int shift)
+{
+	SRL(GTE_LO, GTE_LO, shift);
+	SLL(TEMP_0, GTE_HI, 32 - shift);
+	OR(GTE_LO, GTE_LO, TEMP_0);
+	SRA(GTE_HI, GTE_HI, shift);
+}
+
+/* Load vector V0..V2, or IR1..IR3 when v == 3, into GTE_VX,VY,VZ */
+static void emitGteLoadVector(int v)
+{
+	if (v < 3) {
+		LH(GTE_VX, PERM_REG_1, off(CP2D.p[v << 1].sw.l));
+		LH(GTE_VY, PERM_REG_1, off(CP2D.p[v << 1].sw.h));
+		LH(GTE_VZ, PERM_REG_1, off(CP2D.p[(v << 1) + 1].sw.l));
+	} else {
+		LH(GTE_VX, PERM_REG_1, off(CP2D.p[9].sw.l));
+		LH(GTE_VY, PERM_REG_1, off(CP2D.p[10].sw.l));
+		LH(GTE_VZ, PERM_REG_1, off(CP2D.p[11].sw.l));
+	}
+}
+
+/* Emit the matrix * vector + translation step shared by MVMVA and RTPS/RTPT:
+ *   gteMACn = An((((s64)CVn(cv) << 12) + MXn1(mx) * vx + MXn2(mx) * vy + MXn3(mx) * vz) >> shift)
+ *   gteIRn  = limBn(gteMACn, lm)
+ *  for n = 1..3, with vector already in GTE_VX,VY,VZ. Matrix/vector number
+ *  3 selects zeros, as in gte.cpp. Leaves gteMAC3 in GTE_LO.
+ */
+static void emitGteMatrixVector(int mx, int cv, int shift, int lm)
+{
+	const u32 ir_regs[3] = { GTE_IR1, GTE_IR2, GTE_IR3 };
+
+	for (int n = 0; n < 3; n++) {
+		// HI:LO = (s64)CVn << 12
+		if (cv < 3) {
+			LW(TEMP_0, PERM_REG_1, offCP2C((cv << 3) + 5 + n));
+			SLL(TEMP_1, TEMP_0, 12);
+			SRA(TEMP_2, TEMP_0, 20);
+			MTLO(TEMP_1);
+			MTHI(TEMP_2);
+		} else {
+			MTLO(0);
+			MTHI(0);
+		}
+
+		// Matrix elements are consecutive s16s, three per row
+		if (mx < 3) {
+			const u32 row = offCP2C(mx << 3) + n * 6;
+			LH(TEMP_0, PERM_REG_1, row);
+			LH(TEMP_1, PERM_REG_1, row + 2);
+			LH(TEMP_2, PERM_REG_1, row + 4);
+			MADD(TEMP_0, GTE_VX);
+			MADD(TEMP_1, GTE_VY);
+			MADD(TEMP_2, GTE_VZ);
+		}
+
+		MFLO(GTE_LO);
+		MFHI(GTE_HI);
+		if (shift)
+			emitGteShift64(shift);
+		emitGteBounds(gte_flag_A_pos[n], gte_flag_A_neg[n]);
+		SW(GTE_LO, PERM_REG_1, off(CP2D.r[25 + n]));        // gteMACn
+
+		MOV(ir_regs[n], GTE_LO);
+		emitGteLim(ir_regs[n], 0x7fff, lm ? 0 : -0x8000, gte_flag_B[n]);
+		SH(ir_regs[n], PERM_REG_1, off(CP2D.p[9 + n].sw.l)); // gteIRn
+	}
+}
+
+/* Perspective transformation of one vertex, the part of RTPS/RTPT after
+ *  emitGteMatrixVector(). Result goes to SZ reg 'sz' (16..19) and SXY reg
+ *  'sxy' (12..14), GTE_Q is set to the quotient.
+ */
+static void emitGtePerspective(int sz, int sxy)
+{
+	// SZ = limD(gteMAC3)
+	MOV(GTE_VX, GTE_LO);
+	emitGteLim(GTE_VX, 0xffff, 0, GTE_FLAG_D);
+	SH(GTE_VX, PERM_REG_1, off(CP2D.p[sz].w.l));
+
+	// quotient = limE(DIVIDE(gteH, SZ))
+	LHU(GTE_VY, PERM_REG_1, off(CP2C.p[26].w.l));   // gteH
+	SLL(TEMP_0, GTE_VX, 1);
+	SLTU(TEMP_0, GTE_VY, TEMP_0);    // TEMP_0 = (gteH < SZ * 2)
+	u32 *backpatch = recMem;
+	BEQZ(TEMP_0, 0);
+	ADDIU(GTE_Q, 0, -1);             // <BD> quotient = 0xffffffff
+	SLL(TEMP_0, GTE_VY, 16);
+	DIVU(TEMP_0, GTE_VX);
+	MFLO(GTE_Q);
+	fixup_branch(backpatch);
+
+	LUI(TEMP_0, 2);
+	SLTU(TEMP_1, GTE_Q, TEMP_0);     // TEMP_1 = (quotient <= 0x1ffff)
+	ADDIU(TEMP_0, TEMP_0, -1);
+	MOVZ(GTE_Q, TEMP_0, TEMP_1);
+	LUI(TEMP_0, GTE_FLAG_E >> 16);
+	MOVN(TEMP_0, 0, TEMP_1);
+	OR(GTE_FLAG, GTE_FLAG, TEMP_0);
+
+	// SX = limG1(F((s64)gteOFX + ((s64)gteIR1 * quotient)) >> 16)
+	// SY = limG2(F((s64)gteOFY + ((s64)gteIR2 * quotient)) >> 16)
+	for (int i = 0; i < 2; i++) {
+		LW(TEMP_0, PERM_REG_1, offCP2C(24 + i));     // gteOFX/gteOFY
+		SRA(TEMP_1, TEMP_0, 31);
+		MTLO(TEMP_0);
+		MTHI(TEMP_1);
+		MADD(i ? GTE_IR2 : GTE_IR1, GTE_Q);
+		MFLO(GTE_LO);
+		MFHI(GTE_HI);
+		emitGteBounds(GTE_FLAG_F_POS, GTE_FLAG_F_NEG);
+		emitGteShift64(16);
+		emitGteLim(GTE_LO, 0x3ff, -0x400, i ? GTE_FLAG_G2 : GTE_FLAG_G1);
+		SH(GTE_LO, PERM_REG_1, off(CP2D.r[sxy]) + i * 2);
+	}
+}
+
+/* Depth cueing at end of RTPS/RTPT, using GTE_Q from last vertex:
+ *   gteMAC0 = F((s64)gteDQB + ((s64)gteDQA * quotient))
+ *   gteIR0 = limH(that >> 12)
+ */
+static void emitGteDepthCue()
+{
+	LW(TEMP_0, PERM_REG_1, offCP2C(28));                 // gteDQB
+	LH(TEMP_2, PERM_REG_1, off(CP2C.p[27].sw.l));        // gteDQA
+	SRA(TEMP_1, TEMP_0, 31);
+	MTLO(TEMP_0);
+	MTHI(TEMP_1);
+	MADD(TEMP_2, GTE_Q);
+	MFLO(GTE_LO);
+	MFHI(GTE_HI);
+	emitGteBounds(GTE_FLAG_F_POS, GTE_FLAG_F_NEG);
+	SW(GTE_LO, PERM_REG_1, off(CP2D.r[24]));             // gteMAC0
+	emitGteShift64(12);
+	emitGteLim(GTE_LO, 0x1000, 0, GTE_FLAG_H);
+	SH(GTE_LO, PERM_REG_1, off(CP2D.p[8].sw.l));         // gteIR0
+}
+
+static void recRTPS()
+{
+	MOV(GTE_FLAG, 0);
+
+	emitGteLoadVector(0);
+	emitGteMatrixVector(0, 0, 12, 0);  // Rotation matrix, translation vector
+
+	// Push SZ and SXY FIFOs
+	LHU(TEMP_0, PERM_REG_1, off(CP2D.p[17].w.l));
+	LHU(TEMP_1, PERM_REG_1, off(CP2D.p[18].w.l));
+	LHU(TEMP_2, PERM_REG_1, off(CP2D.p[19].w.l));
+	SH(TEMP_0, PERM_REG_1, off(CP2D.p[16].w.l));
+	SH(TEMP_1, PERM_REG_1, off(CP2D.p[17].w.l));
+	SH(TEMP_2, PERM_REG_1, off(CP2D.p[18].w.l));
+	LW(TEMP_0, PERM_REG_1, off(CP2D.r[13]));
+	LW(TEMP_1, PERM_REG_1, off(CP2D.r[14]));
+	SW(TEMP_0, PERM_REG_1, off(CP2D.r[12]));
+	SW(TEMP_1, PERM_REG_1, off(CP2D.r[13]));
+
+	emitGtePerspective(19, 14);
+	emitGteDepthCue();
+
+	SW(GTE_FLAG, PERM_REG_1, offCP2C(31));
+}
+
+static void recRTPT()
+{
+	MOV(GTE_FLAG, 0);
+
+	// gteSZ0 = gteSZ3
+	LHU(TEMP_0, PERM_REG_1, off(CP2D.p[19].w.l));
+	SH(TEMP_0, PERM_REG_1, off(CP2D.p[16].w.l));
+
+	for (int v = 0; v < 3; v++) {
+		emitGteLoadVector(v);
+		emitGteMatrixVector(0, 0, 12, 0);
+		emitGtePerspective(17 + v, 12 + v);
+	}
+	emitGteDepthCue();
+
+	SW(GTE_FLAG, PERM_REG_1, offCP2C(31));
+}
+
+static void recMVMVA()
+{
+	const u32 code = psxRegs.code;
+	const int shift = ((code >> 19) & 1) ? 12 : 0;
+	const int mx    = (code >> 17) & 3;
+	const int v     = (code >> 15) & 3;
+	const int cv    = (code >> 13) & 3;
+	const int lm    = (code >> 10) & 1;
+
+	MOV(GTE_FLAG, 0);
+	emitGteLoadVector(v);
+	emitGteMatrixVector(mx, cv, shift, lm);
+	SW(GTE_FLAG, PERM_REG_1, offCP2C(31));
+}
+
+static void recNCLIP()
+{
+	// gteMAC0 = F((s64)gteSX0 * (gteSY1 - gteSY2) +
+	//             gteSX1 * (gteSY2 - gteSY0) + gteSX2 * (gteSY0 - gteSY1))
+	LH(TEMP_0, PERM_REG_1, off(CP2D.p[12].sw.h));        // gteSY0
+	LH(TEMP_1, PERM_REG_1, off(CP2D.p[13].sw.h));        // gteSY1
+	LH(TEMP_2, PERM_REG_1, off(CP2D.p[14].sw.h));        // gteSY2
+	LH(GTE_VX, PERM_REG_1, off(CP2D.p[12].sw.l));        // gteSX0
+	LH(GTE_VY, PERM_REG_1, off(CP2D.p[13].sw.l));        // gteSX1
+	LH(GTE_VZ, PERM_REG_1, off(CP2D.p[14].sw.l));        // gteSX2
+	SUBU(TEMP_3, TEMP_1, TEMP_2);
+	MULT(GTE_VX, TEMP_3);
+	SUBU(TEMP_3, TEMP_2, TEMP_0);
+	MADD(GTE_VY, TEMP_3);
+	SUBU(TEMP_3, TEMP_0, TEMP_1);
+	MADD(GTE_VZ, TEMP_3);
+	MOV(GTE_FLAG, 0);
+	MFLO(GTE_LO);
+	MFHI(GTE_HI);
+	emitGteBounds(GTE_FLAG_F_POS, GTE_FLAG_F_NEG);
+	SW(GTE_LO, PERM_REG_1, off(CP2D.r[24]));             // gteMAC0
+	SW(GTE_FLAG, PERM_REG_1, offCP2C(31));
+}
+
+/* AVSZ3/AVSZ4:
+ *   gteMAC0 = F((s64)gteZSF3 * (gteSZ1 + gteSZ2 + gteSZ3))
+ *   gteMAC0 = F((s64)gteZSF4 * (gteSZ0 + gteSZ1 + gteSZ2 + gteSZ3))
+ *   gteOTZ = limD(gteMAC0 >> 12)
+ */
+static void emitGteAVSZ(int count)
+{
+	const int first_sz = 20 - count;
+	LH(GTE_VX, PERM_REG_1, off(CP2C.p[count == 3 ? 29 : 30].sw.l)); // gteZSF3/4
+	LHU(TEMP_0, PERM_REG_1, off(CP2D.p[first_sz].w.l));
+	for (int i = 1; i < count; i++) {
+		LHU(TEMP_1, PERM_REG_1, off(CP2D.p[first_sz + i].w.l));
+		ADDU(TEMP_0, TEMP_0, TEMP_1);
+	}
+	MULT(GTE_VX, TEMP_0);
+	MOV(GTE_FLAG, 0);
+	MFLO(GTE_LO);
+	MFHI(GTE_HI);
+	emitGteBounds(GTE_FLAG_F_POS, GTE_FLAG_F_NEG);
+	SW(GTE_LO, PERM_REG_1, off(CP2D.r[24]));             // gteMAC0
+	SRA(GTE_LO, GTE_LO, 12);
+	emitGteLim(GTE_LO, 0xffff, 0, GTE_FLAG_D);
+	SH(GTE_LO, PERM_REG_1, off(CP2D.p[7].w.l));          // gteOTZ
+	SW(GTE_FLAG, PERM_REG_1, offCP2C(31));
+}
+
+static void recAVSZ3()
+{
+	emitGteAVSZ(3);
+}
+
+static void recAVSZ4()
+{
+	emitGteAVSZ(4);
+}
+
+#endif // USE_GTE_INLINE_OPS
+
 static void recCFC2()
 {
 	if (!_Rt_) return;
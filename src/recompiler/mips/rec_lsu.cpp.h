@@ -576,6 +576,7 @@ static void general_loads_stores(const int  count,
 
 	u32 *backpatch_label_exit_1 = 0;
 	u32 *backpatch_label_exit_2 = 0;
+	u32 *backpatch_label_exit_3 = 0;
 
 #ifdef USE_DIRECT_MEM_ACCESS
 	const bool emit_direct   = !force_indirect && !LSU_use_only_indirect_access(op_rs);
@@ -867,13 +868,21 @@ static void general_loads_stores(const int  count,
 
 		if (emit_code_invalidation)
 		{
-			/*****************************************************
-			 * Invalidate recRAM[addr+imm16] code block pointers *
-			 *****************************************************/
+			/****************************************************
+			 * Invalidate code blocks overlapping stored-to RAM *
+			 ****************************************************/
+
+			// Look up the 256-byte RAM region each store wrote to in
+			//  code_regions[], ORing the results together in TEMP_0. Only
+			//  if any region contains code is C func recInvalidateRange()
+			//  called, which invalidates exactly the blocks overlapping the
+			//  range of addresses stored to. See recompiler.cpp.
 
 			bool first_invalidation_done = false;
+			bool first_lookup_done = false;
+			s16 store_imm_min = 0, store_imm_max = 0;
 
-			LUI(TEMP_3, ADR_HI(recRAM)); // temp_3 = upper code block ptr array addr
+			LUI(TEMP_3, ADR_HI(code_regions)); // temp_3 = upper code region array addr
 
 			u32 PC = pc - 4;
 			int icount = count;
@@ -902,41 +911,42 @@ static void general_loads_stores(const int  count,
 				}
 
 #ifdef HAVE_MIPS32R2_EXT_INS
-				EXT(TEMP_1, MIPSREG_A0, 0, 21); // TEMP_1 = MIPSREG_A0 & 0x1fffff
+				EXT(TEMP_1, MIPSREG_A0, REC_REGION_SHIFT, 21 - REC_REGION_SHIFT);
 #else
 				SLL(TEMP_1, MIPSREG_A0, 11);
-				SRL(TEMP_1, TEMP_1, 11);
-#endif
-
-				if ((opcode & 0xfc000000) != 0xac000000) {
-					// Not a SW, clear lower 2 bits to ensure addr is aligned:
-#ifdef HAVE_MIPS32R2_EXT_INS
-					INS(TEMP_1, 0, 0, 2);
-#else
-					SRL(TEMP_1, TEMP_1, 2);
-					SLL(TEMP_1, TEMP_1, 2);
+				SRL(TEMP_1, TEMP_1, 11 + REC_REGION_SHIFT);
 #endif
-				}
 				ADDU(TEMP_1, TEMP_1, TEMP_3);
 
-				if ((PC-4) == pc_of_last_store_in_series && emit_direct) {
-					// This is the last store in the series, so the last invalidation
-					//  made and the end of all the direct code. Skip past the
-					//  indirect code coming after this.
-
-					backpatch_label_exit_2 = (u32 *)recMem;
-					B(0); // b label_exit
-					// NOTE: Branch delay slot will contain the instruction below
+				if (!first_lookup_done) {
+					LBU(TEMP_0, TEMP_1, ADR_LO(code_regions));
+					store_imm_min = store_imm_max = op_imm;
+					first_lookup_done = true;
+				} else {
+					LBU(TEMP_1, TEMP_1, ADR_LO(code_regions));
+					OR(TEMP_0, TEMP_0, TEMP_1);
+					if (op_imm < store_imm_min) store_imm_min = op_imm;
+					if (op_imm > store_imm_max) store_imm_max = op_imm;
 				}
-				// Important: this should be the last opcode in the loop (see note above)
-				SW(0, TEMP_1, ADR_LO(recRAM));  // set code block ptr to NULL
-
 
 				// Last store in series? We're done.
 				if ((PC-4) == pc_of_last_store_in_series)
 					break;
 
 			} while (--icount);
+
+			// Skip C call if no stores hit code. If indirect code is
+			//  emitted after this, skip past it either way.
+			backpatch_label_exit_2 = (u32 *)recMem;
+			BEQZ(TEMP_0, 0); // beqz label_exit
+			ADDIU(MIPSREG_A0, unmodified_base_reg, store_imm_min);  // <BD slot>
+			JAL(recInvalidateRange);
+			ADDIU(MIPSREG_A1, unmodified_base_reg, store_imm_max);  // <BD slot>
+			if (emit_indirect) {
+				backpatch_label_exit_3 = (u32 *)recMem;
+				B(0); // b label_exit
+				NOP(); // <BD slot>
+			}
 		}
 
 		if (backpatch_label_hle_1)
@@ -1214,6 +1224,8 @@ static void general_loads_stores(const int  count,
 		fixup_branch(backpatch_label_exit_1);
 	if (backpatch_label_exit_2)
 		fixup_branch(backpatch_label_exit_2);
+	if (backpatch_label_exit_3)
+		fixup_branch(backpatch_label_exit_3);
 
 	regUnlock(rs);
 }
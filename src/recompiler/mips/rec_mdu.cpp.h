@@ -37,6 +37,36 @@
 static bool convertMultiplyTo3Op();
 
 
+/* LO/HI are cached in host regs by the reg allocator, just like GPRs (see
+ *  REG_LO,REG_HI in regcache.h), so they stay in host regs across sequences
+ *  of MULT/DIV/MFLO/MFHI ops. They are written back at block exits.
+ * Returns host reg mapped to LO/HI, already marked as modified. Caller must
+ *  write the result to it and call regUnlock().
+ */
+static u32 regLoHiForWrite(const u32 psxreg)
+{
+	const u32 reg = regMipsToHost(psxreg, REG_FIND, REG_REGISTER);
+	regMipsChanged(psxreg);
+	return reg;
+}
+
+/* Set LO/HI to value in host reg 'src' */
+static void emitMoveToLoHi(const u32 psxreg, const u32 src)
+{
+	const u32 reg = regLoHiForWrite(psxreg);
+	MOV(reg, src);
+	regUnlock(reg);
+}
+
+/* Set LO/HI to const value 'val' */
+static void emitConstToLoHi(const u32 psxreg, const u32 val)
+{
+	const u32 reg = regLoHiForWrite(psxreg);
+	LI32(reg, val);
+	regUnlock(reg);
+}
+
+
 static void recMULT()
 {
 // Lo/Hi = Rs * Rt (signed)
@@ -82,10 +112,11 @@ static void recMULT()
 				work_reg = TEMP_1;
 			}
 
-			SW(work_reg, PERM_REG_1, offGPR(32)); // LO
+			emitMoveToLoHi(REG_LO, work_reg);
 			// Upper word is all 0s or 1s depending on sign of LO result
-			SRA(TEMP_1, work_reg, 31);
-			SW(TEMP_1, PERM_REG_1, offGPR(33));   // HI
+			const u32 hi = regLoHiForWrite(REG_HI);
+			SRA(hi, work_reg, 31);
+			regUnlock(hi);
 
 			regUnlock(ident_reg);
 
@@ -113,11 +144,13 @@ static void recMULT()
 					work_reg = TEMP_2;
 				}
 
-				SLL(TEMP_1, work_reg, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				const u32 lo = regLoHiForWrite(REG_LO);
+				const u32 hi = regLoHiForWrite(REG_HI);
+				SLL(lo, work_reg, shift_amt);
 				// Sign-extend here when computing upper word of result
-				SRA(TEMP_1, work_reg, (32 - shift_amt));
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				SRA(hi, work_reg, (32 - shift_amt));
+				regUnlock(lo);
+				regUnlock(hi);
 
 				regUnlock(npot_reg);
 
@@ -127,19 +160,8 @@ static void recMULT()
 		}
 
 		if (const_res) {
-			if (lo_res) {
-				LI32(TEMP_1, (u32)lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, (u32)hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitConstToLoHi(REG_LO, (u32)lo_res);
+			emitConstToLoHi(REG_HI, (u32)hi_res);
 
 			// We're done
 			return;
@@ -160,14 +182,17 @@ static void recMULT()
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
 
+	const u32 lo = regLoHiForWrite(REG_LO);
+	const u32 hi = regLoHiForWrite(REG_HI);
+
 	MULT(rs, rt);
-	MFLO(TEMP_1);
-	MFHI(TEMP_2);
-	SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-	SW(TEMP_2, PERM_REG_1, offGPR(33)); // HI
+	MFLO(lo);
+	MFHI(hi);
 
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 
@@ -206,8 +231,8 @@ static void recMULTU()
 			u32 ident_reg_psx = rs_const ? _Rt_ : _Rs_;
 			u32 ident_reg = regMipsToHost(ident_reg_psx, REG_LOAD, REG_REGISTER);
 
-			SW(0, PERM_REG_1, offGPR(33));         // HI
-			SW(ident_reg, PERM_REG_1, offGPR(32)); // LO
+			emitMoveToLoHi(REG_HI, 0);
+			emitMoveToLoHi(REG_LO, ident_reg);
 
 			regUnlock(ident_reg);
 
@@ -228,10 +253,12 @@ static void recMULTU()
 				u32 pot_val = rs_pot ? rs_val : rt_val;
 				u32 shift_amt = __builtin_ctz(pot_val);
 
-				SLL(TEMP_1, npot_reg, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-				SRL(TEMP_1, npot_reg, (32 - shift_amt));
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				const u32 lo = regLoHiForWrite(REG_LO);
+				const u32 hi = regLoHiForWrite(REG_HI);
+				SLL(lo, npot_reg, shift_amt);
+				SRL(hi, npot_reg, (32 - shift_amt));
+				regUnlock(lo);
+				regUnlock(hi);
 
 				regUnlock(npot_reg);
 
@@ -241,19 +268,8 @@ static void recMULTU()
 		}
 
 		if (const_res) {
-			if (lo_res) {
-				LI32(TEMP_1, lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitConstToLoHi(REG_LO, lo_res);
+			emitConstToLoHi(REG_HI, hi_res);
 
 			// We're done
 			return;
@@ -274,14 +290,17 @@ static void recMULTU()
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 	u32 rt = regMipsToHost(_Rt_, REG_LOAD, REG_REGISTER);
 
+	const u32 lo = regLoHiForWrite(REG_LO);
+	const u32 hi = regLoHiForWrite(REG_HI);
+
 	MULTU(rs, rt);
-	MFLO(TEMP_1);
-	MFHI(TEMP_2);
-	SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-	SW(TEMP_2, PERM_REG_1, offGPR(33)); // HI
+	MFLO(lo);
+	MFHI(hi);
 
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 
@@ -307,11 +326,12 @@ static void recDIV()
 			//  HI result is Rs val
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
+			const u32 lo = regLoHiForWrite(REG_LO);
 			ADDIU(TEMP_2, 0, -1);
-			SLT(TEMP_1, rs, 0);           // TEMP_1 = dividend < 0
-			MOVN(TEMP_1, TEMP_2, TEMP_1); // if (TEMP_1 != 0) TEMP_1 = TEMP_2
-			SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			SW(rs, PERM_REG_1, offGPR(33));     // HI
+			SLT(lo, rs, 0);               // lo = dividend < 0
+			MOVN(lo, TEMP_2, lo);         // if (lo != 0) lo = TEMP_2
+			regUnlock(lo);
+			emitMoveToLoHi(REG_HI, rs);
 
 			regUnlock(rs);
 
@@ -321,8 +341,8 @@ static void recDIV()
 			// If divisor is const-val '1', result is identity
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
-			SW(0, PERM_REG_1, offGPR(33));  // HI
-			SW(rs, PERM_REG_1, offGPR(32)); // LO
+			emitMoveToLoHi(REG_HI, 0);
+			emitMoveToLoHi(REG_LO, rs);
 
 			regUnlock(rs);
 
@@ -333,19 +353,8 @@ static void recDIV()
 			u32 lo_res = rs_val / rt_val;
 			u32 hi_res = rs_val % rt_val;
 
-			if (lo_res) {
-				LI32(TEMP_1, lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitConstToLoHi(REG_LO, lo_res);
+			emitConstToLoHi(REG_HI, hi_res);
 
 			// We're done
 			return;
@@ -368,17 +377,19 @@ static void recDIV()
 					work_reg = TEMP_2;
 				}
 
-				SRA(TEMP_1, work_reg, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				const u32 lo = regLoHiForWrite(REG_LO);
+				const u32 hi = regLoHiForWrite(REG_HI);
+				SRA(lo, work_reg, shift_amt);
 
 				// Subtract one from pot divisor to get remainder modulo mask
 				if ((pot_val-1) > 0xffff) {
 					LI32(TEMP_1, (pot_val-1));
-					AND(TEMP_1, rs, TEMP_1);
+					AND(hi, rs, TEMP_1);
 				} else {
-					ANDI(TEMP_1, rs, (pot_val-1));
+					ANDI(hi, rs, (pot_val-1));
 				}
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				regUnlock(lo);
+				regUnlock(hi);
 
 				regUnlock(rs);
 
@@ -425,33 +436,36 @@ static void recDIV()
 #endif
 	}
 
+	const u32 lo = regLoHiForWrite(REG_LO);
+	const u32 hi = regLoHiForWrite(REG_HI);
+
 	if (omit_div_by_zero_fixup) {
 		DIV(rs, rt);
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 	} else {
 		DIV(rs, rt);
 		ADDIU(MIPSREG_A1, 0, -1);
 		SLT(TEMP_3, rs, 0);        // TEMP_3 = (rs < 0 ? 1 : 0)
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 
 		// If divisor was 0, set LO result (quotient) to 1 if dividend was < 0
 		// If divisor was 0, set LO result (quotient) to -1 if dividend was >= 0
 		MOVN(MIPSREG_A0, TEMP_3, TEMP_3);      // if (TEMP_3 != 0) then MIPSREG_A1 = TEMP_3
 		MOVZ(MIPSREG_A0, MIPSREG_A1, TEMP_3);  // if (TEMP_3 == 0) then MIPSREG_A1 = MIPSREG_A0
-		MOVZ(TEMP_1, MIPSREG_A0, rt);          // if (rt == 0) then TEMP_1 = MIPSREG_A0
+		MOVZ(lo, MIPSREG_A0, rt);              // if (rt == 0) then lo = MIPSREG_A0
 
 #ifndef OMIT_DIV_BY_ZERO_HI_FIXUP
 		// If divisor was 0, set HI result (remainder) to rs
-		MOVZ(TEMP_2, rs, rt);
+		MOVZ(hi, rs, rt);
 #endif
 	}
 
-	SW(TEMP_1, PERM_REG_1, offGPR(32));
-	SW(TEMP_2, PERM_REG_1, offGPR(33));
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 
@@ -477,9 +491,8 @@ static void recDIVU()
 			//  HI result is Rs val
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
-			ADDIU(TEMP_1, 0, -1);
-			SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			SW(rs, PERM_REG_1, offGPR(33));     // HI
+			emitConstToLoHi(REG_LO, 0xffffffff);
+			emitMoveToLoHi(REG_HI, rs);
 
 			regUnlock(rs);
 
@@ -489,8 +502,8 @@ static void recDIVU()
 			// If divisor is const-val '1', result is identity
 			u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
 
-			SW(0, PERM_REG_1, offGPR(33));  // HI
-			SW(rs, PERM_REG_1, offGPR(32)); // LO
+			emitMoveToLoHi(REG_HI, 0);
+			emitMoveToLoHi(REG_LO, rs);
 
 			regUnlock(rs);
 
@@ -501,19 +514,8 @@ static void recDIVU()
 			u32 lo_res = rs_val / rt_val;
 			u32 hi_res = rs_val % rt_val;
 
-			if (lo_res) {
-				LI32(TEMP_1, lo_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
-			} else {
-				SW(0, PERM_REG_1, offGPR(32)); // LO
-			}
-
-			if (hi_res) {
-				LI32(TEMP_1, hi_res);
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
-			} else {
-				SW(0, PERM_REG_1, offGPR(33)); // HI
-			}
+			emitConstToLoHi(REG_LO, lo_res);
+			emitConstToLoHi(REG_HI, hi_res);
 
 			// We're done
 			return;
@@ -528,17 +530,19 @@ static void recDIVU()
 				u32 pot_val = rt_val;
 				u32 shift_amt = __builtin_ctz(pot_val);
 
-				SRL(TEMP_1, rs, shift_amt);
-				SW(TEMP_1, PERM_REG_1, offGPR(32)); // LO
+				const u32 lo = regLoHiForWrite(REG_LO);
+				const u32 hi = regLoHiForWrite(REG_HI);
+				SRL(lo, rs, shift_amt);
 
 				// Subtract one from pot divisor to get remainder modulo mask
 				if ((pot_val-1) > 0xffff) {
 					LI32(TEMP_1, (pot_val-1));
-					AND(TEMP_1, rs, TEMP_1);
+					AND(hi, rs, TEMP_1);
 				} else {
-					ANDI(TEMP_1, rs, (pot_val-1));
+					ANDI(hi, rs, (pot_val-1));
 				}
-				SW(TEMP_1, PERM_REG_1, offGPR(33)); // HI
+				regUnlock(lo);
+				regUnlock(hi);
 
 				regUnlock(rs);
 
@@ -572,29 +576,32 @@ static void recDIVU()
 #endif
 	}
 
+	const u32 lo = regLoHiForWrite(REG_LO);
+	const u32 hi = regLoHiForWrite(REG_HI);
+
 	if (omit_div_by_zero_fixup) {
 		DIVU(rs, rt);
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 	} else {
 		DIVU(rs, rt);
 		ADDIU(TEMP_3, 0, -1);
-		MFLO(TEMP_1);              // NOTE: Hi/Lo can't be cached for now, so spill them
-		MFHI(TEMP_2);
+		MFLO(lo);
+		MFHI(hi);
 
 		// If divisor was 0, set LO result (quotient) to 0xffff_ffff
-		MOVZ(TEMP_1, TEMP_3, rt);  // if (rt == 0) then TEMP_1 = TEMP_3
+		MOVZ(lo, TEMP_3, rt);      // if (rt == 0) then lo = TEMP_3
 
 #ifndef OMIT_DIV_BY_ZERO_HI_FIXUP
 		// If divisor was 0, set HI result (remainder) to rs
-		MOVZ(TEMP_2, rs, rt);
+		MOVZ(hi, rs, rt);
 #endif
 	}
 
-	SW(TEMP_1, PERM_REG_1, offGPR(32));
-	SW(TEMP_2, PERM_REG_1, offGPR(33));
 	regUnlock(rs);
 	regUnlock(rt);
+	regUnlock(lo);
+	regUnlock(hi);
 }
 
 static void recMFHI()
@@ -602,18 +609,20 @@ static void recMFHI()
 // Rd = Hi
 	if (!_Rd_) return;
 	SetUndef(_Rd_);
+	u32 hi = regMipsToHost(REG_HI, REG_LOAD, REG_REGISTER);
 	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
 
-	LW(rd, PERM_REG_1, offGPR(33));
+	MOV(rd, hi);
 	regMipsChanged(_Rd_);
 	regUnlock(rd);
+	regUnlock(hi);
 }
 
 static void recMTHI()
 {
 // Hi = Rs
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
-	SW(rs, PERM_REG_1, offGPR(33));
+	emitMoveToLoHi(REG_HI, rs);
 	regUnlock(rs);
 }
 
@@ -634,11 +643,13 @@ static void recMFLO()
 	if (!_Rd_) return;
 
 	SetUndef(_Rd_);
+	u32 lo = regMipsToHost(REG_LO, REG_LOAD, REG_REGISTER);
 	u32 rd = regMipsToHost(_Rd_, REG_FIND, REG_REGISTER);
 
-	LW(rd, PERM_REG_1, offGPR(32));
+	MOV(rd, lo);
 	regMipsChanged(_Rd_);
 	regUnlock(rd);
+	regUnlock(lo);
 }
 
 
@@ -646,7 +657,7 @@ static void recMTLO()
 {
 // Lo = Rs
 	u32 rs = regMipsToHost(_Rs_, REG_LOAD, REG_REGISTER);
-	SW(rs, PERM_REG_1, offGPR(32));
+	emitMoveToLoHi(REG_LO, rs);
 	regUnlock(rs);
 }
 
@@ -1101,7 +1112,7 @@ static bool convertMultiplyTo3Op()
 	//  the result. Other blocks might start at or before the MFLO instruction
 	//  in the original code.
 	if (branch) {
-		SW(rd, PERM_REG_1, offGPR(32)); // LO
+		emitMoveToLoHi(REG_LO, rd);
 	}
 
 	SetUndef(rd_of_mflo);
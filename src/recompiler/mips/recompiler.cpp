@@ -33,6 +33,7 @@
 #include "psxhw.h"
 #include "r3000a.h"
 #include "gte.h"
+#include "psxlockstep.h"
 
 /* For direct HW I/O */
 #include "mdec.h"
@@ -71,6 +72,21 @@
  */
 #define USE_DIRECT_FASTPATH_BLOCK_RETURN_JUMPS
 
+/* Block exits to a known-const PC in RAM jump directly to the target block
+ *  once it is recompiled, skipping the dispatch loop when no event is due.
+ *  Links are undone when target block is invalidated. Blocks that return to
+ *  the 'fastpath' dispatch loop are never link targets: the fastpath loop
+ *  re-enters the block whose address the main loop saved.
+ * NOTE: Option only has effect if USE_DIRECT_BLOCK_RETURN_JUMPS is enabled,
+ *  which itself only has effect when HLE emulated BIOS is not in use.
+ */
+#define USE_BLOCK_LINKING
+
+/* Blocks that are idle loops (see psxTestIdleLoop()) call C code at their
+ *  self-loop exit to fast-forward psxRegs.cycle to the next event.
+ */
+#define USE_IDLE_LOOP_SKIP
+
 /* Const propagation is applied to addresses */
 #define USE_CONST_ADDRESSES
 
@@ -113,12 +129,44 @@
 //#define WITH_DISASM
 //#define DEBUGG printf
 
+/* Hot-block profiler (for development purposes): each emitted block counts
+ *  its own executions. At shutdown, the blocks with the most estimated host
+ *  time are listed along with their PS1 code. Adds 4 opcodes to every block.
+ */
+//#define REC_PROFILE
+
 #include "mem_mapping.h"
 
-/* Bit vector indicating which PS1 RAM pages contain the start of blocks.
- *  Used to determine when code invalidation in recClear() can be skipped.
+/* Code block tracking, for precise code invalidation:
+ *  Every block recompiled from PS1 RAM is recorded, along with the range of
+ *  PS1 code it was recompiled from, and linked into a list for each 4KB page
+ *  of RAM that range overlaps. Writes to RAM invalidate exactly the blocks
+ *  whose code they overlap, wherever in the block the write lands.
+ *  code_regions[] holds a nonzero byte for each 256-byte region of RAM that
+ *  the code of any block overlaps. Stores in emitted code check it and only
+ *  call into recInvalidateRange() when it is set. See rec_lsu.cpp.h.
+ *  See '-BEGIN- Code block tracking' section further below.
  */
-static u8 code_pages[0x200000/4096/8];
+#define REC_PAGE_SHIFT     12
+#define REC_NUM_PAGES      (0x200000 >> REC_PAGE_SHIFT)
+#define REC_REGION_SHIFT   8
+#define REC_NUM_REGIONS    (0x200000 >> REC_REGION_SHIFT)
+#define REC_MAX_BLOCKS     (32*1024)
+#define REC_MAX_PAGE_LINKS (REC_MAX_BLOCKS*2)
+#define REC_MAX_EXITS      (REC_MAX_BLOCKS*2)
+#define REC_NIL            0xffffffff
+
+static u8 code_regions[REC_NUM_REGIONS];
+
+static void rec_blocks_reset();
+static bool rec_blocks_full();
+static void rec_block_begin(u32 start_pc);
+static void rec_block_end(u32 start_pc, u32 end_pc, u32 *code);
+static void rec_invalidate_range(u32 start, u32 end);
+static void rec_evict_code(const u8 *lo, const u8 *hi);
+static void recInvalidateRange(u32 first_addr, u32 last_addr);
+static bool rec_emit_linkable_exit(u32 target_pc);
+static void rec_emit_idle_loop_skip(u32 target_pc);
 
 /* Pointers to the recompiled blocks go here. psxRecLUT[] uses upper 16 bits of
  *  a PC value as an index to lookup a block pointer stored in recRAM/recROM.
@@ -196,10 +244,27 @@ static inline bool IsFuzzyScratchpadAddr(const u32 reg)  { return iRegs[reg].is_
  *  MIPS JAL/J opcodes in recompiled code that jump to C code require this.
  *  Dynamic allocation would get an anonymous mmap'ing, locating the recompiled
  *  code *far* too high in virtual address space.
+ *
+ *  The buffer is reserved at the largest allowed size, but only the first
+ *  'rec_mem_size' bytes are used (and ever touched). Size is set in MB by
+ *  'RecCacheSize' config line or -reccache option, see port.cpp.
+ *
+ *  The used part is a ring of RECMEM_REGIONS equal regions. Blocks are
+ *  emitted in order of recompilation, and before recMem gets within
+ *  RECMEM_SLACK bytes of the end of the evicted area, all blocks in the next
+ *  region are evicted. Only the oldest code is thrown away, instead of the
+ *  whole cache. See rec_mem_make_room().
  */
-#define RECMEM_SIZE         0x400000 //(12 * 1024 * 1024)
-#define RECMEM_SIZE_MAX     (RECMEM_SIZE-(512*1024))
-static u8 recMemBase[RECMEM_SIZE] __attribute__((aligned(4)));
+#define RECMEM_SIZE_MIN     (2*1024*1024)
+#define RECMEM_SIZE_DEFAULT (4*1024*1024)
+#define RECMEM_SIZE_LIMIT   (16*1024*1024)
+#define RECMEM_SLACK        (512*1024)   /* Room kept free for next block */
+#define RECMEM_REGIONS      8
+static u8 recMemBase[RECMEM_SIZE_LIMIT] __attribute__((aligned(4)));
+
+u32 rec_mem_size_mb = RECMEM_SIZE_DEFAULT / (1024*1024);
+static u32 rec_mem_size;           /* Bytes of recMemBase[] in use, set in recInit() */
+static u8 *recMemEvicted;          /* Blocks below here, from recMem on, are evicted */
 
 u32        *recMem;                /* Where does next emitted opcode in block go? */
 static u32 *recMemStart;           /* Where did first emitted opcode in block go? */
@@ -228,6 +293,8 @@ static bool lsu_tmp_cache_valid;           /* LSU vals are cached in $at,$v1. Se
 static bool host_v0_reg_is_const;          /* PCs are cached in $v0. See rec_bcu.cpp.h */
 static u32  host_v0_reg_constval;
 static bool host_ra_reg_has_block_retaddr; /* Indirect-return address is cached in $ra. */
+static bool block_has_fastpath_return;     /* Block being recompiled returns to 'fastpath' */
+static bool block_is_idle_loop;            /* Block being recompiled is an idle loop */
 
 
 #ifdef WITH_DISASM
@@ -372,6 +439,148 @@ do { \
 #endif
 
 
+#ifdef REC_PROFILE
+///////////////////////////////////////////////////////////////////////////////
+// -BEGIN- Hot-block profiler (for development purposes)
+///////////////////////////////////////////////////////////////////////////////
+#include <sys/time.h>
+
+#define REC_PROFILE_MAX_BLOCKS  (64*1024)  /* Later blocks aren't profiled */
+#define REC_PROFILE_TOP_N       30         /* Blocks listed at shutdown */
+#define REC_PROFILE_MAX_LISTING 64         /* Max PS1 opcodes listed per block */
+
+typedef struct {
+	u32 exec_count;    /* Incremented by emitted code on block entry (wraps!) */
+	u32 psx_pc;
+	u32 psx_insns;     /* PS1 opcodes covered by block, incl. discarded ones */
+	u32 host_insns;    /* Host opcodes emitted, not counting profiler's own */
+	u32 compile_usec;
+	u32 cache_gen;     /* Number of code cache flushes before compilation */
+} rec_profile_block;
+
+static struct {
+	rec_profile_block blocks[REC_PROFILE_MAX_BLOCKS];
+	u32 num_blocks;
+	u32 num_flushes;
+	u32 num_evictions; /* Number of code cache regions evicted */
+	u64 compile_usec;  /* Total time spent in recRecompile() */
+} rec_profile;
+
+static inline u64 rec_profile_get_usec()
+{
+	struct timeval tv;
+	gettimeofday(&tv, 0);
+	return (u64)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+/* Called at start of block recompilation: emit exec counter increment.
+ *  Returns block's profile entry, or NULL if table is full.
+ */
+static rec_profile_block* rec_profile_block_start()
+{
+	if (rec_profile.num_blocks >= REC_PROFILE_MAX_BLOCKS)
+		return NULL;
+
+	rec_profile_block *b = &rec_profile.blocks[rec_profile.num_blocks++];
+	memset(b, 0, sizeof(*b));
+	b->psx_pc = pc;
+	b->cache_gen = rec_profile.num_flushes;
+
+	// Nothing is allocated or cached in host regs yet at block entry
+	u32 *cnt = &b->exec_count;
+	LUI(TEMP_1, ADR_HI(cnt));
+	LW(TEMP_2, TEMP_1, ADR_LO(cnt));
+	ADDIU(TEMP_2, TEMP_2, 1);
+	SW(TEMP_2, TEMP_1, ADR_LO(cnt));
+
+	return b;
+}
+
+static void rec_profile_block_end(rec_profile_block *b, u64 start_usec)
+{
+	u32 usec = (u32)(rec_profile_get_usec() - start_usec);
+	rec_profile.compile_usec += usec;
+
+	if (b) {
+		b->psx_insns = (pc - oldpc) / 4;
+		b->host_insns = (recMem - recMemStart) - 4;
+		b->compile_usec = usec;
+	}
+}
+
+/* Host time estimate: execs * host opcodes (ignores early exits and stalls) */
+static inline u64 rec_profile_block_cost(const rec_profile_block *b)
+{
+	return (u64)b->exec_count * b->host_insns;
+}
+
+static int rec_profile_cmp(const void *lhs, const void *rhs)
+{
+	u64 l = rec_profile_block_cost((const rec_profile_block *)lhs);
+	u64 r = rec_profile_block_cost((const rec_profile_block *)rhs);
+	return (l < r) ? 1 : ((l > r) ? -1 : 0);
+}
+
+static void rec_profile_dump()
+{
+	if (rec_profile.num_blocks == 0)
+		return;
+
+	u64 total_cost = 0, total_execs = 0;
+	for (u32 i = 0; i < rec_profile.num_blocks; ++i) {
+		total_cost += rec_profile_block_cost(&rec_profile.blocks[i]);
+		total_execs += rec_profile.blocks[i].exec_count;
+	}
+
+	qsort(rec_profile.blocks, rec_profile.num_blocks, sizeof(rec_profile_block), rec_profile_cmp);
+
+	printf("\n-------------------------- DYNAREC BLOCK PROFILE --------------------------\n");
+	printf("Blocks compiled: %u%s  Code cache flushes: %u  Regions evicted: %u  Block executions: %llu\n",
+	       rec_profile.num_blocks,
+	       rec_profile.num_blocks >= REC_PROFILE_MAX_BLOCKS ? " (table full)" : "",
+	       rec_profile.num_flushes, rec_profile.num_evictions, (unsigned long long)total_execs);
+	printf("Time in recRecompile(): %.3f ms total, %.2f usec avg per block\n",
+	       (double)rec_profile.compile_usec / 1000.0,
+	       (double)rec_profile.compile_usec / rec_profile.num_blocks);
+	printf("Top %d blocks by estimated host time (execs * host opcodes):\n", REC_PROFILE_TOP_N);
+	printf("rank  PS1 PC         execs  psx_ops host_ops  est.%%  compile_us  gen\n");
+
+	const u32 top_n = rec_profile.num_blocks < REC_PROFILE_TOP_N ?
+	                  rec_profile.num_blocks : REC_PROFILE_TOP_N;
+
+	for (u32 i = 0; i < top_n; ++i) {
+		const rec_profile_block *b = &rec_profile.blocks[i];
+		printf("%4u  %08x %12u %8u %8u %6.2f %11u %4u\n",
+		       i+1, b->psx_pc, b->exec_count, b->psx_insns, b->host_insns,
+		       total_cost ? 100.0 * rec_profile_block_cost(b) / total_cost : 0.0,
+		       b->compile_usec, b->cache_gen);
+	}
+
+	// Listings use current contents of PS1 mem: code could since have changed
+	printf("\nPS1 code of top blocks:\n");
+	for (u32 i = 0; i < top_n; ++i) {
+		const rec_profile_block *b = &rec_profile.blocks[i];
+		printf("\n#%u  PC %08x  execs %u\n", i+1, b->psx_pc, b->exec_count);
+
+		u32 n = b->psx_insns < REC_PROFILE_MAX_LISTING ? b->psx_insns : REC_PROFILE_MAX_LISTING;
+		for (u32 j = 0; j < n; ++j) {
+			char buffer[512];
+			u32 psx_pc = b->psx_pc + j*4;
+			u32 opcode = OPCODE_AT(psx_pc);
+			disasm_mips_instruction(opcode, buffer, psx_pc, 0, 0);
+			printf("%08x: %08x %s\n", psx_pc, opcode, buffer);
+		}
+		if (n < b->psx_insns)
+			printf("  ... (%u more)\n", b->psx_insns - n);
+	}
+	printf("----------------------------------------------------------------------------\n");
+}
+///////////////////////////////////////////////////////////////////////////////
+// -END- Hot-block profiler
+///////////////////////////////////////////////////////////////////////////////
+#endif // REC_PROFILE
+
+
 #include "opcodes.h"
 
 #ifndef HAVE_MIPS32R2_CACHE_OPS
@@ -398,6 +607,518 @@ static inline void clear_insn_cache(void *start, void *end, int flags)
 }
 
 
+///////////////////////////////////////////////////////////////////////////////
+// -BEGIN- Code block tracking
+///////////////////////////////////////////////////////////////////////////////
+typedef struct {
+	u32 start;         /* Masked RAM address of first PS1 opcode in block,
+	                      or its unmasked PC if block is in ROM */
+	u32 end;           /* Masked RAM address just past last PS1 opcode */
+	u32 *code;         /* Start of block's recompiled code, NULL if unused */
+	u32 gen;           /* Incremented when entry is freed, see rec_exit */
+	bool in_ram;       /* Only blocks in RAM are in page lists */
+	bool linkable;     /* Can other blocks jump directly to this one? */
+	u32 next_free;     /* Link in free list, when entry is unused */
+} rec_block;
+
+typedef struct {
+	u32 block;         /* Index of block overlapping the page */
+	u32 next;          /* Next link in page's list, or in free list */
+} rec_page_link;
+
+/* Block exit to a known-const RAM PC that can be linked, i.e. patched to
+ *  jump directly to the target block. See rec_emit_linkable_exit().
+ */
+typedef struct {
+	u32 *slot;         /* Patchable J opcode */
+	u32 *unlinked;     /* Where 'slot' jumps while not linked */
+	u32 target;        /* Masked RAM address of target PC */
+	u32 src_block;     /* Block the exit belongs to, REC_NIL if untracked */
+	u32 src_gen;       /* Exit is stale if source block's 'gen' changed */
+	u32 next;          /* Next exit in target page's list, or in free list */
+} rec_exit;
+
+static struct {
+	rec_block     blocks[REC_MAX_BLOCKS];
+	rec_page_link links[REC_MAX_PAGE_LINKS];
+	rec_exit      exits[REC_MAX_EXITS];
+	u32 page_head[REC_NUM_PAGES];   /* First link in each page's list */
+	u32 page_exits[REC_NUM_PAGES];  /* First exit targeting each page */
+	u32 free_block;
+	u32 free_link;
+	u32 free_exit;
+	u32 num_free_links;
+	u32 cur_block;     /* Entry of block being recompiled, or REC_NIL */
+	bool cur_block_linkable;
+} rec_blocks;
+
+static void rec_blocks_reset()
+{
+	for (u32 i = 0; i < REC_NUM_PAGES; ++i) {
+		rec_blocks.page_head[i] = REC_NIL;
+		rec_blocks.page_exits[i] = REC_NIL;
+	}
+
+	for (u32 i = 0; i < REC_MAX_BLOCKS; ++i) {
+		rec_blocks.blocks[i].code = NULL;
+		rec_blocks.blocks[i].next_free = i+1;
+	}
+	rec_blocks.blocks[REC_MAX_BLOCKS-1].next_free = REC_NIL;
+	rec_blocks.free_block = 0;
+
+	for (u32 i = 0; i < REC_MAX_PAGE_LINKS; ++i)
+		rec_blocks.links[i].next = i+1;
+	rec_blocks.links[REC_MAX_PAGE_LINKS-1].next = REC_NIL;
+	rec_blocks.free_link = 0;
+	rec_blocks.num_free_links = REC_MAX_PAGE_LINKS;
+
+	for (u32 i = 0; i < REC_MAX_EXITS; ++i)
+		rec_blocks.exits[i].next = i+1;
+	rec_blocks.exits[REC_MAX_EXITS-1].next = REC_NIL;
+	rec_blocks.free_exit = 0;
+
+	rec_blocks.cur_block = REC_NIL;
+
+	memset(code_regions, 0, sizeof(code_regions));
+}
+
+/* Returns true if tracking tables can't be trusted to hold another block.
+ *  Blocks are almost always far shorter than the 64 pages reserved here,
+ *  but NOP sleds thousands of opcodes long are known to exist.
+ */
+static bool rec_blocks_full()
+{
+	return rec_blocks.free_block == REC_NIL || rec_blocks.num_free_links < 64;
+}
+
+/* Set code_regions[] bytes of a page from blocks still in its list */
+static void rec_page_update_regions(u32 page)
+{
+	const u32 page_start = page << REC_PAGE_SHIFT;
+	const u32 page_end = page_start + (1 << REC_PAGE_SHIFT);
+
+	memset(&code_regions[page_start >> REC_REGION_SHIFT], 0,
+	       1 << (REC_PAGE_SHIFT - REC_REGION_SHIFT));
+
+	for (u32 l = rec_blocks.page_head[page]; l != REC_NIL; l = rec_blocks.links[l].next) {
+		const rec_block *b = &rec_blocks.blocks[rec_blocks.links[l].block];
+		u32 start = b->start > page_start ? b->start : page_start;
+		u32 end = b->end < page_end ? b->end : page_end;
+		for (u32 r = start >> REC_REGION_SHIFT; r <= (end-1) >> REC_REGION_SHIFT; ++r)
+			code_regions[r] = 1;
+	}
+}
+
+/* Point J opcode at 'slot' to 'dst'. With MIPS32r2 cache ops, it's flushed
+ *  to Icache right away. Otherwise caller must flush it: each flush is a
+ *  syscall, so rec_link_exits() does one for all slots it patched.
+ */
+static void rec_patch_jump(u32 *slot, const u32 *dst)
+{
+	*slot = 0x08000000 | (((u32)dst & 0x0fffffff) >> 2);
+#ifdef HAVE_MIPS32R2_CACHE_OPS
+	// Flushing just the slot is cheap, patched slots can be MBs apart
+	clear_insn_cache(slot, slot+1, 0);
+#endif
+}
+
+/* Walk exits targeting page of masked RAM address 'target', linking them to
+ *  'code' (or unlinking them if NULL). Stale exits found are freed.
+ */
+static void rec_link_exits(u32 target, const u32 *code)
+{
+#ifndef HAVE_MIPS32R2_CACHE_OPS
+	u32 *patched_lo = NULL, *patched_hi = NULL;
+#endif
+	u32 *prev_next = &rec_blocks.page_exits[target >> REC_PAGE_SHIFT];
+	for (u32 e = *prev_next; e != REC_NIL; e = *prev_next) {
+		rec_exit *x = &rec_blocks.exits[e];
+
+		if (x->src_block != REC_NIL && rec_blocks.blocks[x->src_block].gen != x->src_gen) {
+			// Exit lies in code of an invalidated block: drop it
+			*prev_next = x->next;
+			x->next = rec_blocks.free_exit;
+			rec_blocks.free_exit = e;
+			continue;
+		}
+
+		if (x->target == target) {
+			rec_patch_jump(x->slot, code ? code : x->unlinked);
+#ifndef HAVE_MIPS32R2_CACHE_OPS
+			if (!patched_lo || x->slot < patched_lo)
+				patched_lo = x->slot;
+			if (!patched_hi || x->slot+1 > patched_hi)
+				patched_hi = x->slot+1;
+#endif
+		}
+
+		prev_next = &x->next;
+	}
+
+#ifndef HAVE_MIPS32R2_CACHE_OPS
+	// Single flush over range spanned by patched slots
+	if (patched_lo)
+		clear_insn_cache(patched_lo, patched_hi, 0);
+#endif
+}
+
+/* Called at start of recompilation of block at 'start_pc'. Block entry is
+ *  allocated now, so exits emitted within it can refer to it. Blocks in ROM
+ *  get an entry too, so they can be found when code cache is evicted.
+ */
+static void rec_block_begin(u32 start_pc)
+{
+	rec_blocks.cur_block = REC_NIL;
+	rec_blocks.cur_block_linkable = true;
+
+	if (rec_blocks.free_block == REC_NIL)
+		return;
+
+	const u32 idx = rec_blocks.free_block;
+	rec_blocks.free_block = rec_blocks.blocks[idx].next_free;
+	rec_blocks.cur_block = idx;
+}
+
+/* Record block recompiled from PS1 code in [start_pc, end_pc) and, if it's
+ *  in RAM, link any exits waiting for it.
+ */
+static void rec_block_end(u32 start_pc, u32 end_pc, u32 *code)
+{
+	const u32 idx = rec_blocks.cur_block;
+	if (idx == REC_NIL)
+		return;
+	rec_blocks.cur_block = REC_NIL;
+
+	rec_block *b = &rec_blocks.blocks[idx];
+
+	// For the range check, bit 27 is interpreted as a sign bit.
+	if ((s32)(start_pc << 4) < 0) {
+		// ROM code never changes: block is only tracked for eviction
+		b->start = start_pc;
+		b->end = start_pc;
+		b->code = code;
+		b->in_ram = false;
+		b->linkable = false;
+		return;
+	}
+
+	const u32 start = start_pc & 0x1ffffc;
+	u32 end = start + (end_pc - start_pc);
+	if (end > 0x200000)
+		end = 0x200000;
+
+	const u32 first_page = start >> REC_PAGE_SHIFT;
+	const u32 last_page = (end-1) >> REC_PAGE_SHIFT;
+
+	if (rec_blocks.num_free_links < (last_page - first_page + 1)) {
+		// Can't happen unless rec_blocks_full() margin is too small. Block
+		//  can't be tracked, so flush everything before next recompile.
+		REC_LOG("Block tracking tables overflowed at PC %08x\n", start_pc);
+		b->next_free = REC_NIL;
+		rec_blocks.free_block = REC_NIL;
+		return;
+	}
+
+	b->start = start;
+	b->end = end;
+	b->code = code;
+	b->in_ram = true;
+	b->linkable = rec_blocks.cur_block_linkable;
+
+	for (u32 page = first_page; page <= last_page; ++page) {
+		const u32 l = rec_blocks.free_link;
+		rec_blocks.free_link = rec_blocks.links[l].next;
+		rec_blocks.num_free_links--;
+		rec_blocks.links[l].block = idx;
+		rec_blocks.links[l].next = rec_blocks.page_head[page];
+		rec_blocks.page_head[page] = l;
+	}
+
+	for (u32 r = start >> REC_REGION_SHIFT; r <= (end-1) >> REC_REGION_SHIFT; ++r)
+		code_regions[r] = 1;
+
+	if (b->linkable)
+		rec_link_exits(start, code);
+}
+
+/* Invalidate a block: clear its code ptr, unlink exits jumping to it, and
+ *  remove it from all page lists.
+ */
+static void rec_block_invalidate(u32 idx)
+{
+	rec_block *b = &rec_blocks.blocks[idx];
+
+	if (!b->in_ram) {
+		PC_REC32(b->start) = 0;
+	} else {
+		*(uptr *)((uptr)recRAM + (b->start * REC_RAM_PTR_SIZE/4)) = 0;
+
+		if (b->linkable)
+			rec_link_exits(b->start, NULL);
+
+		const u32 first_page = b->start >> REC_PAGE_SHIFT;
+		const u32 last_page = (b->end-1) >> REC_PAGE_SHIFT;
+
+		for (u32 page = first_page; page <= last_page; ++page) {
+			u32 *prev_next = &rec_blocks.page_head[page];
+			for (u32 l = *prev_next; l != REC_NIL; l = *prev_next) {
+				if (rec_blocks.links[l].block == idx) {
+					*prev_next = rec_blocks.links[l].next;
+					rec_blocks.links[l].next = rec_blocks.free_link;
+					rec_blocks.free_link = l;
+					rec_blocks.num_free_links++;
+					break;
+				}
+				prev_next = &rec_blocks.links[l].next;
+			}
+		}
+	}
+
+	b->code = NULL;
+	b->gen++;
+	b->next_free = rec_blocks.free_block;
+	rec_blocks.free_block = idx;
+}
+
+/* Invalidate all blocks whose code overlaps masked RAM range [start, end) */
+static void rec_invalidate_range(u32 start, u32 end)
+{
+	if (end > 0x200000)
+		end = 0x200000;
+	if (start >= end)
+		return;
+
+	const u32 first_page = start >> REC_PAGE_SHIFT;
+	const u32 last_page = (end-1) >> REC_PAGE_SHIFT;
+
+	for (u32 page = first_page; page <= last_page; ++page) {
+		bool changed = false;
+		u32 l = rec_blocks.page_head[page];
+		while (l != REC_NIL) {
+			// Invalidation only unlinks this block's own link in this page
+			const u32 next = rec_blocks.links[l].next;
+			const u32 idx = rec_blocks.links[l].block;
+			const rec_block *b = &rec_blocks.blocks[idx];
+			if (b->start < end && b->end > start) {
+				// Block can span pages, so update all their regions
+				const u32 b_first_page = b->start >> REC_PAGE_SHIFT;
+				const u32 b_last_page = (b->end-1) >> REC_PAGE_SHIFT;
+				rec_block_invalidate(idx);
+				for (u32 p = b_first_page; p <= b_last_page; ++p) {
+					if (p != page)
+						rec_page_update_regions(p);
+				}
+				changed = true;
+			}
+			l = next;
+		}
+		if (changed)
+			rec_page_update_regions(page);
+	}
+}
+
+/* Free all stale exits, and any exit whose patchable J lies in code cache
+ *  range [lo, hi). rec_link_exits() only frees stale exits targeting the
+ *  page it walks, which could leave exits of evicted blocks allocated for
+ *  good and use up all REC_MAX_EXITS entries, disabling linking.
+ */
+static void rec_free_exits(const u8 *lo, const u8 *hi)
+{
+	for (u32 page = 0; page < REC_NUM_PAGES; ++page) {
+		u32 *prev_next = &rec_blocks.page_exits[page];
+		for (u32 e = *prev_next; e != REC_NIL; e = *prev_next) {
+			rec_exit *x = &rec_blocks.exits[e];
+			const bool stale = x->src_block != REC_NIL &&
+			                   rec_blocks.blocks[x->src_block].gen != x->src_gen;
+			if (stale || ((const u8 *)x->slot >= lo && (const u8 *)x->slot < hi)) {
+				*prev_next = x->next;
+				x->next = rec_blocks.free_exit;
+				rec_blocks.free_exit = e;
+				continue;
+			}
+			prev_next = &x->next;
+		}
+	}
+}
+
+/* Evict all blocks whose code starts in code cache range [lo, hi). Exits
+ *  lying in their code are freed, exits jumping to them are unlinked.
+ */
+static void rec_evict_code(const u8 *lo, const u8 *hi)
+{
+	for (u32 idx = 0; idx < REC_MAX_BLOCKS; ++idx) {
+		const rec_block *b = &rec_blocks.blocks[idx];
+		if ((const u8 *)b->code < lo || (const u8 *)b->code >= hi)
+			continue;
+
+		if (!b->in_ram) {
+			rec_block_invalidate(idx);
+			continue;
+		}
+
+		const u32 first_page = b->start >> REC_PAGE_SHIFT;
+		const u32 last_page = (b->end-1) >> REC_PAGE_SHIFT;
+		rec_block_invalidate(idx);
+		for (u32 page = first_page; page <= last_page; ++page)
+			rec_page_update_regions(page);
+	}
+
+	rec_free_exits(lo, hi);
+}
+
+/* Called from emitted code after a series of stores with a common base reg,
+ *  when code_regions[] showed that one of them hit a region containing code.
+ *  'first_addr','last_addr' are the lowest and highest store addresses.
+ */
+static void recInvalidateRange(u32 first_addr, u32 last_addr)
+{
+	const u32 start = first_addr & 0x1ffffc;
+	const u32 end = (last_addr & 0x1ffffc) + 4;
+
+	if (end > start) {
+		rec_invalidate_range(start, end);
+	} else {
+		// Range wrapped around end of RAM mirror
+		rec_invalidate_range(start, 0x200000);
+		rec_invalidate_range(0, end);
+	}
+}
+
+/* Called by idle loop blocks each time they branch back to their start.
+ *  Registers can differ from when the block was recompiled, so the load
+ *  addresses are checked again. Returns 'loop_pc' in $v0, the new PC.
+ */
+static u32 recIdleLoopSkip(u32 loop_pc)
+{
+	if (psxTestIdleLoop(loop_pc, true))
+		psxIdleLoopSkip();
+	return loop_pc;
+}
+
+/* Emit call to recIdleLoopSkip() at a block exit branching back to the
+ *  block's start, if block is an idle loop. Caller must have written back
+ *  all PS1 regs. Used by rec_recompile_end_part2_const() in mips_codegen.h.
+ */
+static void rec_emit_idle_loop_skip(u32 target_pc)
+{
+#ifdef USE_IDLE_LOOP_SKIP
+	if (!block_is_idle_loop || target_pc != oldpc)
+		return;
+
+	LI32(MIPSREG_A0, target_pc);
+	JAL(recIdleLoopSkip);
+	NOP(); // <BD>
+
+	// Call overwrote $ra, reload it if indirect block returns are in use
+	rec_recompile_end_part1();
+#endif
+}
+
+/* Emit block exit to known-const 'target_pc', which caller has already
+ *  placed in $v0. Used in place of rec_recompile_end_part2() when blocks
+ *  return directly to dispatch loop (block_ret_addr != 0), see
+ *  rec_recompile_end_part2_const() in mips_codegen.h.
+ *
+ *  The exit does the dispatch loop's cycle accounting itself. If no event
+ *  is due, it jumps through a patchable J opcode, which goes to the dispatch
+ *  loop until the target block is recompiled, then straight to the target
+ *  block's code. The J is pointed back to the dispatch loop when the target
+ *  is invalidated. Returns false if no exit was emitted.
+ */
+static bool rec_emit_linkable_exit(u32 target_pc)
+{
+#ifdef USE_BLOCK_LINKING
+	// Only targets in RAM are tracked. For range check, bit 27 is sign bit.
+	if (!block_ret_addr || (s32)(target_pc << 4) < 0)
+		return false;
+
+	// Out of entries: reclaim those left stale by invalidated blocks
+	if (rec_blocks.free_exit == REC_NIL)
+		rec_free_exits(NULL, NULL);
+	if (rec_blocks.free_exit == REC_NIL)
+		return false;
+
+	const u32 cycles = ADJUST_CLOCK((pc-oldpc)/4);
+
+	LW(TEMP_3, PERM_REG_1, off(cycle));
+	LW(TEMP_2, PERM_REG_1, off(io_cycle_counter));
+	if (cycles <= 0x7fff) {
+		ADDIU(TEMP_3, TEMP_3, cycles);
+	} else {
+		LI32(TEMP_1, cycles);
+		ADDU(TEMP_3, TEMP_3, TEMP_1);
+	}
+	SLTU(TEMP_2, TEMP_3, TEMP_2);
+	u32 *backpatch_label_branchtest = recMem;
+	BEQZ(TEMP_2, 0);                       // Event due: let dispatch loop handle it
+	SW(TEMP_3, PERM_REG_1, off(cycle));    // <BD>
+
+	u32 *slot = recMem;
+	J(0);                                  // Patched below
+	SW(MIPSREG_V0, PERM_REG_1, off(pc));   // <BD>
+
+	fixup_branch(backpatch_label_branchtest);
+	u32 *unlinked = recMem;
+	J(block_ret_addr);
+	LI16(MIPSREG_V1, 0);                   // <BD> Cycles were already added
+
+	*slot = 0x08000000 | (((u32)unlinked & 0x0fffffff) >> 2);
+
+	const u32 e = rec_blocks.free_exit;
+	rec_exit *x = &rec_blocks.exits[e];
+	rec_blocks.free_exit = x->next;
+	x->slot = slot;
+	x->unlinked = unlinked;
+	x->target = target_pc & 0x1ffffc;
+	x->src_block = rec_blocks.cur_block;
+	x->src_gen = (x->src_block != REC_NIL) ? rec_blocks.blocks[x->src_block].gen : 0;
+	x->next = rec_blocks.page_exits[x->target >> REC_PAGE_SHIFT];
+	rec_blocks.page_exits[x->target >> REC_PAGE_SHIFT] = e;
+
+	// If target is already recompiled, link it right away. Block code gets
+	//  flushed to Icache at end of recompilation, no need to do it here.
+	for (u32 l = rec_blocks.page_head[x->target >> REC_PAGE_SHIFT]; l != REC_NIL;
+	     l = rec_blocks.links[l].next) {
+		const rec_block *b = &rec_blocks.blocks[rec_blocks.links[l].block];
+		if (b->start == x->target) {
+			if (b->linkable)
+				*slot = 0x08000000 | (((u32)b->code & 0x0fffffff) >> 2);
+			break;
+		}
+	}
+
+	return true;
+#else
+	return false;
+#endif // USE_BLOCK_LINKING
+}
+///////////////////////////////////////////////////////////////////////////////
+// -END- Code block tracking
+///////////////////////////////////////////////////////////////////////////////
+
+
+/* Called before each recompilation: make sure at least RECMEM_SLACK bytes
+ *  past recMem are free, evicting the next region(s) of the code cache ring
+ *  if needed. Wraps around to start of buffer when nearing its end.
+ */
+static void rec_mem_make_room()
+{
+	if ((u8 *)recMem + RECMEM_SLACK > recMemBase + rec_mem_size) {
+		recMem = (u32 *)recMemBase;
+		recMemEvicted = recMemBase;
+	}
+
+	const u32 region_size = rec_mem_size / RECMEM_REGIONS;
+	while ((u8 *)recMem + RECMEM_SLACK > recMemEvicted) {
+		rec_evict_code(recMemEvicted, recMemEvicted + region_size);
+		recMemEvicted += region_size;
+#ifdef REC_PROFILE
+		rec_profile.num_evictions++;
+#endif
+	}
+}
+
+
 /* Set default recompilation options, and any per-game settings */
 static void rec_set_options()
 {
@@ -430,11 +1151,21 @@ static void recRecompile()
 	// Notify plugin_lib that we're recompiling (affects frameskip timing)
 	pl_dynarec_notify();
 
-	if (((uptr)recMem - (uptr)recMemBase) >= RECMEM_SIZE_MAX ) {
-		REC_LOG("Code cache size limit exceeded: flushing code cache.\n");
+#ifdef REC_PROFILE
+	const u64 profile_start_usec = rec_profile_get_usec();
+#endif
+
+	if (rec_blocks_full()) {
+		REC_LOG("Block tracking tables full: flushing code cache.\n");
 		recReset();
+#ifdef REC_PROFILE
+		rec_profile.num_flushes++;
+#endif
 	}
 
+	// Evict oldest blocks if code cache is running out of room
+	rec_mem_make_room();
+
 	recMemStart = recMem;
 
 	regReset();
@@ -442,17 +1173,25 @@ static void recRecompile()
 	PC_REC32(psxRegs.pc) = (u32)recMem;
 	oldpc = pc = psxRegs.pc;
 
-	// If 'pc' is in PS1 RAM, mark the page of RAM as containing the start of
-	//  a block. For the range check, bit 27 is interpreted as a sign bit.
-	if ((s32)(pc << 4) >= 0) {
-		u32 masked_pc = pc & 0x1fffff;
-		code_pages[masked_pc/4096/8] |= (1 << ((masked_pc/4096) & 7));
-	}
+	// Find which regs are live at each opcode, see regcache.h
+	regScanLiveness(pc);
+
+	// Allocate block tracking entry, if block is in PS1 RAM
+	rec_block_begin(pc);
+	block_has_fastpath_return = false;
+
+	// Registers hold the values the block is entered with, so load
+	// addresses can already be checked.
+	block_is_idle_loop = psxTestIdleLoop(pc, true) != 0;
 
 	DISASM_INIT();
 
 	rec_recompile_start();
 
+#ifdef REC_PROFILE
+	rec_profile_block *profile_block = rec_profile_block_start();
+#endif
+
 	// Reset const-propagation
 	ResetConsts();
 
@@ -487,7 +1226,9 @@ static void recRecompile()
 #ifdef USE_CODE_DISCARD
 		// If we are not already skipping past discardable code, scan
 		//  for PS1 code sequence we can discard.
-		if (discard_cnt == 0) {
+		//  Blocks must end at the same branches as in psxInt when the
+		//  lockstep checker is running.
+		if (discard_cnt == 0 && !psxLockstepEnabled()) {
 			int discard_type = 0;
 			discard_cnt = rec_discard_scan(pc, &discard_type);
 			if (discard_cnt > 0)
@@ -513,8 +1254,17 @@ static void recRecompile()
 		regUpdate();
 	} while (!end_block);
 
+	// If block is in PS1 RAM, record the range of code it was recompiled
+	//  from. Blocks using 'fastpath' returns can't be jumped to directly.
+	rec_blocks.cur_block_linkable = !block_has_fastpath_return;
+	rec_block_end(oldpc, pc, recMemStart);
+
 	DISASM_HOST();
 	clear_insn_cache(recMemStart, recMem, 0);
+
+#ifdef REC_PROFILE
+	rec_profile_block_end(profile_block, profile_start_usec);
+#endif
 }
 
 
@@ -522,16 +1272,19 @@ static int recInit()
 {
 	REC_LOG("Initializing\n");
 
+	rec_mem_size = rec_mem_size_mb * 1024 * 1024;
+	if (rec_mem_size < RECMEM_SIZE_MIN)
+		rec_mem_size = RECMEM_SIZE_MIN;
+	if (rec_mem_size > RECMEM_SIZE_LIMIT)
+		rec_mem_size = RECMEM_SIZE_LIMIT;
+	rec_mem_size_mb = rec_mem_size / (1024*1024);
+	REC_LOG("Code cache size: %u MB\n", rec_mem_size_mb);
+
 	recMem = (u32*)recMemBase;
 
 	// Init code buffer, to allocate the RAM we need in advance. Filling with
 	//  all-1's should force an exception on any accidental non-code execution.
-	{
-		size_t fill_size = RECMEM_SIZE_MAX + 0x1000;  // 4KB past 'maximum' we'd ever use.
-		if (fill_size > RECMEM_SIZE)
-			fill_size = RECMEM_SIZE;
-		memset(recMemBase, 0xff, fill_size);
-	}
+	memset(recMemBase, 0xff, rec_mem_size);
 
 	// The tables recRAM and recROM hold block code pointers for all valid PC
 	//  values for a PS1 program, after masking away banking and/or mirroring.
@@ -594,6 +1347,11 @@ static void recShutdown()
 {
 	REC_LOG("Shutting down\n");
 
+#ifdef REC_PROFILE
+	// Must be done while PS1 mem is still mapped
+	rec_profile_dump();
+#endif
+
 	if (psx_mem_mapped)
 		rec_munmap_psx_mem();
 	if (rec_mem_mapped)
@@ -612,10 +1370,11 @@ static void recShutdown()
  * thus put all temporaries to stack. In this case $s[0-7], $fp and $ra are saved
  * in recExecute() and recExecuteBlock() only once.
  *
+ * recFunc() is also used by recExecuteSingleBlock() for the lockstep checker.
+ *
  * IMPORTANT: Functions containing inline ASM should have attribute 'noinline'.
  *            Crashes at callsites can occur otherwise, at least with GCC 4.xx.
  */
-#ifndef ASM_EXECUTE_LOOP
 __attribute__((noinline)) static void recFunc(void *fn)
 {
 	/* This magic code calls fn address saving registers $s[0-7], $fp and $ra. */
@@ -655,7 +1414,6 @@ __attribute__((noinline)) static void recFunc(void *fn)
 		  "s0", "s1", "s2", "s3", "s4", "s5", "s6", "s7", "fp", "ra", "memory"
 	);
 }
-#endif
 
 
 /* Execute blocks starting at psxRegs.pc
@@ -1607,6 +2365,21 @@ __asm__ __volatile__ (
 }
 
 
+/* Execute only the block at psxRegs.pc, for the lockstep checker. Blocks
+ *  return indirectly, like in recExecuteBlock().
+ */
+static void recExecuteSingleBlock()
+{
+	block_ret_addr = block_fast_ret_addr = 0;
+
+	u32 *p = (u32*)PC_REC(psxRegs.pc);
+	if (*p == 0)
+		recRecompile();
+
+	recFunc((void *)*p);
+}
+
+
 static void recExecute()
 {
 	// Clear code cache so that all emitted code from this point forward uses
@@ -1653,31 +2426,15 @@ static void recExecute()
 }
 
 
-/* Invalidate 'Size' code block pointers at word-aligned PS1 address 'Addr'. */
+/* Invalidate all blocks whose code overlaps the 'Size' words at word-aligned
+ *  PS1 address 'Addr'. Only the page lists of RAM pages in the range are
+ *  walked, so the large writes that occur when many games stream CD data
+ *  in-game cost very little when they don't land on code.
+ */
 static void recClear(u32 Addr, u32 Size)
 {
 	const u32 masked_ram_addr = Addr & 0x1ffffc;
-
-	// Check if the page(s) of PS1 RAM that 'Addr','Size' target contain the
-	//  start of any blocks. If not, invalidation would have no effect and is
-	//  skipped. This eliminates 99% of large unnecessary invalidations that
-	//  occur when many games stream CD data in-game.
-	u32 page = masked_ram_addr/4096;
-	u32 end_page = ((masked_ram_addr + (Size-1)*4)/4096) + 1;
-	bool has_code = false;
-	do {
-		u32 pflag = 1 << (page & 7);  // Each byte in code_pages[] represents 8 pages
-		has_code = code_pages[page/8] & pflag;
-	} while ((++page != end_page) && !has_code);
-
-	// NOTE: If PS1 mem is mapped/mirrored, make PC_REC_MMAP use the same virtual
-	//       mirror region the game is already using, reducing TLB pressure.
-	uptr dst_base = !rec_mem_mapped ? (uptr)recRAM : (uptr)PC_REC_MMAP(Addr & ~0x1fffff);
-
-	if (has_code) {
-		void *dst = (void*)(dst_base + (masked_ram_addr * REC_RAM_PTR_SIZE/4));
-		memset(dst, 0, Size*REC_RAM_PTR_SIZE);
-	}
+	rec_invalidate_range(masked_ram_addr, masked_ram_addr + Size*4);
 }
 
 
@@ -1752,11 +2509,12 @@ void recNotify(int note, void *data __attribute__((unused)))
 
 static void recReset()
 {
-	memset(code_pages, 0, sizeof(code_pages));
+	rec_blocks_reset();
 	memset(recRAM, 0, REC_RAM_SIZE);
 	memset(recROM, 0, REC_ROM_SIZE);
 
 	recMem = (u32*)recMemBase;
+	recMemEvicted = recMemBase;
 
 	regReset();
 
@@ -1773,5 +2531,6 @@ R3000Acpu psxRec =
 	recExecuteBlock,
 	recClear,
 	recNotify,
-	recShutdown
+	recShutdown,
+	recExecuteSingleBlock
 };
@@ -1,6 +1,11 @@
 #define REG_CACHE_START		MIPSREG_S0
 #define REG_CACHE_END		(MIPSREG_S7+1)
 
+/* LO/HI are cached like GPRs, using their indices in psxRegs.GPR.r[] */
+#define REG_LO			32
+#define REG_HI			33
+#define REG_PSX_NUM		34
+
 #define REG_LOAD		0
 #define REG_FIND		1
 #define REG_LOADBRANCH		2
@@ -27,10 +32,11 @@ typedef struct {
 	u32	mappedto;
 	bool	ismapped;
 	bool	psx_ischanged;
+	bool	psx_changed_now;	/* Modified by code emitted since last regUpdate() */
 } PSX_RecRegister;
 
 typedef struct {
-	PSX_RecRegister		psx[32];
+	PSX_RecRegister		psx[REG_PSX_NUM];
 	HOST_RecRegister	host[32];
 	u32			reglist[32];
 	u32			reglist_cnt;
@@ -43,10 +49,126 @@ static int          regcache_bak_idx  = 0;
 static const int    regcache_bak_size = 8; // Abitrary size choice (overkill?)
 static RecRegisters regcache_bak[regcache_bak_size];
 
+/* Register liveness, computed by regScanLiveness() before a block is emitted.
+ *  Bit n of reg_live_in[i] is set if PSX reg n (32:LO, 33:HI) might be read
+ *  by i'th opcode of block, or code after it, before being overwritten.
+ *  All regs are considered live at block exits, at conditional branches
+ *  (their taken path exits), and at ops that spill regs to call C code.
+ *  When a reg is dead, regFreeRegs() can drop its host reg without
+ *  writing the value back to psxRegs. Values written by the opcode being
+ *  emitted are never dropped: emitters of load/store series and 3-op MUL
+ *  handle several opcodes at once, while 'pc' stays at the first one.
+ */
+#define REG_LIVENESS_MAX_OPS	256
+static u64 reg_live_in[REG_LIVENESS_MAX_OPS];
+static u32 reg_live_cnt;
+
+/* Must all regs be considered live at this opcode? */
+static bool opcodeIsLivenessBarrier(const u32 op)
+{
+	switch (_fOp_(op)) {
+	case 0x00:
+		// JR, JALR, SYSCALL, BREAK
+		return _fFunct_(op) >= 0x08 && _fFunct_(op) <= 0x0d;
+	case 0x01: case 0x02: case 0x03: case 0x04:  // REGIMM branches, J, JAL,
+	case 0x05: case 0x06: case 0x07:             //  BEQ, BNE, BLEZ, BGTZ
+	case 0x10:                                   // COP0: MTC0 can raise exception
+	case 0x3b:                                   // HLE
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Does opcode end a block? (after its BD slot, if it has one) */
+static bool opcodeEndsBlock(const u32 op)
+{
+	switch (_fOp_(op)) {
+	case 0x00:
+		// JR, JALR, SYSCALL
+		return _fFunct_(op) == 0x08 || _fFunct_(op) == 0x09 || _fFunct_(op) == 0x0c;
+	case 0x02: case 0x03:                        // J, JAL
+	case 0x3b:                                   // HLE
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Compute reg_live_in[] for block starting at 'start_pc'.
+ * NOTE: Code discarded by rec_discard_scan() is scanned like any other code.
+ *       Those sequences begin with a branch, so this is merely conservative.
+ */
+static void regScanLiveness(const u32 start_pc)
+{
+	static u64 reads[REG_LIVENESS_MAX_OPS];
+	static u64 writes[REG_LIVENESS_MAX_OPS];
+	static bool barrier[REG_LIVENESS_MAX_OPS];
+
+	u32 cnt = 0;
+	u32 loc = start_pc;
+	bool in_bd_slot = false;
+
+	while (cnt < REG_LIVENESS_MAX_OPS) {
+		// Don't scan into unmapped memory
+		if ((loc & 0xffff) == 0 && !psxMemRLUT[loc >> 16])
+			break;
+
+		const u32 op = OPCODE_AT(loc);
+		loc += 4;
+
+		// BD slot of a branch is followed by its taken path's block exit
+		barrier[cnt] = in_bd_slot || opcodeIsLivenessBarrier(op);
+		if (!barrier[cnt]) {
+			reads[cnt] = opcodeGetReads(op);
+			writes[cnt] = opcodeGetWrites(op);
+		}
+		cnt++;
+
+		if (in_bd_slot && opcodeEndsBlock(OPCODE_AT(loc - 8)))
+			break;
+		in_bd_slot = opcodeIsBranchOrJump(op);
+
+		if (!in_bd_slot && opcodeEndsBlock(op))
+			break;
+	}
+
+	// Anything after the last op scanned is unknown: all regs are live
+	u64 live = ~(u64)0;
+	for (int i = cnt-1; i >= 0; --i) {
+		if (barrier[i]) {
+			live = ~(u64)0;
+		} else {
+			live = (live & ~writes[i]) | reads[i];
+		}
+		reg_live_in[i] = live;
+	}
+
+	reg_live_cnt = cnt;
+}
+
+/* Returns mask of regs live at the opcode currently being emitted: those it
+ *  might read, and those live after it. The latter include any reg the
+ *  opcode has already written, which must not be dropped.
+ */
+static inline u64 regLiveRegs()
+{
+	// A 3-op MUL has already written the dest reg of the MFLO it replaced,
+	//  which appears dead until reaching that MFLO.
+	if (skip_emitting_next_mflo)
+		return ~(u64)0;
+
+	// Recompiler 'pc' has already been advanced past the current opcode
+	const u32 idx = ((pc - oldpc) >> 2) - 1;
+	if (idx + 1 >= reg_live_cnt)
+		return ~(u64)0;
+	return reg_live_in[idx] | reg_live_in[idx+1];
+}
+
 /* Spill regs to psxRegs if they are in host regs and were modified */
 static void regClearJump(void)
 {
-	for (int i = 1; i < 32; i++) {
+	for (int i = 1; i < REG_PSX_NUM; i++) {
 		if (regcache.psx[i].ismapped) {
 			int mappedto = regcache.psx[i].mappedto;
 
@@ -71,6 +193,7 @@ static void regFreeRegs(void)
 	//DEBUGF("regFreeRegs\n");
 	int i = 0;
 	int firstfound = 0;
+	const u64 live = regLiveRegs();
 
 	while (regcache.reglist[i] != 0xFF) {
 		int hostreg = regcache.reglist[i];
@@ -79,7 +202,9 @@ static void regFreeRegs(void)
 		if (!regcache.host[hostreg].host_islocked) {
 			int psxreg = regcache.host[hostreg].mappedto;
 
-			if (regcache.psx[psxreg].psx_ischanged) {
+			// Values that will be overwritten before being read are dropped
+			if (regcache.psx[psxreg].psx_ischanged &&
+			    (regcache.psx[psxreg].psx_changed_now || (live & ((u64)1 << psxreg)))) {
 				SW(hostreg, PERM_REG_1, offGPR(psxreg));
 			}
 
@@ -159,8 +284,9 @@ static u32 regMipsToHostHelper(u32 regpsx, u32 action, u32 type)
 		regcache.host[regnum].mappedto = 0;
 
 		// If reg value is known-const, see if it can be loaded with just one ALU op
-		if (IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
-		                         (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
+		//  (LO/HI are never tracked as consts)
+		if (regpsx < 32 && IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
+		                                        (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
 		{
 			LI32(regnum, GetConst(regpsx));
 		} else {
@@ -173,8 +299,8 @@ static u32 regMipsToHostHelper(u32 regpsx, u32 action, u32 type)
 
 	if (action == REG_LOAD) {
 		// If reg value is known-const, see if it can be loaded with just one ALU op
-		if (IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
-		                         (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
+		if (regpsx < 32 && IsConst(regpsx) && ( (((u32)GetConst(regpsx) <= 0xffff) || !(GetConst(regpsx) & 0xffff)) ||
+		                                        (((s32)GetConst(regpsx) < 0) && ((s32)GetConst(regpsx) >= -32768))    ))
 		{
 			LI32(regcache.psx[regpsx].mappedto, GetConst(regpsx));
 		} else {
@@ -233,6 +359,7 @@ static void regMipsChanged(u32 regpsx)
 		return;
 
 	regcache.psx[regpsx].psx_ischanged = true;
+	regcache.psx[regpsx].psx_changed_now = true;
 }
 
 static void regUnlock(u32 reghost)
@@ -247,7 +374,7 @@ static void regUnlock(u32 reghost)
 
 static void regClearBranch(void)
 {
-	for (int i = 1; i < 32; i++) {
+	for (int i = 1; i < REG_PSX_NUM; i++) {
 		if (regcache.psx[i].ismapped && regcache.psx[i].psx_ischanged) {
 			SW(regcache.psx[i].mappedto, PERM_REG_1, offGPR(i));
 		}
@@ -257,8 +384,9 @@ static void regClearBranch(void)
 static void regReset()
 {
 	int i, i2;
-	for (i = 0; i < 32; i++) {
+	for (i = 0; i < REG_PSX_NUM; i++) {
 		regcache.psx[i].psx_ischanged = false;
+		regcache.psx[i].psx_changed_now = false;
 		regcache.psx[i].ismapped = false;
 		regcache.psx[i].mappedto = 0;
 	}
@@ -298,6 +426,9 @@ static void regUpdate(void)
 			regcache.host[ilock].host_islocked = 0;
 		}
 	}
+
+	for (int i = 0; i < REG_PSX_NUM; i++)
+		regcache.psx[i].psx_changed_now = false;
 }
 
 static void regPushState()
@@ -0,0 +1,214 @@
+/***************************************************************************
+*   Copyright (C) 2016 PCSX4ALL Team                                      *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+/*
+ * Standalone test of the MIPS recompiler's register cache, built with
+ * 'make test-regcache'. Only regcache.h and mips_codegen.cpp are used, no
+ * code is executed: the test drives the regcache like the emitters do,
+ * then checks which dirty PSX regs were written back to psxRegs when host
+ * regs had to be freed. Exit status is 1 if any check fails.
+ *
+ * Dead regs may be dropped without writing them back (see regScanLiveness()),
+ * but never values still needed later, in particular:
+ *  - regs loaded by a load series emitted at once, while 'pc' is still
+ *    at its first opcode,
+ *  - dest reg of an MFLO that a 3-op MUL has already written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psxcommon.h"
+#include "psxmem.h"
+#include "r3000a.h"
+#include "mips_codegen.h"
+
+// Only symbols regcache.h and mips_codegen.cpp need from the emulator and
+//  recompiler.cpp
+u8 **psxMemRLUT;
+u32 *recMem;
+static u32 pc;
+static u32 oldpc;
+static bool skip_emitting_next_mflo;
+static inline bool IsConst(const u32 reg)  { return reg == 0; }
+static inline u32  GetConst(const u32 reg) { return 0; }
+
+#include "regcache.h"
+
+// PS1 code is placed here
+static const u32 CODE_START = 0x80010000;
+static u32 code_page[0x10000/4];
+
+// Emitted host code
+static u32 emit_buf[1024];
+
+enum { PSX_V0 = 2, PSX_A0 = 4, PSX_A1 = 5, PSX_T0 = 8, PSX_S0 = 16,
+       PSX_SP = 29, PSX_RA = 31 };
+
+#define OP_LW(rt, rs, imm)     ((0x23 << 26) | ((rs) << 21) | ((rt) << 16) | ((imm) & 0xffff))
+#define OP_ADDIU(rt, rs, imm)  ((0x09 << 26) | ((rs) << 21) | ((rt) << 16) | ((imm) & 0xffff))
+#define OP_JR(rs)              (((rs) << 21) | 0x08)
+#define OP_MULT(rs, rt)        (((rs) << 21) | ((rt) << 16) | 0x18)
+#define OP_MFLO(rd)            (((rd) << 11) | 0x12)
+#define OP_NOP                 0
+
+static int num_failed;
+
+static void check(bool cond, const char *test, const char *what)
+{
+	if (!cond) {
+		printf("FAILED: %s: %s\n", test, what);
+		num_failed++;
+	}
+}
+
+// Recompile block 'code' from scratch, 'pc' past its first opcode
+static void start_block(const u32 *code, int num_ops)
+{
+	memset(code_page, 0, sizeof(code_page));
+	memcpy(code_page, code, num_ops * 4);
+	recMem = emit_buf;
+	skip_emitting_next_mflo = false;
+	regReset();
+	oldpc = CODE_START;
+	regScanLiveness(oldpc);
+	pc = oldpc + 4;
+}
+
+// Next opcode, like recRecompile() does between opcodes
+static void next_op()
+{
+	regUpdate();
+	pc += 4;
+}
+
+// Was PSX reg 'psxreg' written back to psxRegs by emitted code?
+static bool was_stored(u32 psxreg)
+{
+	// SW <any host reg>, offGPR(psxreg)(PERM_REG_1)
+	const u32 sw = 0xac000000 | (PERM_REG_1 << 21) | offGPR(psxreg);
+	for (u32 *p = emit_buf; p != recMem; ++p)
+		if ((*p & 0xffe0ffff) == sw)
+			return true;
+	return false;
+}
+
+// Is dirty value of PSX reg 'psxreg' held in a host reg or in psxRegs?
+static bool is_kept(u32 psxreg)
+{
+	return (regcache.psx[psxreg].ismapped && regcache.psx[psxreg].psx_ischanged) ||
+	       was_stored(psxreg);
+}
+
+// Write PSX reg, like an ALU op emitter
+static void write_reg(u32 psxreg)
+{
+	u32 r = regMipsToHost(psxreg, REG_FIND, REG_REGISTER);
+	regMipsChanged(psxreg);
+	regUnlock(r);
+}
+
+/* Typical function epilogue: nine loads through $sp, more regs than the
+ *  eight host regs available, emitted as one series. Loaded regs are dead
+ *  at the first load, as they are written without being read.
+ */
+static void test_load_series_eviction()
+{
+	const char *test = "load series";
+	u32 code[16];
+	int n = 0;
+	code[n++] = OP_LW(PSX_RA, PSX_SP, 0x24);
+	for (int i = 7; i >= 0; --i)
+		code[n++] = OP_LW(PSX_S0 + i, PSX_SP, 0x04 + i*4);
+	code[n++] = OP_JR(PSX_RA);
+	code[n++] = OP_ADDIU(PSX_SP, PSX_SP, 0x28);
+	start_block(code, n);
+
+	// Like general_loads_stores(): base reg stays locked for whole series
+	u32 base = regMipsToHost(PSX_SP, REG_LOAD, REG_REGISTER);
+	for (int i = 0; i < 9; ++i)
+		write_reg(_fRt_(code[i]));
+	regUnlock(base);
+
+	check(!regcache.psx[PSX_RA].ismapped || !regcache.psx[PSX_S0+7].ismapped,
+	      test, "no host reg was freed, test is broken");
+	for (int i = 0; i < 9; ++i) {
+		if (!is_kept(_fRt_(code[i]))) {
+			char buf[64];
+			sprintf(buf, "value of reg %u was dropped", _fRt_(code[i]));
+			check(false, test, buf);
+		}
+	}
+}
+
+/* 3-op MUL writes the MFLO's dest reg right away. Until the MFLO is reached,
+ *  that reg looks dead, but the value must be kept.
+ */
+static void test_3op_mul_window()
+{
+	const char *test = "3-op MUL";
+	const u32 code[] = { OP_MULT(PSX_A0, PSX_A1), OP_NOP, OP_NOP, OP_MFLO(PSX_V0),
+	                     OP_JR(PSX_RA), OP_NOP };
+	start_block(code, sizeof(code)/4);
+
+	// MULT converted: writes $v0, MFLO will emit nothing
+	write_reg(PSX_V0);
+	skip_emitting_next_mflo = true;
+	next_op();
+
+	regFreeRegs();
+	check(is_kept(PSX_V0), test, "MUL result was dropped");
+}
+
+/* Optimization itself: a value written by an earlier opcode, that the
+ *  current one overwrites without reading, is dropped.
+ */
+static void test_dead_value_dropped()
+{
+	const char *test = "dead value";
+	const u32 code[] = { OP_ADDIU(PSX_T0, 0, 1), OP_ADDIU(PSX_T0, 0, 2),
+	                     OP_ADDIU(PSX_T0, 0, 3), OP_JR(PSX_RA), OP_NOP };
+	start_block(code, sizeof(code)/4);
+
+	write_reg(PSX_T0);
+	next_op();
+
+	regFreeRegs();
+	check(!was_stored(PSX_T0), test, "dead value was written back");
+}
+
+int main(int argc, char **argv)
+{
+	psxMemRLUT = (u8 **)calloc(0x10000, sizeof(u8 *));
+	psxMemRLUT[CODE_START >> 16] = (u8 *)code_page;
+
+	test_load_series_eviction();
+	test_3op_mul_window();
+	test_dead_value_dropped();
+
+	free(psxMemRLUT);
+
+	if (num_failed) {
+		printf("%d check(s) failed\n", num_failed);
+		return 1;
+	}
+	printf("All regcache checks passed\n");
+	return 0;
+}
@@ -0,0 +1,491 @@
+/***************************************************************************
+*   Copyright (C) 2016 PCSX4ALL Team                                      *
+*                                                                         *
+*   This program is free software; you can redistribute it and/or modify  *
+*   it under the terms of the GNU General Public License as published by  *
+*   the Free Software Foundation; either version 2 of the License, or     *
+*   (at your option) any later version.                                   *
+*                                                                         *
+*   This program is distributed in the hope that it will be useful,       *
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+*   GNU General Public License for more details.                          *
+*                                                                         *
+*   You should have received a copy of the GNU General Public License     *
+*   along with this program; if not, write to the                         *
+*   Free Software Foundation, Inc.,                                       *
+*   51 Franklin Street, Fifth Floor, Boston, MA 02111-1307 USA.           *
+***************************************************************************/
+
+/*
+ * Standalone test of the x86_64 recompiler against the interpreter, built
+ * with 'make -f Makefile.linux RECOMPILER=x86_64 test-rec'. Only the CPU
+ * cores, GTE and lockstep checker are linked in, memory and HW I/O are
+ * stubbed here.
+ *
+ * Random programs are generated (fixed seed) from ALU, shift, mul/div,
+ * load/store (RAM, scratchpad, HW I/O), COP0 and GTE opcodes, with forward
+ * branches, jumps and JR/JALR sprinkled in. Each program is run from the
+ * same initial state on psxInt and then on psxRec, and GPRs, LO/HI, CP0,
+ * CP2, cycle count, pc, RAM, scratchpad and HW access counts are compared.
+ *
+ * With -lockstep, psxRec is run through the lockstep checker instead
+ * (see psxlockstep.cpp), which compares every block as it runs.
+ *
+ *   test_rec [-lockstep] [iterations]
+ *
+ * Exit status is 1 if any program gave different results.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psxcommon.h"
+#include "r3000a.h"
+#include "psxmem.h"
+#include "plugin_lib.h"
+#include "psxlockstep.h"
+
+// Only symbols the CPU cores need from the rest of the emulator
+PcsxConfig Config;
+psxRegisters psxRegs;
+R3000Acpu *psxCpu;
+struct pl_data_t pl_data;
+s8 *psxM, *psxH, *psxR, *psxP;
+u8 **psxMemRLUT;
+u8 **psxMemWLUT;
+void (*biosA0[256])(void);
+void (*biosB0[256])(void);
+void (*biosC0[256])(void);
+void (*psxHLEt[256])(void);
+
+void psxBranchTest()
+{
+	if (psxLockstepInBlock)
+		return;
+	psxRegs.io_cycle_counter = psxRegs.cycle + 0x7fffffff;
+}
+
+void psxIdleLoopSkip() {}
+
+void psxException(u32 code, u32 bd)
+{
+	// Programs are generated so that none is ever raised
+	printf("ERROR: unexpected exception %x at pc %08x\n", code, psxRegs.pc);
+	exit(1);
+}
+
+// HW I/O: counted, and values are scrambled so they differ from RAM
+static int num_hw_reads, num_hw_writes;
+
+u8  psxHwRead8 (u32 a) { num_hw_reads++; return psxH[a & 0xffff] ^ 0x5a; }
+u16 psxHwRead16(u32 a) { num_hw_reads++; return *(u16*)&psxH[a & 0xfffe] ^ 0x5a5a; }
+u32 psxHwRead32(u32 a) { num_hw_reads++; return *(u32*)&psxH[a & 0xfffc] ^ 0x5a5a5a5a; }
+void psxHwWrite8 (u32 a, u8 v)  { num_hw_writes++; psxH[a & 0xffff] = v + 1; }
+void psxHwWrite16(u32 a, u16 v) { num_hw_writes++; *(u16*)&psxH[a & 0xfffe] = v + 1; }
+void psxHwWrite32(u32 a, u32 v) { num_hw_writes++; *(u32*)&psxH[a & 0xfffc] = v + 1; }
+
+static inline bool is_hw_region(u32 a)
+{
+	u32 t = a >> 16;
+	return t == 0x1f80 || t == 0x9f80 || t == 0xbf80;
+}
+
+static inline bool is_hw_io(u32 a)
+{
+	return is_hw_region(a) && (a & 0xffff) >= 0x400;
+}
+
+// Host pointer to RAM or scratchpad for PS1 address 'a'
+static u8 *mem_ptr(u32 a)
+{
+	if (is_hw_region(a))
+		return (u8*)psxH + (a & 0xffff);
+	if ((a & 0x0fffffff) >= 0x200000) {
+		printf("ERROR: access to unmapped address %08x at pc %08x\n", a, psxRegs.pc);
+		exit(1);
+	}
+	return (u8*)psxM + (a & 0x1fffff);
+}
+
+u8 psxMemRead8(u32 a)
+{
+	if (is_hw_io(a)) {
+		if (psxLockstepShadow) { psxLockstepShadowHw(a); return 0; }
+		return psxHwRead8(a);
+	}
+	return *mem_ptr(a);
+}
+
+u16 psxMemRead16(u32 a)
+{
+	if (is_hw_io(a)) {
+		if (psxLockstepShadow) { psxLockstepShadowHw(a); return 0; }
+		return psxHwRead16(a);
+	}
+	return *(u16*)mem_ptr(a);
+}
+
+u32 psxMemRead32(u32 a)
+{
+	if (is_hw_io(a)) {
+		if (psxLockstepShadow) { psxLockstepShadowHw(a); return 0; }
+		return psxHwRead32(a);
+	}
+	return *(u32*)mem_ptr(a);
+}
+
+void psxMemWrite8(u32 a, u8 v)
+{
+	if (is_hw_io(a)) {
+		if (psxLockstepShadow) psxLockstepShadowHw(a);
+		else psxHwWrite8(a, v);
+		return;
+	}
+	if (psxLockstepShadow) psxLockstepShadowWrite(a, mem_ptr(a), 1);
+	*mem_ptr(a) = v;
+	if (!is_hw_region(a)) psxCpuClear(a & ~3, 1);
+}
+
+void psxMemWrite16(u32 a, u16 v)
+{
+	if (is_hw_io(a)) {
+		if (psxLockstepShadow) psxLockstepShadowHw(a);
+		else psxHwWrite16(a, v);
+		return;
+	}
+	if (psxLockstepShadow) psxLockstepShadowWrite(a, mem_ptr(a), 2);
+	*(u16*)mem_ptr(a) = v;
+	if (!is_hw_region(a)) psxCpuClear(a & ~3, 1);
+}
+
+void psxMemWrite32(u32 a, u32 v)
+{
+	if (is_hw_io(a)) {
+		if (psxLockstepShadow) psxLockstepShadowHw(a);
+		else psxHwWrite32(a, v);
+		return;
+	}
+	if (psxLockstepShadow) psxLockstepShadowWrite(a, mem_ptr(a), 4);
+	*(u32*)mem_ptr(a) = v;
+	if (!is_hw_region(a)) psxCpuClear(a, 1);
+}
+
+// xorshift64, fixed seed
+static u32 rnd()
+{
+	static u64 s = 88172645463325252ull;
+	s ^= s << 13;
+	s ^= s >> 7;
+	s ^= s << 17;
+	return (u32)s;
+}
+
+static u32 rnd_below(u32 n) { return rnd() % n; }
+
+#define CODE_BASE 0x80010000
+#define DATA_BASE 0x80100000
+#define MAX_OPS   512
+
+static u32 prog[MAX_OPS];
+static int num_ops;
+
+// Regs 26..28 hold base addresses of RAM data, scratchpad and HW I/O
+#define REG_RAM_BASE 26
+#define REG_SCRATCH_BASE 27
+#define REG_HW_BASE 28
+
+static u32 rtype(u32 rs, u32 rt, u32 rd, u32 sa, u32 f) { return (rs<<21)|(rt<<16)|(rd<<11)|(sa<<6)|f; }
+static u32 itype(u32 op, u32 rs, u32 rt, u32 imm)       { return (op<<26)|(rs<<21)|(rt<<16)|(imm&0xffff); }
+static u32 jtype(u32 op, u32 target)                    { return (op<<26)|((target & 0x0fffffff) >> 2); }
+static u32 dest_reg()   { return rnd_below(26); }  // Base regs are never written
+static u32 source_reg() { return rnd_below(32); }
+
+static bool is_branch_or_jump(u32 op)
+{
+	u32 major = op >> 26;
+	return (major >= 1 && major <= 7) ||
+	       (major == 0 && ((op & 0x3f) == 0x08 || (op & 0x3f) == 0x09));
+}
+
+static u32 gen_load_store(bool store)
+{
+	static const u32 loads[]  = { 0x20, 0x21, 0x23, 0x24, 0x25, 0x22, 0x26 };
+	static const u32 stores[] = { 0x28, 0x29, 0x2b, 0x2a, 0x2e };
+	u32 op = store ? stores[rnd_below(5)] : loads[rnd_below(7)];
+	const bool unaligned = op == 0x22 || op == 0x26 || op == 0x2a || op == 0x2e;
+
+	u32 base;
+	s32 offset;
+	switch (rnd_below(4)) {
+	case 0:  base = REG_RAM_BASE;     offset = rnd_below(0x400); break;
+	case 1:  base = REG_SCRATCH_BASE; offset = rnd_below(0x3f0); break;
+	case 2:  base = 0;                offset = 0x1000 + rnd_below(0x800); break;
+	default: base = REG_HW_BASE;      offset = rnd_below(0x100); break;
+	}
+	if (base == REG_HW_BASE && unaligned)
+		base = REG_RAM_BASE;
+	if (op == 0x21 || op == 0x25 || op == 0x29)
+		offset &= ~1;
+	if (op == 0x23 || op == 0x2b)
+		offset &= ~3;
+
+	return itype(op, base, store ? source_reg() : dest_reg(), offset);
+}
+
+// Any opcode that isn't a branch or jump. DIV is left out, as signed
+//  0x80000000 / -1 traps on x86 hosts in the interpreter.
+static u32 gen_op(bool bd_slot)
+{
+	switch (rnd_below(bd_slot ? 14 : 17)) {
+	case 0: case 1: {
+		static const u32 funct[] = { 0x20,0x21,0x22,0x23,0x24,0x25,0x26,0x27,0x2a,0x2b };
+		return rtype(source_reg(), source_reg(), dest_reg(), 0, funct[rnd_below(10)]);
+	}
+	case 2: case 3:  // ADDI..LUI
+		return itype(8 + rnd_below(8), source_reg(), dest_reg(),
+		             rnd_below(3) ? rnd_below(0x10000) : rnd_below(16));
+	case 4: {
+		static const u32 funct[] = { 0x00,0x02,0x03,0x04,0x06,0x07 };
+		return rtype(source_reg(), source_reg(), dest_reg(), rnd_below(32), funct[rnd_below(6)]);
+	}
+	case 5: {
+		static const u32 funct[] = { 0x18, 0x19, 0x1b };  // MULT, MULTU, DIVU
+		return rtype(source_reg(), source_reg(), 0, 0, funct[rnd_below(3)]);
+	}
+	case 6:
+		switch (rnd_below(4)) {
+		case 0:  return rtype(0, 0, dest_reg(), 0, 0x10);     // MFHI
+		case 1:  return rtype(source_reg(), 0, 0, 0, 0x11);   // MTHI
+		case 2:  return rtype(0, 0, dest_reg(), 0, 0x12);     // MFLO
+		default: return rtype(source_reg(), 0, 0, 0, 0x13);   // MTLO
+		}
+	case 7: case 8:
+		return gen_load_store(false);
+	case 9: case 10:
+		return gen_load_store(true);
+	case 11:
+		switch (rnd_below(3)) {
+		case 0:  return (0x10<<26)|(0<<21)|(dest_reg()<<16)|((rnd_below(2) ? 12 : 3)<<11);    // MFC0
+		case 1:  return (0x10<<26)|(4<<21)|(source_reg()<<16)|((rnd_below(2) ? 12 : 3)<<11);  // MTC0
+		default: return 0x42000010;                                                            // RFE
+		}
+	case 12:
+		switch (rnd_below(5)) {
+		case 0:  return (0x12<<26)|(0<<21)|(dest_reg()<<16)|(rnd_below(32)<<11);    // MFC2
+		case 1:  return (0x12<<26)|(4<<21)|(source_reg()<<16)|(rnd_below(32)<<11);  // MTC2
+		case 2:  return 0x4a000006 | (1<<25);                                       // NCLIP
+		case 3:  return itype(0x32, REG_RAM_BASE, rnd_below(32), rnd_below(0x100) & ~3);  // LWC2
+		default: return itype(0x3a, REG_RAM_BASE, rnd_below(32), rnd_below(0x100) & ~3);  // SWC2
+		}
+	default:
+		return 0;
+	}
+}
+
+// Program ends with a jump to CODE_BASE + num_ops*4, where runs stop
+static void gen_program()
+{
+	num_ops = 100 + rnd_below(300);
+	for (int i = 0; i < num_ops; ++i)
+		prog[i] = gen_op(false);
+
+	// Sometimes, a JR or JALR through r25 to a later op
+	int jr_pos = -10;
+	if (num_ops > 20 && rnd_below(2)) {
+		const int i = jr_pos = 5 + rnd_below(num_ops - 12);
+		const u32 target = CODE_BASE + (i + 4 + rnd_below(num_ops - i - 5)) * 4;
+		prog[i]   = itype(0x0f, 0, 25, target >> 16);
+		prog[i+1] = itype(0x0d, 25, 25, target & 0xffff);
+		prog[i+2] = rnd_below(2) ? rtype(25, 0, 0, 0, 0x08)
+		                         : rtype(25, 0, rnd_below(2) ? 31 : 25, 0, 0x09);
+		prog[i+3] = gen_op(true);
+	}
+
+	// Forward branches and jumps
+	const int num_branches = rnd_below(num_ops / 6);
+	for (int k = 0; k < num_branches; ++k) {
+		const int i = rnd_below(num_ops - 4);
+		if (i == 0 || is_branch_or_jump(prog[i-1]))
+			continue;
+		const int t = i + 2 + rnd_below(num_ops - i - 3);
+		if ((i >= jr_pos - 1 && i <= jr_pos + 3) || (t > jr_pos && t <= jr_pos + 3))
+			continue;
+
+		const s32 offset = t - (i + 1);
+		const u32 rs = source_reg(), rt = source_reg();
+		switch (rnd_below(8)) {
+		case 0: prog[i] = itype(4, rs, rt, offset); break;  // BEQ
+		case 1: prog[i] = itype(5, rs, rt, offset); break;  // BNE
+		case 2: prog[i] = itype(6, rs, 0, offset);  break;  // BLEZ
+		case 3: prog[i] = itype(7, rs, 0, offset);  break;  // BGTZ
+		case 4: {                                           // REGIMM
+			static const u32 regimm[] = { 0x00, 0x01, 0x10, 0x11 };
+			prog[i] = itype(1, rs, regimm[rnd_below(4)], offset);
+		} break;
+		case 5: prog[i] = jtype(rnd_below(2) ? 3 : 2, CODE_BASE + t*4); break;  // J, JAL
+		default: prog[i] = itype(4, 0, 0, offset); break;  // B
+		}
+		// Delay slot, sometimes a load
+		prog[i+1] = rnd_below(4) ? gen_op(true) : gen_load_store(false);
+	}
+
+	prog[num_ops-2] = jtype(2, CODE_BASE + num_ops*4);
+	prog[num_ops-1] = 0;
+
+	// No branches in delay slots
+	for (int i = 0; i < num_ops-1; ++i)
+		if (is_branch_or_jump(prog[i]) && is_branch_or_jump(prog[i+1]))
+			prog[i+1] = 0;
+}
+
+static void init_state()
+{
+	static const u32 interesting[] = { 0, 1, 0xffffffff, 0x80000000, 0x7fffffff,
+	                                   31, 32, 0x1234, 0xffff8000 };
+	memset(&psxRegs, 0, sizeof(psxRegs));
+	for (int i = 1; i < 32; ++i)
+		psxRegs.GPR.r[i] = rnd_below(3) ? interesting[rnd_below(9)] : rnd();
+	psxRegs.GPR.r[REG_RAM_BASE] = DATA_BASE + (rnd_below(0x100) & ~3);
+	psxRegs.GPR.r[REG_SCRATCH_BASE] = 0x1f800000;
+	psxRegs.GPR.r[REG_HW_BASE] = 0x1f801000;
+	psxRegs.GPR.n.lo = rnd();
+	psxRegs.GPR.n.hi = rnd();
+	psxRegs.CP0.n.Status = rnd() & ~0x401;  // IRQs off, MTC0 never raises one
+	for (int i = 0; i < 32; ++i)
+		psxRegs.CP2D.r[i] = rnd() & 0xffff;
+	psxRegs.pc = CODE_BASE;
+	psxRegs.io_cycle_counter = 0x7fffffff;
+
+	memset(psxM, 0, 0x200000);
+	for (int i = 0; i < 0x2000; ++i)
+		((u32*)psxM)[(DATA_BASE & 0x1fffff)/4 + i] = rnd();
+	for (int i = 0x1000/4; i < 0x2000/4; ++i)
+		((u32*)psxM)[i] = rnd();
+	for (int i = 0; i < 0x10000/4; ++i)
+		((u32*)psxH)[i] = rnd();
+	memcpy(psxM + (CODE_BASE & 0x1fffff), prog, num_ops * 4);
+}
+
+static u8 init_ram[0x200000], init_h[0x10000];
+static psxRegisters init_regs;
+static u8 int_ram[0x200000], int_h[0x10000];
+static psxRegisters int_regs;
+
+// Returns false if results differ
+static bool run_program(int it, R3000Acpu *rec_cpu, bool lockstep)
+{
+	init_state();
+	memcpy(init_ram, psxM, sizeof(init_ram));
+	memcpy(init_h, psxH, sizeof(init_h));
+	init_regs = psxRegs;
+	const u32 end_pc = CODE_BASE + num_ops*4;
+
+	psxCpu = &psxInt;
+	num_hw_reads = num_hw_writes = 0;
+	psxInt.ExecuteBlock(end_pc);
+	memcpy(int_ram, psxM, sizeof(int_ram));
+	memcpy(int_h, psxH, sizeof(int_h));
+	int_regs = psxRegs;
+	const int int_hw_reads = num_hw_reads, int_hw_writes = num_hw_writes;
+
+	memcpy(psxM, init_ram, sizeof(init_ram));
+	memcpy(psxH, init_h, sizeof(init_h));
+	psxRegs = init_regs;
+	psxCpu = rec_cpu;
+	rec_cpu->Reset();
+	num_hw_reads = num_hw_writes = 0;
+	rec_cpu->ExecuteBlock(end_pc);
+
+	bool ok = true;
+	for (int i = 0; i < 34; ++i) {
+		if (psxRegs.GPR.r[i] != int_regs.GPR.r[i]) {
+			printf("program %d: r%d rec %08x int %08x\n", it, i, psxRegs.GPR.r[i], int_regs.GPR.r[i]);
+			ok = false;
+		}
+	}
+	if (memcmp(&psxRegs.CP0, &int_regs.CP0, sizeof(int_regs.CP0))) {
+		printf("program %d: CP0 differs\n", it);
+		ok = false;
+	}
+	if (memcmp(&psxRegs.CP2D, &int_regs.CP2D, sizeof(int_regs.CP2D)) ||
+	    memcmp(&psxRegs.CP2C, &int_regs.CP2C, sizeof(int_regs.CP2C))) {
+		printf("program %d: CP2 differs\n", it);
+		ok = false;
+	}
+	if (psxRegs.cycle != int_regs.cycle) {
+		printf("program %d: cycle rec %u int %u\n", it, psxRegs.cycle, int_regs.cycle);
+		ok = false;
+	}
+	if (psxRegs.pc != int_regs.pc) {
+		printf("program %d: pc rec %08x int %08x\n", it, psxRegs.pc, int_regs.pc);
+		ok = false;
+	}
+	if (memcmp(psxM, int_ram, sizeof(int_ram))) {
+		printf("program %d: RAM differs\n", it);
+		ok = false;
+	}
+	if (memcmp(psxH, int_h, sizeof(int_h))) {
+		printf("program %d: scratchpad/HW regs differ\n", it);
+		ok = false;
+	}
+	// Lockstep checker runs blocks with HW I/O on the recompiler only,
+	//  after psxInt tried them, so counts only match without it
+	if (!lockstep && (num_hw_reads != int_hw_reads || num_hw_writes != int_hw_writes)) {
+		printf("program %d: HW reads/writes rec %d/%d int %d/%d\n", it,
+		       num_hw_reads, num_hw_writes, int_hw_reads, int_hw_writes);
+		ok = false;
+	}
+
+	if (!ok) {
+		printf("program %d (%d ops at %08x):\n", it, num_ops, CODE_BASE);
+		for (int i = 0; i < num_ops; ++i)
+			printf("  %08x: %08x\n", CODE_BASE + i*4, prog[i]);
+	}
+	return ok;
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = 1000;
+	bool lockstep = false;
+
+	for (int i=1; i < argc; ++i) {
+		if (strcmp(argv[i], "-lockstep") == 0) {
+			lockstep = true;
+		} else if (argv[i][0] != '-' && atoi(argv[i]) > 0) {
+			iterations = atoi(argv[i]);
+		} else {
+			printf("Usage: %s [-lockstep] [iterations]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	psxM = (s8*)calloc(1, 0x200000);
+	psxH = (s8*)calloc(1, 0x10000);
+	psxR = (s8*)calloc(1, 0x80000);
+	psxMemRLUT = (u8**)calloc(0x10000, sizeof(u8*));
+	for (int i = 0; i < 0x80; i++)
+		psxMemRLUT[i] = (u8*)psxM + ((i & 0x1f) << 16);
+	memcpy(&psxMemRLUT[0x8000], psxMemRLUT, 0x80 * sizeof(u8*));
+	memcpy(&psxMemRLUT[0xa000], psxMemRLUT, 0x80 * sizeof(u8*));
+	psxMemRLUT[0x1f80] = (u8*)psxH;
+
+	if (lockstep)
+		psxLockstepEnable();
+	R3000Acpu *rec_cpu = lockstep ? &psxLockstep : &psxRec;
+	psxInt.Init();
+	rec_cpu->Init();
+
+	int num_failed = 0;
+	for (int it = 0; it < iterations && num_failed < 5; ++it) {
+		gen_program();
+		if (!run_program(it, rec_cpu, lockstep))
+			num_failed++;
+	}
+
+	rec_cpu->Shutdown();
+	printf("%d programs, %d failed\n", iterations, num_failed);
+	return num_failed != 0;
+}
@@ -0,0 +1,1660 @@
+/*
+ * Mips-to-x86_64 recompiler for pcsx4all
+ *
+ * Copyright (c) 2018 PCSX4ALL Team
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#include <stddef.h>
+#include <sys/mman.h>
+#include "plugin_lib.h"
+#include "psxcommon.h"
+#include "psxhle.h"
+#include "psxmem.h"
+#include "psxhw.h"
+#include "r3000a.h"
+#include "gte.h"
+
+/* Standard console logging */
+#define REC_LOG(...) printf("x86_64rec: " __VA_ARGS__)
+#ifndef REC_LOG
+#define REC_LOG(...)
+#endif
+
+/* Loads/stores emit an inline PS1 RAM access, calling psxMemRead*() or
+ *  psxMemWrite*() only when address is outside RAM: */
+#define USE_DIRECT_MEM_ACCESS
+
+/* Loads/stores whose address is a known const access RAM or scratchpad
+ *  directly, or call psxHwRead*(),psxHwWrite*() directly for HW I/O.
+ *  (Same idea as rec_lsu_hw.cpp.h in MIPS recompiler) */
+#define USE_CONST_ADDRESSES
+
+#include "x86_64_codegen.h"
+
+/* Interpreter, used for ops this recompiler doesn't emit code for */
+extern void (*psxBSC[64])(void);
+extern void execI();
+extern void MTC0(int reg, u32 val);
+extern u32 LWL_MASK[4], LWL_SHIFT[4], LWR_MASK[4], LWR_SHIFT[4];
+extern u32 SWL_MASK[4], SWL_SHIFT[4], SWR_MASK[4], SWR_SHIFT[4];
+
+#define RECMEM_SIZE_MIN     (2*1024*1024)
+#define RECMEM_SIZE_DEFAULT (8*1024*1024)
+#define RECMEM_SIZE_LIMIT   (16*1024*1024)
+#define RECMEM_SLACK        (256*1024)   /* Room kept free for next block */
+#define REC_MAX_BLOCK_OPS   128          /* Longer blocks are split */
+
+u32 rec_mem_size_mb = RECMEM_SIZE_DEFAULT / (1024*1024);
+static u32 rec_mem_size;           /* Bytes of recMemBase[] in use, set in recInit() */
+static u8 *recMemBase;             /* mmap'd RWX code buffer */
+static u8 *recMemCode;             /* First byte past block-entry trampoline */
+
+u8         *recMem;                /* Where does next emitted opcode in block go? */
+static u8  *recMemStart;           /* Where did first emitted opcode in block go? */
+static u32 pc;                     /* Recompiler pc */
+static u32 oldpc;                  /* Recompiler pc at start of block */
+u32 cycle_multiplier = 0x200;      /* Cycle advance per emulated instruction
+                                      (0x100 = 1.0, 0x200 = 2.0 (default)) */
+static bool end_block;             /* Has recompilation phase ended? */
+static int rec_exec_depth;         /* Blocks currently executing, >1 when HLE
+                                      BIOS re-enters recExecuteBlock() */
+
+/* Block entry trampoline, emitted at start of code buffer. Saves callee-saved
+ *  host regs, loads the ones blocks expect to hold perm values, calls block.
+ */
+typedef void (*rec_enter_func)(const u8 *code, psxRegisters *regs, s8 *ram, u8 *regions);
+static rec_enter_func rec_enter;
+
+#define REC_RAM_SIZE (0x200000 / 4 * sizeof(u8 *))
+#define REC_ROM_SIZE (0x80000 / 4 * sizeof(u8 *))
+static u8 **recRAM;
+static u8 **recROM;
+static u8 **psxRecLUT[0x10000];
+
+extern void (*recBSC[64])();
+
+#define PC_REC(x) (psxRecLUT[(x) >> 16] + (((x) & 0xffff) >> 2))
+
+static void recReset();
+
+///////////////////////////////////////////////////////////////////////////////
+// -BEGIN- Code block tracking
+///////////////////////////////////////////////////////////////////////////////
+/* Same scheme as MIPS recompiler, minus the block linking: blocks in RAM are
+ *  kept in per-page lists so stores and DMA invalidate only blocks they hit.
+ *  code_regions[] holds a nonzero byte for each 256-byte region of RAM that
+ *  some block was recompiled from. Emitted stores check it before calling
+ *  recInvalidateWord(), so stores to data never leave emitted code.
+ */
+#define REC_PAGE_SHIFT     12
+#define REC_NUM_PAGES      (0x200000 >> REC_PAGE_SHIFT)
+#define REC_REGION_SHIFT   8
+#define REC_NUM_REGIONS    (0x200000 >> REC_REGION_SHIFT)
+#define REC_MAX_BLOCKS     (32*1024)
+#define REC_MAX_PAGE_LINKS (REC_MAX_BLOCKS*2)
+#define REC_NIL            0xffffffff
+
+static u8 code_regions[REC_NUM_REGIONS];
+
+typedef struct {
+	u32 start;         /* Masked RAM address of first PS1 opcode in block */
+	u32 end;           /* Masked RAM address just past last PS1 opcode */
+	u32 next_free;     /* Link in free list, when entry is unused */
+} rec_block;
+
+typedef struct {
+	u32 block;         /* Index of block overlapping the page */
+	u32 next;          /* Next link in page's list, or in free list */
+} rec_page_link;
+
+static struct {
+	rec_block     blocks[REC_MAX_BLOCKS];
+	rec_page_link links[REC_MAX_PAGE_LINKS];
+	u32 page_head[REC_NUM_PAGES];   /* First link in each page's list */
+	u32 free_block;
+	u32 free_link;
+	u32 num_free_links;
+} rec_blocks;
+
+static void rec_blocks_reset()
+{
+	for (u32 i = 0; i < REC_NUM_PAGES; ++i)
+		rec_blocks.page_head[i] = REC_NIL;
+
+	for (u32 i = 0; i < REC_MAX_BLOCKS; ++i)
+		rec_blocks.blocks[i].next_free = i+1;
+	rec_blocks.blocks[REC_MAX_BLOCKS-1].next_free = REC_NIL;
+	rec_blocks.free_block = 0;
+
+	for (u32 i = 0; i < REC_MAX_PAGE_LINKS; ++i)
+		rec_blocks.links[i].next = i+1;
+	rec_blocks.links[REC_MAX_PAGE_LINKS-1].next = REC_NIL;
+	rec_blocks.free_link = 0;
+	rec_blocks.num_free_links = REC_MAX_PAGE_LINKS;
+
+	memset(code_regions, 0, sizeof(code_regions));
+}
+
+/* Returns true if tracking tables can't be trusted to hold another block.
+ *  Blocks are split at REC_MAX_BLOCK_OPS opcodes, so never span more than
+ *  two pages.
+ */
+static bool rec_blocks_full()
+{
+	return rec_blocks.free_block == REC_NIL || rec_blocks.num_free_links < 2;
+}
+
+/* Set code_regions[] bytes of a page from blocks still in its list */
+static void rec_page_update_regions(u32 page)
+{
+	const u32 page_start = page << REC_PAGE_SHIFT;
+	const u32 page_end = page_start + (1 << REC_PAGE_SHIFT);
+
+	memset(&code_regions[page_start >> REC_REGION_SHIFT], 0,
+	       1 << (REC_PAGE_SHIFT - REC_REGION_SHIFT));
+
+	for (u32 l = rec_blocks.page_head[page]; l != REC_NIL; l = rec_blocks.links[l].next) {
+		const rec_block *b = &rec_blocks.blocks[rec_blocks.links[l].block];
+		u32 start = b->start > page_start ? b->start : page_start;
+		u32 end = b->end < page_end ? b->end : page_end;
+		for (u32 r = start >> REC_REGION_SHIFT; r <= (end-1) >> REC_REGION_SHIFT; ++r)
+			code_regions[r] = 1;
+	}
+}
+
+/* Record block recompiled from PS1 RAM code in [start_pc, end_pc) */
+static void rec_block_add(u32 start_pc, u32 end_pc)
+{
+	const u32 start = start_pc & 0x1ffffc;
+	u32 end = start + (end_pc - start_pc);
+	if (end > 0x200000)
+		end = 0x200000;
+
+	const u32 idx = rec_blocks.free_block;
+	rec_block *b = &rec_blocks.blocks[idx];
+	rec_blocks.free_block = b->next_free;
+	b->start = start;
+	b->end = end;
+
+	const u32 first_page = start >> REC_PAGE_SHIFT;
+	const u32 last_page = (end-1) >> REC_PAGE_SHIFT;
+	for (u32 page = first_page; page <= last_page; ++page) {
+		const u32 l = rec_blocks.free_link;
+		rec_blocks.free_link = rec_blocks.links[l].next;
+		rec_blocks.num_free_links--;
+		rec_blocks.links[l].block = idx;
+		rec_blocks.links[l].next = rec_blocks.page_head[page];
+		rec_blocks.page_head[page] = l;
+	}
+
+	for (u32 r = start >> REC_REGION_SHIFT; r <= (end-1) >> REC_REGION_SHIFT; ++r)
+		code_regions[r] = 1;
+}
+
+/* Invalidate a block: clear its code ptr and remove it from all page lists */
+static void rec_block_invalidate(u32 idx)
+{
+	rec_block *b = &rec_blocks.blocks[idx];
+
+	recRAM[b->start >> 2] = NULL;
+
+	const u32 first_page = b->start >> REC_PAGE_SHIFT;
+	const u32 last_page = (b->end-1) >> REC_PAGE_SHIFT;
+
+	for (u32 page = first_page; page <= last_page; ++page) {
+		u32 *prev_next = &rec_blocks.page_head[page];
+		for (u32 l = *prev_next; l != REC_NIL; l = *prev_next) {
+			if (rec_blocks.links[l].block == idx) {
+				*prev_next = rec_blocks.links[l].next;
+				rec_blocks.links[l].next = rec_blocks.free_link;
+				rec_blocks.free_link = l;
+				rec_blocks.num_free_links++;
+				break;
+			}
+			prev_next = &rec_blocks.links[l].next;
+		}
+	}
+
+	b->next_free = rec_blocks.free_block;
+	rec_blocks.free_block = idx;
+}
+
+/* Invalidate all blocks whose code overlaps masked RAM range [start, end) */
+static void rec_invalidate_range(u32 start, u32 end)
+{
+	if (end > 0x200000)
+		end = 0x200000;
+	if (start >= end)
+		return;
+
+	const u32 first_page = start >> REC_PAGE_SHIFT;
+	const u32 last_page = (end-1) >> REC_PAGE_SHIFT;
+
+	for (u32 page = first_page; page <= last_page; ++page) {
+		bool changed = false;
+		u32 l = rec_blocks.page_head[page];
+		while (l != REC_NIL) {
+			// Invalidation only unlinks this block's own link in this page
+			const u32 next = rec_blocks.links[l].next;
+			const u32 idx = rec_blocks.links[l].block;
+			const rec_block *b = &rec_blocks.blocks[idx];
+			if (b->start < end && b->end > start) {
+				// Block can span pages, so update all their regions
+				const u32 b_first_page = b->start >> REC_PAGE_SHIFT;
+				const u32 b_last_page = (b->end-1) >> REC_PAGE_SHIFT;
+				rec_block_invalidate(idx);
+				for (u32 p = b_first_page; p <= b_last_page; ++p) {
+					if (p != page)
+						rec_page_update_regions(p);
+				}
+				changed = true;
+			}
+			l = next;
+		}
+		if (changed)
+			rec_page_update_regions(page);
+	}
+}
+
+/* Called from emitted code after a store to masked RAM address 'addr'
+ *  when code_regions[] showed it hit a region containing code.
+ */
+static void recInvalidateWord(u32 addr)
+{
+	addr &= 0x1ffffc;
+	rec_invalidate_range(addr, addr + 4);
+}
+///////////////////////////////////////////////////////////////////////////////
+// -END- Code block tracking
+///////////////////////////////////////////////////////////////////////////////
+
+
+///////////////////////////////////////////////////////////////////////////////
+// -BEGIN- Register cache
+///////////////////////////////////////////////////////////////////////////////
+/* PS1 GPRs, plus LO,HI (32,33), are cached in host regs from host_pool[]
+ *  for the length of a block, with consts propagated at compile time.
+ *  A value only gets written back to psxRegs when its host reg is needed
+ *  for something else, or when the block ends or calls into C code that
+ *  might read PS1 regs.
+ */
+#define REG_LO   32
+#define REG_HI   33
+#define REG_NUM  34
+
+static const int host_pool[] = {
+	X86REG_RBP, X86REG_R12, X86REG_R13,                 // Callee-saved
+	X86REG_R8, X86REG_R9, X86REG_R10, X86REG_R11        // Caller-saved
+};
+#define HOST_POOL_SIZE ((int)(sizeof(host_pool) / sizeof(host_pool[0])))
+
+static struct {
+	s8   host;         /* Host reg holding value, or -1 */
+	bool is_const;     /* Value is known at compile time? */
+	bool dirty;        /* Value in psxRegs is stale? */
+	u32  constval;
+} iRegs[REG_NUM];
+
+static struct {
+	s8   psxreg;       /* PS1 reg held, or -1 */
+	bool locked;       /* In use by opcode being recompiled */
+	u32  age;          /* For LRU replacement */
+} hostRegs[16];
+
+static u32 reg_age;
+
+static void regReset()
+{
+	for (int i = 0; i < REG_NUM; ++i) {
+		iRegs[i].host = -1;
+		iRegs[i].is_const = false;
+		iRegs[i].dirty = false;
+	}
+	iRegs[0].is_const = true;
+	iRegs[0].constval = 0;
+
+	for (int i = 0; i < 16; ++i) {
+		hostRegs[i].psxreg = -1;
+		hostRegs[i].locked = false;
+	}
+	reg_age = 0;
+}
+
+static inline bool IsConst(int reg)  { return iRegs[reg].is_const; }
+static inline u32  GetConst(int reg) { return iRegs[reg].constval; }
+
+/* Write value of PS1 reg back to psxRegs, if stale there */
+static void regWriteBack(int reg)
+{
+	if (!iRegs[reg].dirty)
+		return;
+
+	if (iRegs[reg].host >= 0)
+		MOV32_MR(PERM_REG_1, offGPR(reg), iRegs[reg].host);
+	else
+		MOV32_MI(PERM_REG_1, offGPR(reg), iRegs[reg].constval);
+	iRegs[reg].dirty = false;
+}
+
+static void regUnmapHost(int host)
+{
+	const int reg = hostRegs[host].psxreg;
+	if (reg < 0)
+		return;
+
+	regWriteBack(reg);
+	iRegs[reg].host = -1;
+	hostRegs[host].psxreg = -1;
+}
+
+/* Get a free host reg, evicting the least-recently used one if needed */
+static int regAllocHost()
+{
+	int best = -1;
+	for (int i = 0; i < HOST_POOL_SIZE; ++i) {
+		const int h = host_pool[i];
+		if (hostRegs[h].locked)
+			continue;
+		if (hostRegs[h].psxreg < 0) {
+			best = h;
+			break;
+		}
+		if (best < 0 || hostRegs[h].age < hostRegs[best].age)
+			best = h;
+	}
+
+	// No opcode locks more than four host regs at once
+	regUnmapHost(best);
+	return best;
+}
+
+static inline void regTouch(int host)
+{
+	hostRegs[host].locked = true;
+	hostRegs[host].age = ++reg_age;
+}
+
+/* Returns host reg holding value of PS1 reg, loading it if necessary.
+ *  Host reg stays locked until current opcode is recompiled.
+ */
+static int regRead(int reg)
+{
+	int h = iRegs[reg].host;
+	if (h < 0) {
+		h = regAllocHost();
+		if (iRegs[reg].is_const)
+			MOV32_RI(h, iRegs[reg].constval);
+		else
+			MOV32_RM(h, PERM_REG_1, offGPR(reg));
+		iRegs[reg].host = h;
+		hostRegs[h].psxreg = reg;
+	}
+	regTouch(h);
+	return h;
+}
+
+/* Returns host reg that new value of PS1 reg is to be placed in */
+static int regWrite(int reg)
+{
+	int h = iRegs[reg].host;
+	if (h < 0) {
+		h = regAllocHost();
+		iRegs[reg].host = h;
+		hostRegs[h].psxreg = reg;
+	}
+	regTouch(h);
+	iRegs[reg].is_const = false;
+	iRegs[reg].dirty = true;
+	return h;
+}
+
+static void regSetConst(int reg, u32 val)
+{
+	const int h = iRegs[reg].host;
+	if (h >= 0) {
+		hostRegs[h].psxreg = -1;
+		iRegs[reg].host = -1;
+	}
+	iRegs[reg].is_const = true;
+	iRegs[reg].constval = val;
+	iRegs[reg].dirty = true;
+}
+
+/* Forget PS1 reg's host mapping and const value (after C code wrote it) */
+static void regInvalidate(int reg)
+{
+	const int h = iRegs[reg].host;
+	if (h >= 0) {
+		hostRegs[h].psxreg = -1;
+		iRegs[reg].host = -1;
+	}
+	iRegs[reg].is_const = false;
+	iRegs[reg].dirty = false;
+}
+
+/* Write back all stale values, mappings are kept */
+static void regFlushAll()
+{
+	for (int i = 1; i < REG_NUM; ++i)
+		regWriteBack(i);
+}
+
+/* Forget mappings to caller-saved host regs, after a call to C code.
+ *  Must be preceded by regFlushAll().
+ */
+static void regDropCallerSaved()
+{
+	for (int h = X86REG_R8; h <= X86REG_R11; ++h) {
+		if (hostRegs[h].psxreg >= 0) {
+			iRegs[(int)hostRegs[h].psxreg].host = -1;
+			hostRegs[h].psxreg = -1;
+		}
+	}
+}
+
+static void regUnlockAll()
+{
+	for (int i = 0; i < 16; ++i)
+		hostRegs[i].locked = false;
+}
+
+/* Emitted around calls to C code that doesn't access PS1 regs, on code
+ *  paths that rejoin the main one: values in caller-saved host regs are
+ *  stored to psxRegs and reloaded, without altering regcache state.
+ */
+static void regSaveCallerSaved()
+{
+	for (int h = X86REG_R8; h <= X86REG_R11; ++h) {
+		const int reg = hostRegs[h].psxreg;
+		if (reg >= 0 && iRegs[reg].dirty)
+			MOV32_MR(PERM_REG_1, offGPR(reg), h);
+	}
+}
+
+static void regRestoreCallerSaved()
+{
+	for (int h = X86REG_R8; h <= X86REG_R11; ++h) {
+		const int reg = hostRegs[h].psxreg;
+		if (reg >= 0)
+			MOV32_RM(h, PERM_REG_1, offGPR(reg));
+	}
+}
+
+/* Source operand: either a known const or a (locked) host reg */
+typedef struct {
+	bool is_imm;
+	u32  imm;
+	int  host;
+} RecOpnd;
+
+static RecOpnd regOpnd(int reg)
+{
+	RecOpnd o;
+	if (IsConst(reg)) {
+		o.is_imm = true;
+		o.imm = GetConst(reg);
+		o.host = -1;
+	} else {
+		o.is_imm = false;
+		o.imm = 0;
+		o.host = regRead(reg);
+	}
+	return o;
+}
+
+static void emit_mov_opnd(int dst, const RecOpnd &o)
+{
+	if (o.is_imm)
+		MOV32_RI(dst, o.imm);
+	else
+		MOV32_RR(dst, o.host);
+}
+
+/* 'ext' is group-1 opcode extension (ALU_*), 'opc' its reg,r/m opcode */
+static void emit_alu_opnd(int ext, u8 opc, int dst, const RecOpnd &o)
+{
+	if (o.is_imm)
+		ALU32_RI(ext, dst, o.imm);
+	else
+		emit_op_rr(opc, o.host, dst);
+}
+///////////////////////////////////////////////////////////////////////////////
+// -END- Register cache
+///////////////////////////////////////////////////////////////////////////////
+
+
+/* Add cycles of opcodes recompiled so far to psxRegs.cycle */
+static void rec_emit_cycles()
+{
+	const u32 cycles = ADJUST_CLOCK((pc - oldpc) / 4);
+	if (cycles)
+		ALU32_MI(ALU_ADD, PERM_REG_1, off(cycle), cycles);
+}
+
+/* End block, with next PC a known const */
+static void rec_emit_exit_const(u32 target_pc)
+{
+	regFlushAll();
+	MOV32_MI(PERM_REG_1, off(pc), target_pc);
+	rec_emit_cycles();
+	RET();
+	end_block = true;
+}
+
+/* End block after C code has set psxRegs.pc. Caller must have flushed
+ *  all regs before calling the C code.
+ */
+static void rec_emit_exit_dynamic()
+{
+	rec_emit_cycles();
+	RET();
+	end_block = true;
+}
+
+/* Let interpreter execute current opcode, which can't be a branch */
+static void rec_emit_interp_op()
+{
+	regFlushAll();
+	MOV32_MI(PERM_REG_1, off(code), psxRegs.code);
+	MOV32_MI(PERM_REG_1, off(pc), pc);
+	CALL_FUNC((void *)psxBSC[psxRegs.code >> 26]);
+	regDropCallerSaved();
+}
+
+/* Let interpreter execute current branch and its BD slot, ending block */
+static void rec_emit_interp_branch()
+{
+	regFlushAll();
+	rec_emit_cycles();
+	MOV32_MI(PERM_REG_1, off(code), psxRegs.code);
+	MOV32_MI(PERM_REG_1, off(pc), pc);
+	CALL_FUNC((void *)psxBSC[psxRegs.code >> 26]);
+	RET();
+	end_block = true;
+}
+
+
+/*** ALU ***/
+
+static void recNULL() {}
+
+static void recLUI()
+{
+	if (!_Rt_) return;
+	regSetConst(_Rt_, psxRegs.code << 16);
+}
+
+/* ADDI,ADDIU,SLTI,SLTIU,ANDI,ORI,XORI */
+static void recImmALU()
+{
+	const int rt = _Rt_, rs = _Rs_;
+	const u32 op = _Op_;
+	if (!rt) return;
+
+	const u32 imm = (op >= 0x0c) ? (u32)_ImmU_ : (u32)(s32)_Imm_;
+
+	if (IsConst(rs)) {
+		const u32 a = GetConst(rs);
+		u32 res;
+		switch (op) {
+			case 0x0a: res = (s32)a < (s32)imm; break;
+			case 0x0b: res = a < imm;           break;
+			case 0x0c: res = a & imm;           break;
+			case 0x0d: res = a | imm;           break;
+			case 0x0e: res = a ^ imm;           break;
+			default:   res = a + imm;           break;
+		}
+		regSetConst(rt, res);
+		return;
+	}
+
+	const int hs = regRead(rs);
+	MOV32_RR(TEMP_0, hs);
+	switch (op) {
+		case 0x0a: CMP32_RI(TEMP_0, imm); SETCC(CC_L, TEMP_0); MOVZX8_RR(TEMP_0, TEMP_0); break;
+		case 0x0b: CMP32_RI(TEMP_0, imm); SETCC(CC_B, TEMP_0); MOVZX8_RR(TEMP_0, TEMP_0); break;
+		case 0x0c: AND32_RI(TEMP_0, imm); break;
+		case 0x0d: OR32_RI(TEMP_0, imm);  break;
+		case 0x0e: XOR32_RI(TEMP_0, imm); break;
+		default:   if (imm) ADD32_RI(TEMP_0, imm); break;
+	}
+	const int ht = regWrite(rt);
+	MOV32_RR(ht, TEMP_0);
+}
+
+/* ADD,ADDU,SUB,SUBU,AND,OR,XOR,NOR,SLT,SLTU */
+static void recRegALU()
+{
+	const int rd = _Rd_, rs = _Rs_, rt = _Rt_;
+	const u32 funct = _Funct_;
+	if (!rd) return;
+
+	if (IsConst(rs) && IsConst(rt)) {
+		const u32 a = GetConst(rs), b = GetConst(rt);
+		u32 res;
+		switch (funct) {
+			case 0x22: case 0x23: res = a - b;             break;
+			case 0x24:            res = a & b;             break;
+			case 0x25:            res = a | b;             break;
+			case 0x26:            res = a ^ b;             break;
+			case 0x27:            res = ~(a | b);          break;
+			case 0x2a:            res = (s32)a < (s32)b;   break;
+			case 0x2b:            res = a < b;             break;
+			default:              res = a + b;             break;
+		}
+		regSetConst(rd, res);
+		return;
+	}
+
+	const RecOpnd a = regOpnd(rs);
+	const RecOpnd b = regOpnd(rt);
+	emit_mov_opnd(TEMP_0, a);
+	switch (funct) {
+		case 0x22: case 0x23: emit_alu_opnd(ALU_SUB, 0x29, TEMP_0, b); break;
+		case 0x24:            emit_alu_opnd(ALU_AND, 0x21, TEMP_0, b); break;
+		case 0x25:            emit_alu_opnd(ALU_OR,  0x09, TEMP_0, b); break;
+		case 0x26:            emit_alu_opnd(ALU_XOR, 0x31, TEMP_0, b); break;
+		case 0x27:            emit_alu_opnd(ALU_OR,  0x09, TEMP_0, b); NOT32(TEMP_0); break;
+		case 0x2a: case 0x2b:
+			emit_alu_opnd(ALU_CMP, 0x39, TEMP_0, b);
+			SETCC(funct == 0x2a ? CC_L : CC_B, TEMP_0);
+			MOVZX8_RR(TEMP_0, TEMP_0);
+			break;
+		default:              emit_alu_opnd(ALU_ADD, 0x01, TEMP_0, b); break;
+	}
+	const int hd = regWrite(rd);
+	MOV32_RR(hd, TEMP_0);
+}
+
+/* SLL,SRL,SRA */
+static void recShiftImm()
+{
+	const int rd = _Rd_, rt = _Rt_;
+	const u32 sa = _Sa_, funct = _Funct_;
+	if (!rd) return;
+
+	if (IsConst(rt)) {
+		const u32 a = GetConst(rt);
+		regSetConst(rd, funct == 0x00 ? a << sa :
+		                funct == 0x02 ? a >> sa : (u32)((s32)a >> sa));
+		return;
+	}
+
+	const int ht = regRead(rt);
+	MOV32_RR(TEMP_0, ht);
+	if (sa)
+		SHIFT32_RI(funct == 0x00 ? SHIFT_SHL : funct == 0x02 ? SHIFT_SHR : SHIFT_SAR, TEMP_0, sa);
+	const int hd = regWrite(rd);
+	MOV32_RR(hd, TEMP_0);
+}
+
+/* SLLV,SRLV,SRAV */
+static void recShiftVar()
+{
+	const int rd = _Rd_, rt = _Rt_, rs = _Rs_;
+	const u32 funct = _Funct_;
+	if (!rd) return;
+
+	const int ext = funct == 0x04 ? SHIFT_SHL : funct == 0x06 ? SHIFT_SHR : SHIFT_SAR;
+
+	if (IsConst(rs) && IsConst(rt)) {
+		const u32 a = GetConst(rt), sa = GetConst(rs) & 31;
+		regSetConst(rd, ext == SHIFT_SHL ? a << sa :
+		                ext == SHIFT_SHR ? a >> sa : (u32)((s32)a >> sa));
+		return;
+	}
+
+	const RecOpnd a = regOpnd(rt);
+	if (IsConst(rs)) {
+		emit_mov_opnd(TEMP_0, a);
+		if (GetConst(rs) & 31)
+			SHIFT32_RI(ext, TEMP_0, GetConst(rs) & 31);
+	} else {
+		// x86 also masks shift count in CL to 5 bits
+		const int hs = regRead(rs);
+		MOV32_RR(TEMP_1, hs);
+		emit_mov_opnd(TEMP_0, a);
+		SHIFT32_RCL(ext, TEMP_0);
+	}
+	const int hd = regWrite(rd);
+	MOV32_RR(hd, TEMP_0);
+}
+
+
+/*** Multiply/divide ***/
+
+static void recMULT()
+{
+	const int rs = _Rs_, rt = _Rt_;
+	const bool is_signed = (_Funct_ == 0x18);
+
+	if (IsConst(rs) && IsConst(rt)) {
+		u64 res = is_signed ? (u64)((s64)(s32)GetConst(rs) * (s64)(s32)GetConst(rt))
+		                    : (u64)GetConst(rs) * (u64)GetConst(rt);
+		regSetConst(REG_LO, (u32)res);
+		regSetConst(REG_HI, (u32)(res >> 32));
+		return;
+	}
+
+	const RecOpnd a = regOpnd(rs);
+	const RecOpnd b = regOpnd(rt);
+	if (is_signed) {
+		if (a.is_imm) MOV64_RI(X86REG_RAX, (u64)(s64)(s32)a.imm);
+		else          MOVSXD_RR(X86REG_RAX, a.host);
+		if (b.is_imm) MOV64_RI(X86REG_RCX, (u64)(s64)(s32)b.imm);
+		else          MOVSXD_RR(X86REG_RCX, b.host);
+	} else {
+		// 32-bit moves zero-extend
+		emit_mov_opnd(TEMP_0, a);
+		emit_mov_opnd(TEMP_1, b);
+	}
+	IMUL64_RR(X86REG_RAX, X86REG_RCX);
+
+	const int hlo = regWrite(REG_LO);
+	MOV32_RR(hlo, TEMP_0);
+	SHR64_RI(X86REG_RAX, 32);
+	const int hhi = regWrite(REG_HI);
+	MOV32_RR(hhi, TEMP_0);
+}
+
+/* Division by zero and 0x80000000 / -1 give the same results as on
+ *  a real R3000A, without raising a host exception.
+ */
+static void recDIV()
+{
+	const int rs = _Rs_, rt = _Rt_;
+	const bool is_signed = (_Funct_ == 0x1a);
+
+	if (IsConst(rs) && IsConst(rt)) {
+		const u32 a = GetConst(rs), b = GetConst(rt);
+		u32 lo, hi;
+		if (b == 0) {
+			lo = (is_signed && (s32)a < 0) ? 1 : 0xffffffff;
+			hi = a;
+		} else if (is_signed && a == 0x80000000 && b == 0xffffffff) {
+			lo = 0x80000000;
+			hi = 0;
+		} else if (is_signed) {
+			lo = (s32)a / (s32)b;
+			hi = (s32)a % (s32)b;
+		} else {
+			lo = a / b;
+			hi = a % b;
+		}
+		regSetConst(REG_LO, lo);
+		regSetConst(REG_HI, hi);
+		return;
+	}
+
+	const RecOpnd a = regOpnd(rs);
+	const RecOpnd b = regOpnd(rt);
+	emit_mov_opnd(TEMP_0, a);
+	emit_mov_opnd(TEMP_1, b);
+
+	TEST32_RR(TEMP_1, TEMP_1);
+	u8 *j_div0 = JCC_FWD(CC_E);
+	u8 *j_overflow = NULL;
+	if (is_signed) {
+		CMP32_RI(TEMP_1, 0xffffffff);
+		u8 *j_normal = JCC_FWD(CC_NE);
+		CMP32_RI(TEMP_0, 0x80000000);
+		j_overflow = JCC_FWD(CC_E);
+		fixup_jump(j_normal);
+		CDQ();
+		IDIV32(TEMP_1);
+	} else {
+		XOR32_RR(TEMP_2, TEMP_2);
+		DIV32(TEMP_1);
+	}
+	u8 *j_done = JMP_FWD();
+
+	fixup_jump(j_div0);
+	MOV32_RR(TEMP_2, TEMP_0);         // hi = rs
+	if (is_signed) {
+		SAR32_RI(TEMP_0, 31);         // lo = (rs >= 0) ? -1 : 1
+		NOT32(TEMP_0);
+		OR32_RI(TEMP_0, 1);
+	} else {
+		MOV32_RI(TEMP_0, 0xffffffff);
+	}
+	u8 *j_done2 = NULL;
+	if (is_signed) {
+		j_done2 = JMP_FWD();
+		fixup_jump(j_overflow);
+		MOV32_RI(TEMP_2, 0);          // lo = 0x80000000 (already in eax), hi = 0
+	}
+
+	fixup_jump(j_done);
+	if (j_done2)
+		fixup_jump(j_done2);
+
+	const int hlo = regWrite(REG_LO);
+	MOV32_RR(hlo, TEMP_0);
+	const int hhi = regWrite(REG_HI);
+	MOV32_RR(hhi, TEMP_2);
+}
+
+/* MFHI,MFLO */
+static void recMFHILO()
+{
+	const int rd = _Rd_;
+	const int src = (_Funct_ == 0x10) ? REG_HI : REG_LO;
+	if (!rd) return;
+
+	if (IsConst(src)) {
+		regSetConst(rd, GetConst(src));
+		return;
+	}
+	const int hs = regRead(src);
+	const int hd = regWrite(rd);
+	MOV32_RR(hd, hs);
+}
+
+/* MTHI,MTLO */
+static void recMTHILO()
+{
+	const int rs = _Rs_;
+	const int dst = (_Funct_ == 0x11) ? REG_HI : REG_LO;
+
+	if (IsConst(rs)) {
+		regSetConst(dst, GetConst(rs));
+		return;
+	}
+	const int hs = regRead(rs);
+	const int hd = regWrite(dst);
+	MOV32_RR(hd, hs);
+}
+
+
+/*** Loads/stores ***/
+
+/* Set TEMP_0 to effective address of current load/store opcode */
+static void rec_emit_address()
+{
+	const int rs = _Rs_;
+	const s32 imm = _Imm_;
+	if (IsConst(rs)) {
+		MOV32_RI(TEMP_0, GetConst(rs) + imm);
+	} else {
+		const int hs = regRead(rs);
+		LEA32(TEMP_0, hs, imm);
+	}
+}
+
+/* Extend value just returned in EAX by C read function into TEMP_1 */
+static void rec_emit_extend_result(int width, bool is_signed)
+{
+	if (width == 8) {
+		if (is_signed) MOVSX8_RR(TEMP_1, TEMP_0);
+		else           MOVZX8_RR(TEMP_1, TEMP_0);
+	} else if (width == 16) {
+		if (is_signed) MOVSX16_RR(TEMP_1, TEMP_0);
+		else           MOVZX16_RR(TEMP_1, TEMP_0);
+	} else {
+		MOV32_RR(TEMP_1, TEMP_0);
+	}
+}
+
+/* Load into TEMP_1 from [base + index + disp] */
+static void rec_emit_load_mem(int width, bool is_signed, int base, int index, s32 disp)
+{
+	if (width == 8) {
+		if (is_signed) MOVSX8_RMX(TEMP_1, base, index, disp);
+		else           MOVZX8_RMX(TEMP_1, base, index, disp);
+	} else if (width == 16) {
+		if (is_signed) MOVSX16_RMX(TEMP_1, base, index, disp);
+		else           MOVZX16_RMX(TEMP_1, base, index, disp);
+	} else {
+		MOV32_RMX(TEMP_1, base, index, disp);
+	}
+}
+
+/* Store TEMP_2 to [base + index + disp] */
+static void rec_emit_store_mem(int width, int base, int index, s32 disp)
+{
+	if (width == 8)
+		MOV8_MXR(base, index, disp, TEMP_2);
+	else if (width == 16)
+		MOV16_MXR(base, index, disp, TEMP_2);
+	else
+		MOV32_MXR(base, index, disp, TEMP_2);
+}
+
+static void *rec_mem_read_func(int width)
+{
+	return width == 8  ? (void *)psxMemRead8 :
+	       width == 16 ? (void *)psxMemRead16 : (void *)psxMemRead32;
+}
+
+static void *rec_mem_write_func(int width)
+{
+	return width == 8  ? (void *)psxMemWrite8 :
+	       width == 16 ? (void *)psxMemWrite16 : (void *)psxMemWrite32;
+}
+
+/* Set ARG_2 to store value in TEMP_2, zero-extended like C code expects */
+static void rec_emit_store_arg(int width)
+{
+	if (width == 8)       MOVZX8_RR(ARG_2, TEMP_2);
+	else if (width == 16) MOVZX16_RR(ARG_2, TEMP_2);
+	else                  MOV32_RR(ARG_2, TEMP_2);
+}
+
+#ifdef USE_CONST_ADDRESSES
+/* Load from known-const address into TEMP_1 */
+static void rec_emit_load_const(int width, bool is_signed, u32 addr)
+{
+	const u32 t = addr >> 16, m = addr & 0xffff;
+
+	if (!(addr & 0x08000000)) {
+		rec_emit_load_mem(width, is_signed, PERM_REG_PSXM, -1, addr & 0x1fffff);
+	} else if ((t == 0x1f80 || t == 0x9f80 || t == 0xbf80) && m < 0x400) {
+		MOV64_RI(TEMP_1, (u64)(uptr)&psxH[m]);
+		rec_emit_load_mem(width, is_signed, TEMP_1, -1, 0);
+	} else {
+		const bool hw = (t == 0x1f80 || t == 0x9f80 || t == 0xbf80);
+		regSaveCallerSaved();
+		MOV32_RI(ARG_1, addr);
+		if (hw)
+			CALL_FUNC(width == 8  ? (void *)psxHwRead8 :
+			          width == 16 ? (void *)psxHwRead16 : (void *)psxHwRead32);
+		else
+			CALL_FUNC(rec_mem_read_func(width));
+		rec_emit_extend_result(width, is_signed);
+		regRestoreCallerSaved();
+	}
+}
+
+/* Store TEMP_2 to known-const address */
+static void rec_emit_store_const(int width, u32 addr)
+{
+	const u32 t = addr >> 16, m = addr & 0xffff;
+
+	if (!(addr & 0x08000000)) {
+		const u32 ram_addr = addr & 0x1fffff;
+		rec_emit_store_mem(width, PERM_REG_PSXM, -1, ram_addr);
+		CMP8_MXI(PERM_REG_REGIONS, -1, ram_addr >> REC_REGION_SHIFT, 0);
+		u8 *j_done = JCC_FWD(CC_E);
+		regSaveCallerSaved();
+		MOV32_RI(ARG_1, ram_addr);
+		CALL_FUNC((void *)recInvalidateWord);
+		regRestoreCallerSaved();
+		fixup_jump(j_done);
+	} else if ((t == 0x1f80 || t == 0x9f80 || t == 0xbf80) && m < 0x400) {
+		MOV64_RI(TEMP_1, (u64)(uptr)&psxH[m]);
+		rec_emit_store_mem(width, TEMP_1, -1, 0);
+	} else {
+		const bool hw = (t == 0x1f80 || t == 0x9f80 || t == 0xbf80);
+		regSaveCallerSaved();
+		rec_emit_store_arg(width);
+		MOV32_RI(ARG_1, addr);
+		if (hw)
+			CALL_FUNC(width == 8  ? (void *)psxHwWrite8 :
+			          width == 16 ? (void *)psxHwWrite16 : (void *)psxHwWrite32);
+		else
+			CALL_FUNC(rec_mem_write_func(width));
+		regRestoreCallerSaved();
+	}
+}
+#endif // USE_CONST_ADDRESSES
+
+/* LB,LBU,LH,LHU,LW */
+static void recLoad()
+{
+	const int rt = _Rt_;
+	const u32 op = _Op_;
+	const int width = (op == 0x20 || op == 0x24) ? 8 : (op == 0x21 || op == 0x25) ? 16 : 32;
+	const bool is_signed = (op == 0x20 || op == 0x21);
+
+#ifdef USE_CONST_ADDRESSES
+	if (IsConst(_Rs_)) {
+		rec_emit_load_const(width, is_signed, GetConst(_Rs_) + _Imm_);
+	} else
+#endif
+	{
+		rec_emit_address();
+#ifdef USE_DIRECT_MEM_ACCESS
+		// For the range check, bit 27 set means address isn't in RAM
+		TEST32_RI(TEMP_0, 0x08000000);
+		u8 *j_slow = JCC_FWD(CC_NE);
+		AND32_RI(TEMP_0, 0x1fffff);
+		rec_emit_load_mem(width, is_signed, PERM_REG_PSXM, TEMP_0, 0);
+		u8 *j_done = JMP_FWD();
+		fixup_jump(j_slow);
+#endif
+		regSaveCallerSaved();
+		MOV32_RR(ARG_1, TEMP_0);
+		CALL_FUNC(rec_mem_read_func(width));
+		rec_emit_extend_result(width, is_signed);
+		regRestoreCallerSaved();
+#ifdef USE_DIRECT_MEM_ACCESS
+		fixup_jump(j_done);
+#endif
+	}
+
+	// Load is done even for $zero, in case it has side effects
+	if (rt) {
+		const int ht = regWrite(rt);
+		MOV32_RR(ht, TEMP_1);
+	}
+}
+
+/* SB,SH,SW */
+static void recStore()
+{
+	const u32 op = _Op_;
+	const int width = (op == 0x28) ? 8 : (op == 0x29) ? 16 : 32;
+
+	const RecOpnd v = regOpnd(_Rt_);
+	emit_mov_opnd(TEMP_2, v);
+
+#ifdef USE_CONST_ADDRESSES
+	if (IsConst(_Rs_)) {
+		rec_emit_store_const(width, GetConst(_Rs_) + _Imm_);
+		return;
+	}
+#endif
+
+	rec_emit_address();
+#ifdef USE_DIRECT_MEM_ACCESS
+	TEST32_RI(TEMP_0, 0x08000000);
+	u8 *j_slow = JCC_FWD(CC_NE);
+	AND32_RI(TEMP_0, 0x1fffff);
+	rec_emit_store_mem(width, PERM_REG_PSXM, TEMP_0, 0);
+
+	// Invalidate any code stored to
+	MOV32_RR(TEMP_1, TEMP_0);
+	SHR32_RI(TEMP_1, REC_REGION_SHIFT);
+	CMP8_MXI(PERM_REG_REGIONS, TEMP_1, 0, 0);
+	u8 *j_done = JCC_FWD(CC_E);
+	regSaveCallerSaved();
+	MOV32_RR(ARG_1, TEMP_0);
+	CALL_FUNC((void *)recInvalidateWord);
+	regRestoreCallerSaved();
+	u8 *j_done2 = JMP_FWD();
+	fixup_jump(j_slow);
+#endif
+	regSaveCallerSaved();
+	rec_emit_store_arg(width);
+	MOV32_RR(ARG_1, TEMP_0);
+	CALL_FUNC(rec_mem_write_func(width));
+	regRestoreCallerSaved();
+#ifdef USE_DIRECT_MEM_ACCESS
+	fixup_jump(j_done);
+	fixup_jump(j_done2);
+#endif
+}
+
+/* Unaligned loads/stores are left to these helpers, which use the same
+ *  tables as the interpreter.
+ */
+static u32 rec_LWL(u32 addr, u32 val)
+{
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	return (val & LWL_MASK[shift]) | (mem << LWL_SHIFT[shift]);
+}
+
+static u32 rec_LWR(u32 addr, u32 val)
+{
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	return (val & LWR_MASK[shift]) | (mem >> LWR_SHIFT[shift]);
+}
+
+static void rec_SWL(u32 addr, u32 val)
+{
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	psxMemWrite32(addr & ~3, (val >> SWL_SHIFT[shift]) | (mem & SWL_MASK[shift]));
+}
+
+static void rec_SWR(u32 addr, u32 val)
+{
+	const u32 shift = addr & 3;
+	const u32 mem = psxMemRead32(addr & ~3);
+	psxMemWrite32(addr & ~3, (val << SWR_SHIFT[shift]) | (mem & SWR_MASK[shift]));
+}
+
+/* LWL,LWR,SWL,SWR */
+static void recLoadStoreUnaligned()
+{
+	const int rt = _Rt_;
+	const u32 op = _Op_;
+	void *func = op == 0x22 ? (void *)rec_LWL :
+	             op == 0x26 ? (void *)rec_LWR :
+	             op == 0x2a ? (void *)rec_SWL : (void *)rec_SWR;
+
+	const RecOpnd v = regOpnd(rt);
+	rec_emit_address();
+	regSaveCallerSaved();
+	emit_mov_opnd(ARG_2, v);
+	MOV32_RR(ARG_1, TEMP_0);
+	CALL_FUNC(func);
+	MOV32_RR(TEMP_1, TEMP_0);
+	regRestoreCallerSaved();
+
+	if ((op == 0x22 || op == 0x26) && rt) {
+		const int ht = regWrite(rt);
+		MOV32_RR(ht, TEMP_1);
+	}
+}
+
+
+/*** Branches/jumps ***/
+
+/* Returns true if opcode in BD slot of a branch reading the PS1 regs in
+ *  'branch_reads' mask can be recompiled before the branch itself. Loads
+ *  (load delay slot), branches and COP/special ops are left to interpreter.
+ */
+static bool rec_bd_slot_ok(u32 code, u32 branch_reads)
+{
+	u32 writes = 0;
+	switch (_fOp_(code)) {
+		case 0x00:
+			switch (_fFunct_(code)) {
+				case 0x08: case 0x09: case 0x0c:         // JR,JALR,SYSCALL
+					return false;
+				case 0x11: case 0x13:                    // MTHI,MTLO
+				case 0x18: case 0x19: case 0x1a: case 0x1b:
+				case 0x0d:                               // BREAK
+					break;
+				default:
+					writes = 1 << _fRd_(code);
+					break;
+			}
+			break;
+		case 0x08: case 0x09: case 0x0a: case 0x0b:      // Immediate ALU
+		case 0x0c: case 0x0d: case 0x0e: case 0x0f:
+			writes = 1 << _fRt_(code);
+			break;
+		case 0x28: case 0x29: case 0x2a: case 0x2b: case 0x2e:  // Stores
+			break;
+		default:
+			return false;
+	}
+	return !(writes & branch_reads & ~1);
+}
+
+/* Recompile BD slot opcode of current branch */
+static void rec_recompile_bd_slot()
+{
+	psxRegs.code = OPCODE_AT(pc);
+	pc += 4;
+	recBSC[psxRegs.code >> 26]();
+	regUnlockAll();
+}
+
+/* BEQ,BNE,BLEZ,BGTZ and REGIMM BLTZ,BGEZ */
+static void recBranchCond()
+{
+	const u32 code = psxRegs.code;
+	const int rs = _fRs_(code), rt = _fRt_(code);
+	const u32 op = _fOp_(code);
+	const u32 bpc = pc + _fImm_(code) * 4;
+	const u32 nbpc = pc + 4;
+
+	// For REGIMM, rt field holds the branch type
+	const bool two_regs = (op == 0x04 || op == 0x05);
+	const u32 reads = (1 << rs) | (two_regs ? (1 << rt) : 0);
+	if (!rec_bd_slot_ok(OPCODE_AT(pc), reads)) {
+		rec_emit_interp_branch();
+		return;
+	}
+
+	int cc;
+	switch (op) {
+		case 0x04: cc = CC_E;  break;
+		case 0x05: cc = CC_NE; break;
+		case 0x06: cc = CC_LE; break;
+		case 0x07: cc = CC_G;  break;
+		default:   cc = (rt == 0x00) ? CC_L : CC_GE; break;
+	}
+
+	// BD slot can't change branch operands, so check for const ones now
+	if (IsConst(rs) && (!two_regs || IsConst(rt))) {
+		const s32 a = GetConst(rs);
+		const s32 b = two_regs ? (s32)GetConst(rt) : 0;
+		bool taken;
+		switch (cc) {
+			case CC_E:  taken = (a == b); break;
+			case CC_NE: taken = (a != b); break;
+			case CC_LE: taken = (a <= b); break;
+			case CC_G:  taken = (a >  b); break;
+			case CC_L:  taken = (a <  b); break;
+			default:    taken = (a >= b); break;
+		}
+		rec_recompile_bd_slot();
+		rec_emit_exit_const(taken ? bpc : nbpc);
+		return;
+	}
+
+	rec_recompile_bd_slot();
+	regFlushAll();
+
+	if (two_regs) {
+		int ra = rs, rb = rt;
+		if (IsConst(ra)) {
+			// EQ,NE are symmetric: keep const operand second
+			ra = rt;
+			rb = rs;
+		}
+		const int ha = regRead(ra);
+		const RecOpnd b = regOpnd(rb);
+		emit_alu_opnd(ALU_CMP, 0x39, ha, b);
+	} else {
+		const int ha = regRead(rs);
+		CMP32_RI(ha, 0);
+	}
+
+	MOV32_RI(TEMP_0, nbpc);
+	MOV32_RI(TEMP_1, bpc);
+	CMOV32(cc, TEMP_0, TEMP_1);
+	MOV32_MR(PERM_REG_1, off(pc), TEMP_0);
+	rec_emit_cycles();
+	RET();
+	end_block = true;
+}
+
+static void recREGIMM()
+{
+	// BLTZAL,BGEZAL only link when taken: left to interpreter
+	if (_Rt_ == 0x00 || _Rt_ == 0x01)
+		recBranchCond();
+	else if (_Rt_ == 0x10 || _Rt_ == 0x11)
+		rec_emit_interp_branch();
+}
+
+/* J,JAL */
+static void recJ()
+{
+	const u32 target = (_Target_ << 2) | (pc & 0xf0000000);
+
+	if (!rec_bd_slot_ok(OPCODE_AT(pc), 0)) {
+		rec_emit_interp_branch();
+		return;
+	}
+
+	if (_Op_ == 0x03)
+		regSetConst(31, pc + 4);
+
+	rec_recompile_bd_slot();
+	rec_emit_exit_const(target);
+}
+
+/* JR,JALR */
+static void recJR()
+{
+	const int rs = _Rs_, rd = _Rd_;
+	const bool link = (_Funct_ == 0x09);
+
+	if (!rec_bd_slot_ok(OPCODE_AT(pc), 1 << rs) || (link && rd && rd == rs)) {
+		rec_emit_interp_branch();
+		return;
+	}
+
+	if (link && rd)
+		regSetConst(rd, pc + 4);
+
+	rec_recompile_bd_slot();
+
+	if (IsConst(rs)) {
+		rec_emit_exit_const(GetConst(rs));
+		return;
+	}
+
+	regFlushAll();
+	const int hs = regRead(rs);
+	MOV32_MR(PERM_REG_1, off(pc), hs);
+	rec_emit_cycles();
+	RET();
+	end_block = true;
+}
+
+
+/*** COP0 / exceptions ***/
+
+static void recCOP0()
+{
+	const int rt = _Rt_, rd = _Rd_;
+
+	switch (_Rs_) {
+		case 0x00: case 0x02:     // MFC0,CFC0
+			if (rt) {
+				const int ht = regWrite(rt);
+				MOV32_RM(ht, PERM_REG_1, offCP0(rd));
+			}
+			break;
+
+		case 0x04: case 0x06:     // MTC0,CTC0
+			if (rd == 12 || rd == 13) {
+				// Status,Cause writes can trigger a SW interrupt exception:
+				//  let MTC0() do it, and end block at opcode's successor.
+				const RecOpnd v = regOpnd(rt);
+				regFlushAll();
+				emit_mov_opnd(ARG_2, v);
+				MOV32_RI(ARG_1, rd);
+				MOV32_MI(PERM_REG_1, off(pc), pc);
+				CALL_FUNC((void *)MTC0);
+				rec_emit_exit_dynamic();
+			} else if (IsConst(rt)) {
+				MOV32_MI(PERM_REG_1, offCP0(rd), GetConst(rt));
+			} else {
+				const int ht = regRead(rt);
+				MOV32_MR(PERM_REG_1, offCP0(rd), ht);
+			}
+			break;
+
+		case 0x10:                // RFE
+			MOV32_RM(TEMP_0, PERM_REG_1, off(CP0.n.Status));
+			MOV32_RR(TEMP_1, TEMP_0);
+			AND32_RI(TEMP_0, 0xfffffff0);
+			AND32_RI(TEMP_1, 0x3c);
+			SHR32_RI(TEMP_1, 2);
+			OR32_RR(TEMP_0, TEMP_1);
+			MOV32_MR(PERM_REG_1, off(CP0.n.Status), TEMP_0);
+			// Interrupts might now be enabled: check at end of block
+			MOV32_MI(PERM_REG_1, off(io_cycle_counter), 0);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void recSYSCALL()
+{
+	regFlushAll();
+	MOV32_MI(PERM_REG_1, off(pc), pc - 4);
+	MOV32_RI(ARG_1, 0x20);
+	MOV32_RI(ARG_2, 0);
+	CALL_FUNC((void *)psxException);
+	rec_emit_exit_dynamic();
+}
+
+static void recHLE()
+{
+	regFlushAll();
+	MOV32_MI(PERM_REG_1, off(code), psxRegs.code);
+	MOV32_MI(PERM_REG_1, off(pc), pc);
+	CALL_FUNC((void *)psxHLEt[psxRegs.code & 0x07]);
+	rec_emit_exit_dynamic();
+}
+
+/* COP2,LWC2,SWC2: GTE is left to the interpreter's handlers */
+static void recGTE()
+{
+	rec_emit_interp_op();
+
+	// MFC2,CFC2 write a GPR
+	if (_Op_ == 0x12 && (_Rs_ == 0x00 || _Rs_ == 0x02))
+		regInvalidate(_Rt_);
+}
+
+
+/*** Opcode tables ***/
+
+static void recSPECIAL();
+
+void (*recBSC[64])() = {
+	recSPECIAL, recREGIMM, recJ     , recJ     , recBranchCond, recBranchCond, recBranchCond, recBranchCond,
+	recImmALU , recImmALU, recImmALU, recImmALU, recImmALU    , recImmALU    , recImmALU    , recLUI       ,
+	recCOP0   , recNULL  , recGTE   , recNULL  , recNULL      , recNULL      , recNULL      , recNULL      ,
+	recNULL   , recNULL  , recNULL  , recNULL  , recNULL      , recNULL      , recNULL      , recNULL      ,
+	recLoad   , recLoad  , recLoadStoreUnaligned, recLoad, recLoad, recLoad, recLoadStoreUnaligned, recNULL,
+	recStore  , recStore , recLoadStoreUnaligned, recStore, recNULL, recNULL, recLoadStoreUnaligned, recNULL,
+	recNULL   , recNULL  , recGTE   , recNULL  , recNULL      , recNULL      , recNULL      , recNULL      ,
+	recNULL   , recNULL  , recGTE   , recHLE   , recNULL      , recNULL      , recNULL      , recNULL
+};
+
+static void (*recSPC[64])() = {
+	recShiftImm, recNULL , recShiftImm, recShiftImm, recShiftVar, recNULL  , recShiftVar, recShiftVar,
+	recJR      , recJR   , recNULL    , recNULL    , recSYSCALL , recNULL  , recNULL    , recNULL    ,
+	recMFHILO  , recMTHILO, recMFHILO , recMTHILO  , recNULL    , recNULL  , recNULL    , recNULL    ,
+	recMULT    , recMULT , recDIV     , recDIV     , recNULL    , recNULL  , recNULL    , recNULL    ,
+	recRegALU  , recRegALU, recRegALU , recRegALU  , recRegALU  , recRegALU, recRegALU  , recRegALU  ,
+	recNULL    , recNULL , recRegALU  , recRegALU  , recNULL    , recNULL  , recNULL    , recNULL    ,
+	recNULL    , recNULL , recNULL    , recNULL    , recNULL    , recNULL  , recNULL    , recNULL    ,
+	recNULL    , recNULL , recNULL    , recNULL    , recNULL    , recNULL  , recNULL    , recNULL
+};
+
+static void recSPECIAL()
+{
+	recSPC[_Funct_]();
+}
+
+
+/*** Block recompilation and dispatch ***/
+
+/* Emit block entry trampoline at start of code buffer:
+ *  rec_enter(code, &psxRegs, psxM, code_regions)
+ */
+static void rec_emit_trampoline()
+{
+	rec_enter = (rec_enter_func)recMem;
+
+	PUSH64(X86REG_RBX);
+	PUSH64(X86REG_RBP);
+	PUSH64(X86REG_R12);
+	PUSH64(X86REG_R13);
+	PUSH64(X86REG_R14);
+	PUSH64(X86REG_R15);
+	MOV64_RR(PERM_REG_1, X86REG_RSI);
+	MOV64_RR(PERM_REG_PSXM, X86REG_RDX);
+	MOV64_RR(PERM_REG_REGIONS, X86REG_RCX);
+	// Six pushes keep stack 16-byte aligned at the call in blocks
+	CALL_REG(X86REG_RDI);
+	POP64(X86REG_R15);
+	POP64(X86REG_R14);
+	POP64(X86REG_R13);
+	POP64(X86REG_R12);
+	POP64(X86REG_RBP);
+	POP64(X86REG_RBX);
+	RET();
+
+	recMemCode = recMem;
+}
+
+/* Recompile block at psxRegs.pc. Returns false if it can't be done now:
+ *  code cache is full but can't be flushed while an outer block is still
+ *  executing (HLE BIOS re-entering the dispatcher).
+ */
+static bool recRecompile()
+{
+	// Notify plugin_lib that we're recompiling (affects frameskip timing)
+	pl_dynarec_notify();
+
+	if (rec_blocks_full() || recMem + RECMEM_SLACK > recMemBase + rec_mem_size) {
+		if (rec_exec_depth > 0)
+			return false;
+		REC_LOG("Code cache full: flushing.\n");
+		recReset();
+	}
+
+	recMemStart = recMem;
+	oldpc = pc = psxRegs.pc;
+	regReset();
+	end_block = false;
+
+	do {
+		psxRegs.code = OPCODE_AT(pc);
+		pc += 4;
+		recBSC[psxRegs.code >> 26]();
+		regUnlockAll();
+
+		if (!end_block && (pc - oldpc) >= REC_MAX_BLOCK_OPS*4)
+			rec_emit_exit_const(pc);
+	} while (!end_block);
+
+	*PC_REC(oldpc) = recMemStart;
+
+	// For the range check, bit 27 is interpreted as a sign bit.
+	if ((s32)(oldpc << 4) >= 0)
+		rec_block_add(oldpc, pc);
+
+	return true;
+}
+
+/* Execute block at psxRegs.pc, recompiling it first if needed */
+static void recExecuteSingleBlock()
+{
+	u8 **lut = psxRecLUT[psxRegs.pc >> 16];
+
+	if (lut == NULL || (*PC_REC(psxRegs.pc) == NULL && !recRecompile())) {
+		// PC isn't in RAM or ROM (or block can't be recompiled right now)
+		execI();
+	} else {
+		rec_exec_depth++;
+		rec_enter(*PC_REC(psxRegs.pc), &psxRegs, psxM, code_regions);
+		rec_exec_depth--;
+	}
+}
+
+static inline void rec_run_block()
+{
+	recExecuteSingleBlock();
+
+	if (psxRegs.cycle >= psxRegs.io_cycle_counter)
+		psxBranchTest();
+}
+
+static void recExecute()
+{
+	for (;;)
+		rec_run_block();
+}
+
+static void recExecuteBlock(unsigned target_pc)
+{
+	do {
+		rec_run_block();
+	} while (psxRegs.pc != target_pc);
+}
+
+static int recInit()
+{
+	REC_LOG("Initializing\n");
+
+	rec_mem_size = rec_mem_size_mb * 1024 * 1024;
+	if (rec_mem_size < RECMEM_SIZE_MIN)
+		rec_mem_size = RECMEM_SIZE_MIN;
+	if (rec_mem_size > RECMEM_SIZE_LIMIT)
+		rec_mem_size = RECMEM_SIZE_LIMIT;
+	rec_mem_size_mb = rec_mem_size / (1024*1024);
+	REC_LOG("Code cache size: %u MB\n", rec_mem_size_mb);
+
+	if (!recMemBase) {
+		void *p = mmap(NULL, rec_mem_size, PROT_READ | PROT_WRITE | PROT_EXEC,
+		               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (p == MAP_FAILED) {
+			printf("Error allocating memory\n");
+			return -1;
+		}
+		recMemBase = (u8 *)p;
+	}
+
+	if (!recRAM)
+		recRAM = (u8 **)malloc(REC_RAM_SIZE);
+	if (!recROM)
+		recROM = (u8 **)malloc(REC_ROM_SIZE);
+	if (recRAM == NULL || recROM == NULL) {
+		printf("Error allocating memory\n");
+		return -1;
+	}
+
+	for (int i = 0; i < 0x80; i++)
+		psxRecLUT[i + 0x0000] = recRAM + (((i & 0x1f) << 16) >> 2);
+	memcpy(&psxRecLUT[0x8000], psxRecLUT, 0x80 * sizeof(psxRecLUT[0]));
+	memcpy(&psxRecLUT[0xa000], psxRecLUT, 0x80 * sizeof(psxRecLUT[0]));
+	for (int i = 0; i < 0x08; i++) {
+		psxRecLUT[i + 0x1fc0] = recROM + ((i << 16) >> 2);
+		psxRecLUT[i + 0x9fc0] = recROM + ((i << 16) >> 2);
+		psxRecLUT[i + 0xbfc0] = recROM + ((i << 16) >> 2);
+	}
+
+	recMem = recMemBase;
+	rec_emit_trampoline();
+
+	recReset();
+	return 0;
+}
+
+static void recShutdown()
+{
+	REC_LOG("Shutting down\n");
+
+	if (recMemBase)
+		munmap(recMemBase, rec_mem_size);
+	free(recRAM);
+	free(recROM);
+	recMemBase = NULL;
+	recRAM = recROM = NULL;
+}
+
+/* Invalidate all blocks whose code overlaps the 'Size' words at word-aligned
+ *  PS1 address 'Addr'.
+ */
+static void recClear(u32 Addr, u32 Size)
+{
+	const u32 masked_ram_addr = Addr & 0x1ffffc;
+	rec_invalidate_range(masked_ram_addr, masked_ram_addr + Size*4);
+}
+
+/* Notification from emulator. See recNotify() in MIPS recompiler. */
+static void recNotify(int note, void *data __attribute__((unused)))
+{
+	switch (note)
+	{
+		case R3000ACPU_NOTIFY_CACHE_UNISOLATED:
+			// Flush entire code cache, game has loaded new code
+			recClear(0, 0x200000/4);
+			break;
+
+		default:
+			break;
+	}
+}
+
+static void recReset()
+{
+	rec_blocks_reset();
+	memset(recRAM, 0, REC_RAM_SIZE);
+	memset(recROM, 0, REC_ROM_SIZE);
+
+	recMem = recMemCode;
+
+	regReset();
+}
+
+
+R3000Acpu psxRec =
+{
+	recInit,
+	recReset,
+	recExecute,
+	recExecuteBlock,
+	recClear,
+	recNotify,
+	recShutdown,
+	recExecuteSingleBlock
+};
@@ -0,0 +1,458 @@
+/*
+ * x86_64_codegen.h
+ *
+ * Copyright (c) 2018 PCSX4ALL Team
+ *
+ * Permission is hereby granted, free of charge, to any person
+ * obtaining a copy of this software and associated documentation
+ * files (the "Software"), to deal in the Software without restriction,
+ * including without limitation the rights to use, copy, modify, merge,
+ * publish, distribute, sublicense, and/or sell copies of the Software,
+ * and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES
+ * OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE
+ * OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ */
+
+#ifndef X86_64_CODEGEN_H
+#define X86_64_CODEGEN_H
+
+/* Host registers
+ *
+ *    USAGE RESTRICTIONS IN CODE EMITTERS:
+ *
+ * X86REG_RAX,
+ * X86REG_RCX,
+ * X86REG_RDX      Temporaries, free for use within a single opcode emitter.
+ *                  -> Clobbered by calls to C code.
+ *
+ * X86REG_RSI,
+ * X86REG_RDI      Argument regs for calls to C code, otherwise temporaries.
+ *
+ * X86REG_RBX      Holds pointer to psxRegs struct, a.k.a. PERM_REG_1.
+ *
+ * X86REG_R14      Holds pointer to code_regions[] table, see recompiler.cpp
+ *
+ * X86REG_R15      Holds psxM, base of PS1 RAM.
+ *
+ * X86REG_RBP,
+ * X86REG_R8..R13  Reserved for reg allocator. R8..R11 are caller-saved, so
+ *                  their values are saved around calls to C code.
+ */
+typedef enum {
+	X86REG_RAX = 0,
+	X86REG_RCX,
+	X86REG_RDX,
+	X86REG_RBX,
+	X86REG_RSP,
+	X86REG_RBP,
+	X86REG_RSI,
+	X86REG_RDI,
+	X86REG_R8,
+	X86REG_R9,
+	X86REG_R10,
+	X86REG_R11,
+	X86REG_R12,
+	X86REG_R13,
+	X86REG_R14,
+	X86REG_R15
+} X86Reg;
+
+#define TEMP_0               X86REG_RAX
+#define TEMP_1               X86REG_RCX
+#define TEMP_2               X86REG_RDX
+
+#define ARG_1                X86REG_RDI
+#define ARG_2                X86REG_RSI
+
+/* PERM_REG_1 is pointer to psxRegs struct */
+#define PERM_REG_1           X86REG_RBX
+#define PERM_REG_REGIONS     X86REG_R14
+#define PERM_REG_PSXM        X86REG_R15
+
+/* Condition codes, low nibble of Jcc/SETcc/CMOVcc opcodes */
+enum {
+	CC_O = 0, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+	CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G
+};
+
+/* Extension field of group-1 ALU opcodes (0x81 /n, 0x83 /n) */
+enum {
+	ALU_ADD = 0, ALU_OR = 1, ALU_AND = 4, ALU_SUB = 5, ALU_XOR = 6, ALU_CMP = 7
+};
+
+/* Extension field of group-2 shift opcodes (0xC1 /n, 0xD3 /n) */
+enum {
+	SHIFT_SHL = 4, SHIFT_SHR = 5, SHIFT_SAR = 7
+};
+
+/* Crazy macro to calculate offset of the field in the structure.
+ *  (Can't use standard offsetof() with non-const expressions)
+ */
+#ifndef OFFSET_OF
+#define OFFSET_OF(T,F) ((unsigned int)((char *)&((T *)0L)->F - (char *)0L))
+#endif
+
+/* GPR offset (LO,HI are GPR 32,33) */
+#define offGPR(rx)	OFFSET_OF(psxRegisters, GPR.r[rx])
+
+/* CP0 offset */
+#define offCP0(rx)	OFFSET_OF(psxRegisters, CP0.r[rx])
+
+#define off(field)	OFFSET_OF(psxRegisters, field)
+
+/* Get u32 opcode val at location in PS1 code.
+ * See notes in psxMemWrite32_CacheCtrlPort() regarding why it is best
+ *  to read code here using PSXM*() macros, i.e. through psxMemRLUT[].
+ */
+#define OPCODE_AT(loc) PSXMu32(loc)
+
+extern u8 *recMem;
+
+static inline void write8(u8 val)
+{
+	*recMem++ = val;
+}
+
+static inline void write32(u32 val)
+{
+	memcpy(recMem, &val, 4);
+	recMem += 4;
+}
+
+static inline void write64(u64 val)
+{
+	memcpy(recMem, &val, 8);
+	recMem += 8;
+}
+
+/* REX prefix is only emitted when an extended reg or 64-bit operand size is
+ *  used, or when 'force' is set (byte access to SIL,DIL,BPL,SPL).
+ */
+static inline void emit_rex(bool w, int reg, int index, int base, bool force = false)
+{
+	u8 rex = 0x40 | (w << 3) | (((reg >> 3) & 1) << 2) |
+	         (((index >> 3) & 1) << 1) | ((base >> 3) & 1);
+	if (rex != 0x40 || force)
+		write8(rex);
+}
+
+static inline void emit_modrm_rr(int reg, int rm)
+{
+	write8(0xc0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+/* ModRM (plus SIB and displacement) for [base + disp] or, if 'index' isn't
+ *  -1, [base + index + disp]. 'index' can't be RSP.
+ */
+static inline void emit_modrm_mem(int reg, int base, int index, s32 disp)
+{
+	int mod;
+	if (disp == 0 && (base & 7) != 5)
+		mod = 0;
+	else if (disp >= -128 && disp <= 127)
+		mod = 1;
+	else
+		mod = 2;
+
+	if (index < 0) {
+		write8((mod << 6) | ((reg & 7) << 3) | (base & 7));
+		if ((base & 7) == 4)
+			write8(0x24);
+	} else {
+		write8((mod << 6) | ((reg & 7) << 3) | 4);
+		write8(((index & 7) << 3) | (base & 7));
+	}
+
+	if (mod == 1)
+		write8((u8)disp);
+	else if (mod == 2)
+		write32((u32)disp);
+}
+
+/* Emit 'opc' with reg,rm operands (reg-reg form) */
+static inline void emit_op_rr(u32 opc, int reg, int rm, bool w = false)
+{
+	emit_rex(w, reg, 0, rm);
+	if (opc > 0xff)
+		write8(opc >> 8);
+	write8(opc & 0xff);
+	emit_modrm_rr(reg, rm);
+}
+
+/* Emit 'opc' with reg,[base+index+disp] operands */
+static inline void emit_op_rm(u32 opc, int reg, int base, int index, s32 disp,
+                              bool w = false, bool force_rex = false)
+{
+	emit_rex(w, reg, index < 0 ? 0 : index, base, force_rex);
+	if (opc > 0xff)
+		write8(opc >> 8);
+	write8(opc & 0xff);
+	emit_modrm_mem(reg, base, index, disp);
+}
+
+/*** Moves ***/
+
+#define MOV32_RR(rd, rs) \
+	emit_op_rr(0x89, (rs), (rd))
+
+#define MOV64_RR(rd, rs) \
+	emit_op_rr(0x89, (rs), (rd), true)
+
+#define MOV32_RM(rd, base, disp) \
+	emit_op_rm(0x8b, (rd), (base), -1, (disp))
+
+#define MOV32_MR(base, disp, rs) \
+	emit_op_rm(0x89, (rs), (base), -1, (disp))
+
+#define MOV32_RMX(rd, base, index, disp) \
+	emit_op_rm(0x8b, (rd), (base), (index), (disp))
+
+#define MOV32_MXR(base, index, disp, rs) \
+	emit_op_rm(0x89, (rs), (base), (index), (disp))
+
+#define MOV16_MXR(base, index, disp, rs) \
+	do { write8(0x66); emit_op_rm(0x89, (rs), (base), (index), (disp)); } while (0)
+
+/* Source must be AL,CL,DL or BL */
+#define MOV8_MXR(base, index, disp, rs) \
+	emit_op_rm(0x88, (rs), (base), (index), (disp))
+
+#define MOVZX8_RMX(rd, base, index, disp) \
+	emit_op_rm(0x0fb6, (rd), (base), (index), (disp))
+
+#define MOVZX16_RMX(rd, base, index, disp) \
+	emit_op_rm(0x0fb7, (rd), (base), (index), (disp))
+
+#define MOVSX8_RMX(rd, base, index, disp) \
+	emit_op_rm(0x0fbe, (rd), (base), (index), (disp))
+
+#define MOVSX16_RMX(rd, base, index, disp) \
+	emit_op_rm(0x0fbf, (rd), (base), (index), (disp))
+
+/* Source must be AL,CL,DL or BL */
+#define MOVZX8_RR(rd, rs) \
+	emit_op_rr(0x0fb6, (rd), (rs))
+
+#define MOVZX16_RR(rd, rs) \
+	emit_op_rr(0x0fb7, (rd), (rs))
+
+#define MOVSX8_RR(rd, rs) \
+	emit_op_rr(0x0fbe, (rd), (rs))
+
+#define MOVSX16_RR(rd, rs) \
+	emit_op_rr(0x0fbf, (rd), (rs))
+
+#define MOVSXD_RR(rd, rs) \
+	emit_op_rr(0x63, (rd), (rs), true)
+
+/* NOTE: never emitted as XOR, so flags are preserved */
+static inline void MOV32_RI(int rd, u32 imm)
+{
+	emit_rex(false, 0, 0, rd);
+	write8(0xb8 + (rd & 7));
+	write32(imm);
+}
+
+static inline void MOV64_RI(int rd, u64 imm)
+{
+	emit_rex(true, 0, 0, rd);
+	write8(0xb8 + (rd & 7));
+	write64(imm);
+}
+
+static inline void MOV32_MI(int base, s32 disp, u32 imm)
+{
+	emit_op_rm(0xc7, 0, base, -1, disp);
+	write32(imm);
+}
+
+static inline void MOV32_MXI(int base, int index, s32 disp, u32 imm)
+{
+	emit_op_rm(0xc7, 0, base, index, disp);
+	write32(imm);
+}
+
+static inline void MOV16_MXI(int base, int index, s32 disp, u16 imm)
+{
+	write8(0x66);
+	emit_op_rm(0xc7, 0, base, index, disp);
+	write8(imm & 0xff);
+	write8(imm >> 8);
+}
+
+static inline void MOV8_MXI(int base, int index, s32 disp, u8 imm)
+{
+	emit_op_rm(0xc6, 0, base, index, disp);
+	write8(imm);
+}
+
+#define LEA32(rd, base, disp) \
+	emit_op_rm(0x8d, (rd), (base), -1, (disp))
+
+#define CMOV32(cc, rd, rs) \
+	emit_op_rr(0x0f40 | (cc), (rd), (rs))
+
+/*** ALU ***/
+
+/* 'op' is the reg,r/m form opcode: ADD 0x01, OR 0x09, AND 0x21, SUB 0x29,
+ *  XOR 0x31, CMP 0x39
+ */
+#define ADD32_RR(rd, rs)  emit_op_rr(0x01, (rs), (rd))
+#define OR32_RR(rd, rs)   emit_op_rr(0x09, (rs), (rd))
+#define AND32_RR(rd, rs)  emit_op_rr(0x21, (rs), (rd))
+#define SUB32_RR(rd, rs)  emit_op_rr(0x29, (rs), (rd))
+#define XOR32_RR(rd, rs)  emit_op_rr(0x31, (rs), (rd))
+#define CMP32_RR(rd, rs)  emit_op_rr(0x39, (rs), (rd))
+#define TEST32_RR(rd, rs) emit_op_rr(0x85, (rs), (rd))
+
+static inline void ALU32_RI(int ext, int rd, u32 imm)
+{
+	if ((s32)imm >= -128 && (s32)imm <= 127) {
+		emit_op_rr(0x83, ext, rd);
+		write8((u8)imm);
+	} else {
+		emit_op_rr(0x81, ext, rd);
+		write32(imm);
+	}
+}
+
+static inline void ALU32_MI(int ext, int base, s32 disp, u32 imm)
+{
+	if ((s32)imm >= -128 && (s32)imm <= 127) {
+		emit_op_rm(0x83, ext, base, -1, disp);
+		write8((u8)imm);
+	} else {
+		emit_op_rm(0x81, ext, base, -1, disp);
+		write32(imm);
+	}
+}
+
+#define ADD32_RI(rd, imm)  ALU32_RI(ALU_ADD, (rd), (imm))
+#define OR32_RI(rd, imm)   ALU32_RI(ALU_OR,  (rd), (imm))
+#define AND32_RI(rd, imm)  ALU32_RI(ALU_AND, (rd), (imm))
+#define SUB32_RI(rd, imm)  ALU32_RI(ALU_SUB, (rd), (imm))
+#define XOR32_RI(rd, imm)  ALU32_RI(ALU_XOR, (rd), (imm))
+#define CMP32_RI(rd, imm)  ALU32_RI(ALU_CMP, (rd), (imm))
+
+static inline void TEST32_RI(int rd, u32 imm)
+{
+	emit_op_rr(0xf7, 0, rd);
+	write32(imm);
+}
+
+static inline void CMP8_MXI(int base, int index, s32 disp, u8 imm)
+{
+	emit_op_rm(0x80, ALU_CMP, base, index, disp);
+	write8(imm);
+}
+
+#define NOT32(rd) \
+	emit_op_rr(0xf7, 2, (rd))
+
+static inline void SHIFT32_RI(int ext, int rd, u8 sa)
+{
+	emit_op_rr(0xc1, ext, rd);
+	write8(sa);
+}
+
+#define SHL32_RI(rd, sa)  SHIFT32_RI(SHIFT_SHL, (rd), (sa))
+#define SHR32_RI(rd, sa)  SHIFT32_RI(SHIFT_SHR, (rd), (sa))
+#define SAR32_RI(rd, sa)  SHIFT32_RI(SHIFT_SAR, (rd), (sa))
+
+static inline void SHR64_RI(int rd, u8 sa)
+{
+	emit_op_rr(0xc1, SHIFT_SHR, rd, true);
+	write8(sa);
+}
+
+/* Shift by CL */
+#define SHIFT32_RCL(ext, rd) \
+	emit_op_rr(0xd3, (ext), (rd))
+
+/* Dest must be AL,CL,DL or BL */
+#define SETCC(cc, rd) \
+	emit_op_rr(0x0f90 | (cc), 0, (rd))
+
+#define IMUL64_RR(rd, rs) \
+	emit_op_rr(0x0faf, (rd), (rs), true)
+
+#define CDQ() \
+	write8(0x99)
+
+/* EDX:EAX / rs */
+#define IDIV32(rs) \
+	emit_op_rr(0xf7, 7, (rs))
+
+#define DIV32(rs) \
+	emit_op_rr(0xf7, 6, (rs))
+
+/*** Control flow ***/
+
+/* Forward jumps return location of their rel32 field, which gets fixed up
+ *  to point to current emit location with fixup_jump().
+ */
+static inline u8 *JCC_FWD(int cc)
+{
+	write8(0x0f);
+	write8(0x80 | cc);
+	u8 *rel = recMem;
+	write32(0);
+	return rel;
+}
+
+static inline u8 *JMP_FWD()
+{
+	write8(0xe9);
+	u8 *rel = recMem;
+	write32(0);
+	return rel;
+}
+
+static inline void fixup_jump(u8 *rel)
+{
+	s32 dist = (s32)(recMem - (rel + 4));
+	memcpy(rel, &dist, 4);
+}
+
+static inline void CALL_FUNC(const void *func)
+{
+	MOV64_RI(X86REG_RAX, (u64)(uptr)func);
+	emit_op_rr(0xff, 2, X86REG_RAX);
+}
+
+static inline void PUSH64(int reg)
+{
+	emit_rex(false, 0, 0, reg);
+	write8(0x50 + (reg & 7));
+}
+
+static inline void POP64(int reg)
+{
+	emit_rex(false, 0, 0, reg);
+	write8(0x58 + (reg & 7));
+}
+
+#define CALL_REG(reg) \
+	emit_op_rr(0xff, 2, (reg))
+
+#define RET() \
+	write8(0xc3)
+
+static inline u32 ADJUST_CLOCK(u32 cycles)
+{
+	extern u32 cycle_multiplier;
+	return (cycles * cycle_multiplier) >> 8;
+}
+
+#endif /* X86_64_CODEGEN_H */